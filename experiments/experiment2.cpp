@@ -2,33 +2,21 @@
 #include <cstdint>
 #include "types.hpp"
 #include "integrator.hpp"
+#include "montecarlo.hpp"
 
 
 int main() {
     size_t N = 1e4;
     size_t N_count = 200;
-    static std::random_device floating_rd;
-    static std::mt19937 gen = std::mt19937(floating_rd());
-
-    std::uniform_real_distribution dist = std::uniform_real_distribution<double>(-0.0004,0.0016);
 
     std::cout.precision(8);
     std::cout.setf(std::ios::fixed);
 
-    double float_err = 0.0;
-    double floatsr_err = 0.0;
-    double fp1516_err = 0.0;
-    double fp1516sr_err = 0.0;
-    double fp724_err = 0.0;
-    double fp724sr_err = 0.0;
-    double fp78_err = 0.0;
-    double fp78sr_err = 0.0;
-    double half_err = 0.0;
-    double halfsr_err = 0.0;
-    double bfloat_err = 0.0;
-    double bfloatsr_err = 0.0;
-
-    for (size_t i = 0; i < N_count; i++) {
+    // Every trial gets its own RNG stream, the trials run on all the cores
+    rndcmp::StatisticsSink errors = rndcmp::run_trials<rndcmp::FloatSR>(N_count, [N](size_t) {
+        std::mt19937 gen = std::mt19937(rndcmp::DefaultRng::bits<32>());
+        std::uniform_real_distribution dist = std::uniform_real_distribution<double>(-0.0004,0.0016);
+
         double s0 = 100.;
         // Candidates
         float f_val = s0;
@@ -72,31 +60,26 @@ int main() {
             bfloatsr += value;
         }
 
-        float_err += std::fabs(static_cast<double>(accurate - f_val));
-        floatsr_err += std::fabs(static_cast<double>(accurate - floar_sr));
-        fp1516_err += std::fabs(static_cast<double>(accurate - fp15_16));
-        fp1516sr_err += std::fabs(static_cast<double>(accurate - fp15_16_sr));
-        fp724_err += std::fabs(static_cast<double>(accurate - fp7_24));
-        fp724sr_err += std::fabs(static_cast<double>(accurate - fp7_24_sr));
-        fp78_err += std::fabs(static_cast<double>(accurate - fp7_8));
-        fp78sr_err += std::fabs(static_cast<double>(accurate - fp7_8sr));
-        half_err += std::fabs(static_cast<double>(accurate - half_sum));
-        halfsr_err += std::fabs(static_cast<double>(accurate - half_sr));
-        bfloat_err += std::fabs(static_cast<double>(accurate - bfloat));
-        bfloatsr_err += std::fabs(static_cast<double>(accurate - bfloatsr));
+        return std::vector<double>{
+            std::fabs(static_cast<double>(accurate - f_val)),
+            std::fabs(static_cast<double>(accurate - floar_sr)),
+            std::fabs(static_cast<double>(accurate - fp15_16)),
+            std::fabs(static_cast<double>(accurate - fp15_16_sr)),
+            std::fabs(static_cast<double>(accurate - fp7_24)),
+            std::fabs(static_cast<double>(accurate - fp7_24_sr)),
+            std::fabs(static_cast<double>(accurate - fp7_8)),
+            std::fabs(static_cast<double>(accurate - fp7_8sr)),
+            std::fabs(static_cast<double>(accurate - half_sum)),
+            std::fabs(static_cast<double>(accurate - half_sr)),
+            std::fabs(static_cast<double>(accurate - bfloat)),
+            std::fabs(static_cast<double>(accurate - bfloatsr))
+        };
+    });
+
+    // Mean errors of float, FloatSR, Fixed 15.16, FixedSR 15.16, Fixed 7.24, FixedSR 7.24,
+    // Fixed 7.8, FixedSR 7.8, half, halfsr, bfloat16, bfloat16sr
+    for (double error : errors.mean()) {
+        std::cout << error << std::endl;
     }
-
-    std::cout << float_err / N_count << std::endl;
-    std::cout << floatsr_err / N_count << std::endl;
-    std::cout << fp1516_err / N_count << std::endl;
-    std::cout << fp1516sr_err / N_count << std::endl;
-    std::cout << fp724_err / N_count << std::endl;
-    std::cout << fp724sr_err / N_count << std::endl;
-    std::cout << fp78_err / N_count << std::endl;
-    std::cout << fp78sr_err / N_count << std::endl;
-    std::cout << half_err / N_count << std::endl;
-    std::cout << halfsr_err / N_count << std::endl;
-    std::cout << bfloat_err / N_count << std::endl;
-    std::cout << bfloatsr_err / N_count << std::endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -1,66 +1,46 @@
+#include <array>
 #include <iostream>
 #include <cstdint>
+#include <type_traits>
 #include "types.hpp"
-#include "integrator.hpp"
+#include "static_integrator.hpp"
 
 
 using FixedType = rndcmp::Fixed<std::int32_t, 16>;
 using FixedTypeSR = rndcmp::FixedSR<std::int32_t, 16>;
 
 int main() {
-    rndcmp::system_type<double> system = {
-        [] (const std::vector<double>& x, double t) { return 10.0 * (x[1] - x[0]); },
-        [] (const std::vector<double>& x, double t) { return x[0] * (28.0 - x[2]) - x[1]; },
-        [] (const std::vector<double>& x, double t) { return x[0] * x[1] - 8.0 / 3.0 * x[2]; }
+    // One generic right-hand side for all the types, the whole derivative is computed at once
+    auto lorenz = [] (const auto& x, double, auto& dxdt) {
+        using T = typename std::decay_t<decltype(dxdt)>::value_type;
+        dxdt[0] = T(10.0 * (x[1] - x[0]));
+        dxdt[1] = T(x[0] * (28.0 - x[2]) - x[1]);
+        dxdt[2] = T(x[0] * x[1] - 8.0 / 3.0 * x[2]);
     };
 
-    rndcmp::system_type<float> system_float = {
-        [] (const std::vector<float>& x, double t) { return 10.0 * (x[1] - x[0]); },
-        [] (const std::vector<float>& x, double t) { return x[0] * (28.0 - x[2]) - x[1]; },
-        [] (const std::vector<float>& x, double t) { return x[0] * x[1] - 8.0 / 3.0 * x[2]; }
-    };
-
-    rndcmp::system_type<FixedType> system_fixed = {
-        [] (const std::vector<FixedType>& x, double t) { return 10.0 * (x[1] - x[0]); },
-        [] (const std::vector<FixedType>& x, double t) { return x[0] * (28.0 - x[2]) - x[1]; },
-        [] (const std::vector<FixedType>& x, double t) { return x[0] * x[1] - 8.0 / 3.0 * x[2]; }
-    };
-
-    rndcmp::system_type<FixedTypeSR> system_fixed_sr = {
-        [] (const std::vector<FixedTypeSR>& x, double t) { return 10.0 * (x[1] - x[0]); },
-        [] (const std::vector<FixedTypeSR>& x, double t) { return x[0] * (28.0 - x[2]) - x[1]; },
-        [] (const std::vector<FixedTypeSR>& x, double t) { return x[0] * x[1] - 8.0 / 3.0 * x[2]; }
-    };
-
-    rndcmp::system_type<rndcmp::FloatSR> system_float_sr = {
-        [] (const std::vector<rndcmp::FloatSR>& x, double t) { return 10.0 * (x[1] - x[0]); },
-        [] (const std::vector<rndcmp::FloatSR>& x, double t) { return x[0] * (28.0 - x[2]) - x[1]; },
-        [] (const std::vector<rndcmp::FloatSR>& x, double t) { return x[0] * x[1] - 8.0 / 3.0 * x[2]; }
-    };
-
-    std::vector<double> initial = {1., 1., 1.};
-    std::vector<float> initial_f = {1., 1., 1.};
-    std::vector<FixedType> initial_fp = {FixedType(1.), FixedType(1.), FixedType(1.)};
-    std::vector<FixedTypeSR> initial_fp_sr = {FixedTypeSR(1.), FixedTypeSR(1.), FixedTypeSR(1.)};
-    std::vector<rndcmp::FloatSR> initial_float_sr = {rndcmp::FloatSR(1.), rndcmp::FloatSR(1.), rndcmp::FloatSR(1.)};
+    std::array<double, 3> initial = {1., 1., 1.};
+    std::array<float, 3> initial_f = {1., 1., 1.};
+    std::array<FixedType, 3> initial_fp = {FixedType(1.), FixedType(1.), FixedType(1.)};
+    std::array<FixedTypeSR, 3> initial_fp_sr = {FixedTypeSR(1.), FixedTypeSR(1.), FixedTypeSR(1.)};
+    std::array<rndcmp::FloatSR, 3> initial_float_sr = {rndcmp::FloatSR(1.), rndcmp::FloatSR(1.), rndcmp::FloatSR(1.)};
 
-    auto integrator = rndcmp::RK4Integrator<double>(system, 0.0, 1000., 0.01);
+    auto integrator = rndcmp::make_static_rk4_integrator<double, 3>(lorenz, 0.0, 1000., 0.01);
     integrator.setInitial(initial);
     integrator.solve();
 
-    auto integrator_f = rndcmp::RK4Integrator<float>(system_float, 0.0, 1000., 0.01);
+    auto integrator_f = rndcmp::make_static_rk4_integrator<float, 3>(lorenz, 0.0, 1000., 0.01);
     integrator_f.setInitial(initial_f);
     integrator_f.solve();
 
-    auto integrator_fp = rndcmp::RK4Integrator<FixedType>(system_fixed, 0.0, 1000., 0.01);
+    auto integrator_fp = rndcmp::make_static_rk4_integrator<FixedType, 3>(lorenz, 0.0, 1000., 0.01);
     integrator_fp.setInitial(initial_fp);
     integrator_fp.solve();
 
-    auto integrator_fp_sr = rndcmp::RK4Integrator<FixedTypeSR>(system_fixed_sr, 0.0, 1000., 0.01);
+    auto integrator_fp_sr = rndcmp::make_static_rk4_integrator<FixedTypeSR, 3>(lorenz, 0.0, 1000., 0.01);
     integrator_fp_sr.setInitial(initial_fp_sr);
     integrator_fp_sr.solve();
 
-    auto integrator_float_sr = rndcmp::RK4Integrator<rndcmp::FloatSR>(system_float_sr, 0.0, 1000., 0.01);
+    auto integrator_float_sr = rndcmp::make_static_rk4_integrator<rndcmp::FloatSR, 3>(lorenz, 0.0, 1000., 0.01);
     integrator_float_sr.setInitial(initial_float_sr);
     integrator_float_sr.solve();
 
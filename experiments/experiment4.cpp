@@ -1,52 +1,46 @@
+#include <array>
 #include <iostream>
 #include <cstdint>
 #include "types.hpp"
-#include "integrator.hpp"
+#include "static_integrator.hpp"
 
 
 int main() {
-    rndcmp::system_type<double> system = {
-        [] (const std::vector<double>& x, double t) { return x[1]; },
-        [] (const std::vector<double>& x, double t) { return -x[0]; },
+    auto system = [] (const auto& x, double, auto& dxdt) {
+        dxdt[0] = x[1];
+        dxdt[1] = -x[0];
     };
 
-    rndcmp::system_type<float> system_float = {
-        [] (const std::vector<float>& x, double t) { return x[1]; },
-        [] (const std::vector<float>& x, double t) { return -x[0]; },
-    };
-
-    rndcmp::system_type<rndcmp::FloatSR> system_float_sr = {
-        [] (const std::vector<rndcmp::FloatSR>& x, double t) { return x[1]; },
-        [] (const std::vector<rndcmp::FloatSR>& x, double t) { return -x[0]; },
-    };
+    std::array<double, 2> initial = {1., 0.};
+    std::array<float, 2> initial_f = {1., 0.};
+    std::array<rndcmp::FloatSR, 2> initial_float_sr = {rndcmp::FloatSR(1.), rndcmp::FloatSR(0.)};
 
-    std::vector<double> initial = {1., 0.};
-    std::vector<float> initial_f = {1., 0.};
-    std::vector<rndcmp::FloatSR> initial_float_sr = {rndcmp::FloatSR(1.), rndcmp::FloatSR(0.)};
+    // 3M points per type: the trajectories go into flat buffers instead of a vector per step
+    size_t points = 3000002;
+    rndcmp::FlatSink<double> solution(points, 2);
+    rndcmp::FlatSink<float> solution_f(points, 2);
+    rndcmp::FlatSink<rndcmp::FloatSR> solution_float_sr(points, 2);
 
-    auto integrator = rndcmp::EulerIntegrator<double>(system, 0.0, 3., 1e-6);
+    auto integrator = rndcmp::make_static_euler_integrator<double, 2>(system, 0.0, 3., 1e-6);
     integrator.setInitial(initial);
-    integrator.solve();
+    integrator.solve(solution);
 
-    auto integrator_f = rndcmp::EulerIntegrator<float>(system_float, 0.0, 3., 1e-6);
+    auto integrator_f = rndcmp::make_static_euler_integrator<float, 2>(system, 0.0, 3., 1e-6);
     integrator_f.setInitial(initial_f);
-    integrator_f.solve();
+    integrator_f.solve(solution_f);
 
-    auto integrator_float_sr = rndcmp::EulerIntegrator<rndcmp::FloatSR>(system_float_sr, 0.0, 3., 1e-6);
+    auto integrator_float_sr = rndcmp::make_static_euler_integrator<rndcmp::FloatSR, 2>(system, 0.0, 3., 1e-6);
     integrator_float_sr.setInitial(initial_float_sr);
-    integrator_float_sr.solve();
+    integrator_float_sr.solve(solution_float_sr);
 
-    auto solution = integrator.getSolution();
-    auto solution_f = integrator_f.getSolution();
-    auto solution_float_sr = integrator_float_sr.getSolution();
     std::cout << "x\tx_f\tx_fsr\ty\ty_f\ty_fsr" << std::endl;
     std::cout.precision(8);
     std::cout.setf(std::ios::fixed);
-    for (size_t i = 0; i < solution.size(); i++) {
-        for (size_t j = 0; j < 3; j++) {
-            std::cout << solution[i][j] << "\t" << solution_f[i][j];
-            std::cout << "\t" << solution_float_sr[i][j];
-            if (j == 2) {
+    for (size_t i = 0; i < solution.rows(); i++) {
+        for (size_t j = 0; j < 2; j++) {
+            std::cout << solution(i, j) << "\t" << solution_f(i, j);
+            std::cout << "\t" << solution_float_sr(i, j);
+            if (j == 1) {
                 std::cout << std::endl;
             } else {
                 std::cout << "\t";
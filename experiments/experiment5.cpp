@@ -1,9 +1,11 @@
+#include <array>
 #include <iostream>
 #include <cstdint>
+#include <fstream>
 #include <string>
 
 #include "types.hpp"
-#include "integrator.hpp"
+#include "static_integrator.hpp"
 
 
 using Fixed16 = rndcmp::Fixed<std::int32_t, 16>;
@@ -16,72 +18,86 @@ using Fixed8 = rndcmp::Fixed<std::int16_t, 8>;
 using FixedSR8 = rndcmp::FixedSR<std::int16_t, 8>;
 
 template<typename T>
-void calculate(double time_end, double step) {
-    rndcmp::system_type<T> system = {
-        [] (const std::vector<T>& x, double t) { return T(10.0 * (x[1] - x[0])); },
-        [] (const std::vector<T>& x, double t) { return T(x[0] * (28.0 - x[2]) - x[1]); },
-        [] (const std::vector<T>& x, double t) { return T(x[0] * x[1] - 8.0 / 3.0 * x[2]); }
+void calculate(double time_end, double step, const std::string& checkpoint) {
+    auto lorenz = [] (const std::array<T, 3>& x, double, std::array<T, 3>& dxdt) {
+        dxdt[0] = T(10.0 * (x[1] - x[0]));
+        dxdt[1] = T(x[0] * (28.0 - x[2]) - x[1]);
+        dxdt[2] = T(x[0] * x[1] - 8.0 / 3.0 * x[2]);
     };
 
-    std::vector<T> initial = {T(1.), T(1.), T(1.)};
-    auto integrator = rndcmp::RK4Integrator<T>(system, 0.0, time_end, step);
+    std::array<T, 3> initial = {T(1.), T(1.), T(1.)};
+    // Three components known at compile time: the state stays in registers between the steps
+    auto integrator = rndcmp::make_static_rk4_integrator<T, 3>(lorenz, 0.0, time_end, step);
     integrator.setInitial(initial);
-    integrator.solve();
+    if (!checkpoint.empty()) {
+        integrator.setCheckpoint(checkpoint, 100000);
+        if (std::ifstream(checkpoint)) {
+            std::cerr << "resumed at point: " << integrator.resumeFrom(checkpoint) << std::endl;
+        }
+    }
 
-    auto solution = integrator.getSolution();
     std::cout.precision(10);
     std::cout.setf(std::ios::fixed);
-    for (size_t i = 0; i < solution.size(); i++) {
-        std::cout << solution[i][0] << "\t" << solution[i][1] << "\t" << solution[i][2] << std::endl;
-    }
+    integrator.solve([](double, const std::array<T, 3>& x) {
+        std::cout << x[0] << "\t" << x[1] << "\t" << x[2] << std::endl;
+    });
 }
 
 // Usage: 
-// ./experiment5 <type> <time_end> <step>
+// ./experiment5 <type> <time_end> <step> [seed] [checkpoint]
+// The seed of every run is printed to stderr, pass it back to replay the run bit for bit.
+// With a checkpoint file the state is saved there every 100000 steps, and a run started again with the same
+// arguments continues from it. The points are printed from the one after the checkpoint on: keep the first
+// "resumed at point" lines of the output of the interrupted run and append the new output to them.
 
 int main(int argc, char** argv) {
     std::string type(argv[1]);
     double time_end = stod(std::string(argv[2]));
     double step = stod(std::string(argv[3]));
+    if (argc > 4) {
+        rndcmp::seed(std::stoull(std::string(argv[4])));
+    }
+    std::string checkpoint = argc > 5 ? std::string(argv[5]) : std::string();
+    std::cerr << "seed: " << rndcmp::master_seed() << std::endl;
 
     if (type.compare("double") == 0) {
-        calculate<double>(time_end, step);
+        calculate<double>(time_end, step, checkpoint);
     }
     if (type.compare("float") == 0) {
-        calculate<float>(time_end, step);
+        calculate<float>(time_end, step, checkpoint);
     }
     if (type.compare("Fixed16") == 0) {
-        calculate<Fixed16>(time_end, step);
+        calculate<Fixed16>(time_end, step, checkpoint);
     }
     if (type.compare("FixedSR16") == 0) {
-        calculate<FixedSR16>(time_end, step);
+        calculate<FixedSR16>(time_end, step, checkpoint);
     }
     if (type.compare("Fixed24") == 0) {
-        calculate<Fixed24>(time_end, step);
+        calculate<Fixed24>(time_end, step, checkpoint);
     }
     if (type.compare("FixedSR24") == 0) {
-        calculate<FixedSR24>(time_end, step);
+        calculate<FixedSR24>(time_end, step, checkpoint);
     }
     if (type.compare("Fixed8") == 0) {
-        calculate<Fixed8>(time_end, step);
+        calculate<Fixed8>(time_end, step, checkpoint);
     }
     if (type.compare("FixedSR8") == 0) {
-        calculate<FixedSR8>(time_end, step);
+        calculate<FixedSR8>(time_end, step, checkpoint);
     }
     if (type.compare("FloatSR") == 0) {
-        calculate<rndcmp::FloatSR>(time_end, step);
+        calculate<rndcmp::FloatSR>(time_end, step, checkpoint);
     }
     if (type.compare("bfloat16") == 0) {
-        calculate<rndcmp::bfloat16>(time_end, step);
+        calculate<rndcmp::bfloat16>(time_end, step, checkpoint);
     }
     if (type.compare("bfloat16sr") == 0) {
-        calculate<rndcmp::bfloat16sr>(time_end, step);
+        calculate<rndcmp::bfloat16sr>(time_end, step, checkpoint);
     }
     if (type.compare("half") == 0) {
-        calculate<half_float::half>(time_end, step);
+        calculate<half_float::half>(time_end, step, checkpoint);
     }
     if (type.compare("halfsr") == 0) {
-        calculate<half_float::halfsr>(time_end, step);
+        calculate<half_float::halfsr>(time_end, step, checkpoint);
     }
     return 0;
 }
\ No newline at end of file
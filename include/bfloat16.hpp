@@ -5,8 +5,11 @@
 #include <iostream>
 #include <cstring>
 #include <cmath>
+#include <cstdint>
 #include <Eigen/Core>
 
+#include "simd.hpp"
+
 
 namespace rndcmp {
     class bfloat16 {
@@ -462,6 +465,124 @@ namespace rndcmp {
 
         int16_t value;
     };
+
+    /* Array conversions */
+
+    namespace detail {
+        // Block kernels on the raw 16-bit patterns. Every ISA gives the same bits as the scalar code.
+
+        inline void bfloat16_unpack_scalar(const uint16_t* src, float* dst, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                uint32_t bits = static_cast<uint32_t>(src[i]) << 16;
+                memcpy(dst + i, &bits, sizeof(bits));
+            }
+        }
+
+        inline void bfloat16_pack_scalar(const float* src, uint16_t* dst, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                // Same magic multiplier as bfloat16::round
+                float v = src[i] * 1.001957f;
+                uint32_t bits;
+                memcpy(&bits, &v, sizeof(bits));
+                dst[i] = static_cast<uint16_t>(bits >> 16);
+            }
+        }
+
+#if RNDCMP_X86_DISPATCH
+        RNDCMP_TARGET("avx2")
+        inline void bfloat16_unpack_avx2(const uint16_t* src, float* dst, size_t n) {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m256i w = _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+                _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(w));
+            }
+            bfloat16_unpack_scalar(src + i, dst + i, n - i);
+        }
+
+        // Packs the low halves of two vectors of 32-bit lanes (values below 2^16) into 16 ordered words
+        RNDCMP_TARGET("avx2")
+        inline __m256i bfloat16_pack_halves_avx2(__m256i a, __m256i b) {
+            return _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        }
+
+        RNDCMP_TARGET("avx2")
+        inline void bfloat16_pack_avx2(const float* src, uint16_t* dst, size_t n) {
+            const __m256 magic = _mm256_set1_ps(1.001957f);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m256i a = _mm256_castps_si256(_mm256_mul_ps(_mm256_loadu_ps(src + i), magic));
+                __m256i b = _mm256_castps_si256(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), magic));
+                __m256i packed = bfloat16_pack_halves_avx2(_mm256_srli_epi32(a, 16), _mm256_srli_epi32(b, 16));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+            }
+            bfloat16_pack_scalar(src + i, dst + i, n - i);
+        }
+
+        RNDCMP_TARGET("avx512f")
+        inline void bfloat16_unpack_avx512(const uint16_t* src, float* dst, size_t n) {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m512i w = _mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16);
+                _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(w));
+            }
+            bfloat16_unpack_scalar(src + i, dst + i, n - i);
+        }
+
+        RNDCMP_TARGET("avx512f")
+        inline void bfloat16_pack_avx512(const float* src, uint16_t* dst, size_t n) {
+            const __m512 magic = _mm512_set1_ps(1.001957f);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m512i x = _mm512_castps_si512(_mm512_mul_ps(_mm512_loadu_ps(src + i), magic));
+                __m256i packed = _mm512_cvtepi32_epi16(_mm512_srli_epi32(x, 16));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+            }
+            bfloat16_pack_scalar(src + i, dst + i, n - i);
+        }
+#endif
+
+        inline void bfloat16_unpack(simd::Isa isa, const uint16_t* src, float* dst, size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if (isa == simd::Isa::Avx512) {
+                bfloat16_unpack_avx512(src, dst, n);
+                return;
+            }
+            if (isa == simd::Isa::Avx2) {
+                bfloat16_unpack_avx2(src, dst, n);
+                return;
+            }
+#endif
+            bfloat16_unpack_scalar(src, dst, n);
+        }
+
+        inline void bfloat16_pack(simd::Isa isa, const float* src, uint16_t* dst, size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if (isa == simd::Isa::Avx512) {
+                bfloat16_pack_avx512(src, dst, n);
+                return;
+            }
+            if (isa == simd::Isa::Avx2) {
+                bfloat16_pack_avx2(src, dst, n);
+                return;
+            }
+#endif
+            bfloat16_pack_scalar(src, dst, n);
+        }
+    }
+
+    static_assert(sizeof(bfloat16) == sizeof(uint16_t), "bfloat16 must have the layout of its 16-bit pattern");
+
+    // Rounds n floats to bfloat16 like bfloat16(src[i]) does, with the widest SIMD kernel the CPU supports
+    inline void convert(const float* src, bfloat16* dst, size_t n) {
+        detail::bfloat16_pack(simd::active_isa(), src, reinterpret_cast<uint16_t*>(dst), n);
+    }
+
+    // Widens n bfloat16 values to float
+    inline void convert(const bfloat16* src, float* dst, size_t n) {
+        detail::bfloat16_unpack(simd::active_isa(), reinterpret_cast<const uint16_t*>(src), dst, n);
+    }
 }
 
 namespace Eigen {
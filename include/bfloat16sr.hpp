@@ -6,25 +6,65 @@
 #include <cstring>
 #include <random>
 #include <cmath>
+#include <algorithm>
+
+#include "random.hpp"
+#include "simd.hpp"
+#include "bfloat16.hpp"
+#include "packet.hpp"
 
 
 namespace rndcmp {
+    // Number of low-cut bits for float
+    constexpr int res16_bits = 16;
     // Мask for 16 low-cut bits for double
     constexpr int64_t res16_mask = 0xffff;
 
-    static std::random_device bfloating_rd;
-    static std::mt19937 bint_generator = std::mt19937(bfloating_rd());
-    static std::uniform_int_distribution<int32_t> dist16 = std::uniform_int_distribution<int32_t>(0, res16_mask);
-        
-    class bfloat16sr {
+    namespace detail {
+        inline double bfloat16_bits_to_double(uint16_t bits) {
+            uint32_t wide = static_cast<uint32_t>(bits) << 16;
+            float result;
+            memcpy(&result, &wide, sizeof(result));
+            return result;
+        }
+
+        // Rounds x to the bits of a bfloat16 without an intermediate float: up with probability equal to the part
+        // of the step between the two neighbours that x covers, p is a 32-bit random value. Clamps to the finite
+        // range like round_double_to_float.
+        inline uint16_t round_double_to_bfloat16(double x, uint32_t p) {
+            // x truncated to float, then to bfloat16 by dropping the low 16 bits
+            float truncated = static_cast<float>(x);
+            if (std::fabs(truncated) > std::fabs(x)) {
+                truncated = std::nextafter(truncated, 0.0f);
+            }
+            uint32_t bits;
+            memcpy(&bits, &truncated, sizeof(bits));
+            uint16_t rounded = static_cast<uint16_t>(bits >> 16);
+            if (!std::isfinite(x)) {
+                return rounded;
+            }
+            double low = bfloat16_bits_to_double(rounded);
+            double high = bfloat16_bits_to_double(static_cast<uint16_t>(rounded + 1));
+            if (std::isfinite(high) && p < std::ldexp((x - low) / (high - low), 32)) {
+                rounded += 1;
+            }
+            return rounded;
+        }
+    }
+
+    template<typename RNG = DefaultRng>
+    class basic_bfloat16sr {
     public:
-        bfloat16sr(): bfloat16sr(0.0f) {};
+        using rng_type = RNG;
+
+        // Zero without a rounding, so buffers of the type do not draw random bits
+        basic_bfloat16sr(): value(0) {};
 
-        bfloat16sr(float rhs) { value = round(rhs); };
+        basic_bfloat16sr(float rhs) { value = round(rhs); };
 
-        bfloat16sr& operator=(const bfloat16sr& rhs) = default;
+        basic_bfloat16sr& operator=(const basic_bfloat16sr& rhs) = default;
 
-        bfloat16sr& operator=(float rhs) { value = round(rhs); return *this; }
+        basic_bfloat16sr& operator=(float rhs) { value = round(rhs); return *this; }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
         operator T() const {
@@ -43,49 +83,49 @@ namespace rndcmp {
         /* + operators */
         
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr operator+(const T& rhs) const {
+        basic_bfloat16sr operator+(const T& rhs) const {
             float v = static_cast<float>(*this) + static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
-        bfloat16sr operator+(const bfloat16sr& rhs) const {
+        basic_bfloat16sr operator+(const basic_bfloat16sr& rhs) const {
             float v = static_cast<float>(*this) + static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bfloat16sr operator+(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator+(T lhs, const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(lhs) + static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr& operator+=(const T& rhs) {
+        basic_bfloat16sr& operator+=(const T& rhs) {
             float v = static_cast<float>(*this) + static_cast<float>(rhs);
             value = round(v);
             return *this;
         }
 
-        bfloat16sr& operator+=(const bfloat16sr& rhs) {
+        basic_bfloat16sr& operator+=(const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(*this) + static_cast<float>(rhs);
             value = round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr operator+(const T& rhs) const {
+        basic_bfloat16sr operator+(const T& rhs) const {
             float v = static_cast<float>(*this) + rhs;
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bfloat16sr operator+(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator+(T lhs, const basic_bfloat16sr& rhs) {
             float v = lhs + static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr& operator+=(const T& rhs) {
+        basic_bfloat16sr& operator+=(const T& rhs) {
             float v = static_cast<float>(*this) + rhs;
             value = round(v);
             return *this;
@@ -94,106 +134,106 @@ namespace rndcmp {
         /* - operators */
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr operator-(const T& rhs) const {
+        basic_bfloat16sr operator-(const T& rhs) const {
             float v = static_cast<float>(*this) - static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
-        bfloat16sr operator-(const bfloat16sr& rhs) const {
+        basic_bfloat16sr operator-(const basic_bfloat16sr& rhs) const {
             float v = static_cast<float>(*this) - static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr& operator-=(const T& rhs) {
+        basic_bfloat16sr& operator-=(const T& rhs) {
             float v = static_cast<float>(*this) - static_cast<float>(rhs);
             value = round(v);
             return *this;
         }
 
-        bfloat16sr& operator-=(const bfloat16sr& rhs) {
+        basic_bfloat16sr& operator-=(const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(*this) - static_cast<float>(rhs);
             value = round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bfloat16sr operator-(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator-(T lhs, const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(lhs) - static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr operator-(const T& rhs) const {
+        basic_bfloat16sr operator-(const T& rhs) const {
             float v = static_cast<float>(*this) - static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bfloat16sr operator-(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator-(T lhs, const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(lhs) - static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr& operator-=(const T& rhs) {
+        basic_bfloat16sr& operator-=(const T& rhs) {
             float v = static_cast<float>(*this) - rhs;
             value = round(v);
             return *this;
         }
 
         // Unary minus
-        bfloat16sr operator-() const {
+        basic_bfloat16sr operator-() const {
             float v = - static_cast<float>(*this);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         /* multiply operators */
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr operator*(const T& rhs) const {
+        basic_bfloat16sr operator*(const T& rhs) const {
             float v = static_cast<float>(*this) * static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
-        bfloat16sr operator*(const bfloat16sr& rhs) const {
+        basic_bfloat16sr operator*(const basic_bfloat16sr& rhs) const {
             float v = static_cast<float>(*this) * static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr& operator*=(const T& rhs) {
+        basic_bfloat16sr& operator*=(const T& rhs) {
             float v = static_cast<float>(*this) * static_cast<float>(rhs);
             value = round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bfloat16sr operator*(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator*(T lhs, const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(lhs) * static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr operator*(const T& rhs) const {
+        basic_bfloat16sr operator*(const T& rhs) const {
             float v = static_cast<float>(*this) * rhs;
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bfloat16sr operator*(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator*(T lhs, const basic_bfloat16sr& rhs) {
             float v = lhs * static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr& operator*=(const T& rhs) {
+        basic_bfloat16sr& operator*=(const T& rhs) {
             float v = static_cast<float>(*this) * rhs;
             value = round(v);
             return *this;
         }
 
-        bfloat16sr& operator*=(const bfloat16sr& rhs) {
+        basic_bfloat16sr& operator*=(const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(*this) * static_cast<float>(rhs);
             value = round(v);
             return *this;
@@ -202,49 +242,49 @@ namespace rndcmp {
         /* divide operators */
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr operator/(const T& rhs) const {
+        basic_bfloat16sr operator/(const T& rhs) const {
             float v = static_cast<float>(*this) / static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
-        bfloat16sr operator/(const bfloat16sr& rhs) const {
+        basic_bfloat16sr operator/(const basic_bfloat16sr& rhs) const {
             float v = static_cast<float>(*this) / static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        bfloat16sr& operator/=(const T& rhs) {
+        basic_bfloat16sr& operator/=(const T& rhs) {
             float v = static_cast<float>(*this) / static_cast<float>(rhs);
             value = round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bfloat16sr operator/(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator/(T lhs, const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(lhs) / static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr operator/(const T& rhs) const {
+        basic_bfloat16sr operator/(const T& rhs) const {
             float v = static_cast<float>(*this) / rhs;
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bfloat16sr operator/(T lhs, const bfloat16sr& rhs) {
+        friend basic_bfloat16sr operator/(T lhs, const basic_bfloat16sr& rhs) {
             float v = lhs / static_cast<float>(rhs);
-            return bfloat16sr(v);
+            return basic_bfloat16sr(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        bfloat16sr& operator/=(const T& rhs) {
+        basic_bfloat16sr& operator/=(const T& rhs) {
             float v = static_cast<float>(*this) / rhs;
             round(v);
             return *this;
         }
 
-        bfloat16sr& operator/=(const bfloat16sr& rhs) {
+        basic_bfloat16sr& operator/=(const basic_bfloat16sr& rhs) {
             float v = static_cast<float>(*this) / static_cast<float>(rhs);
             value = round(v);
             return *this;
@@ -254,7 +294,7 @@ namespace rndcmp {
 
         /* less */
 
-        bool operator<(const bfloat16sr& rhs) const {
+        bool operator<(const basic_bfloat16sr& rhs) const {
             return value < rhs.value;
         }
 
@@ -269,18 +309,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator<(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator<(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) < static_cast<float>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator<(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator<(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) < static_cast<float>(lhs);
         }
 
         /* greater */
 
-        bool operator>(const bfloat16sr& rhs) const {
+        bool operator>(const basic_bfloat16sr& rhs) const {
             return value > rhs.value;
         }
 
@@ -295,18 +335,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator>(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator>(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) > static_cast<float>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator>(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator>(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) > static_cast<float>(lhs);
         }
 
         /* equal */
 
-        bool operator==(const bfloat16sr& rhs) const {
+        bool operator==(const basic_bfloat16sr& rhs) const {
             return value == rhs.value;
         }
 
@@ -321,18 +361,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator==(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator==(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) == static_cast<float>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator==(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator==(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) == static_cast<float>(lhs);
         }
 
         /* not equal */
        
-        bool operator!=(const bfloat16sr& rhs) const {
+        bool operator!=(const basic_bfloat16sr& rhs) const {
             return value != rhs.value;
         }
 
@@ -347,18 +387,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator!=(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator!=(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) != static_cast<float>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator!=(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator!=(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) != static_cast<float>(lhs);
         }
 
         /* less or equal */
 
-        bool operator<=(const bfloat16sr& rhs) const {
+        bool operator<=(const basic_bfloat16sr& rhs) const {
             return value <= rhs.value;
         }
 
@@ -373,18 +413,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator<=(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator<=(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) <= static_cast<float>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator<=(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator<=(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) <= static_cast<float>(lhs);
         }
 
         /* greater or equal */
 
-        bool operator>=(const bfloat16sr& rhs) const {
+        bool operator>=(const basic_bfloat16sr& rhs) const {
             return value >= rhs.value;
         }
 
@@ -399,64 +439,84 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator>=(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator>=(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) >= static_cast<float>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator>=(const T& rhs, const bfloat16sr& lhs) {
+        friend bool operator>=(const T& rhs, const basic_bfloat16sr& lhs) {
             return static_cast<float>(rhs) >= static_cast<float>(lhs);
         }
 
         /* ostream overload */
-        friend std::ostream& operator<<(std::ostream& os, const bfloat16sr& v) {
+        friend std::ostream& operator<<(std::ostream& os, const basic_bfloat16sr& v) {
             os << float(v);
             return os;
         }
 
         /* Trigonometric functions */
-        friend inline bfloat16sr cos(const bfloat16sr&  x)  { return cos(static_cast<float>(x)); }
-        friend inline bfloat16sr sin(const bfloat16sr&  x)  { return sin(static_cast<float>(x)); }
-        friend inline bfloat16sr tan(const bfloat16sr&  x)  { return tan(static_cast<float>(x)); }
-        friend inline bfloat16sr acos(const bfloat16sr&  x)  { return acos(static_cast<float>(x)); }
-        friend inline bfloat16sr asin(const bfloat16sr&  x)  { return asin(static_cast<float>(x)); }
-        friend inline bfloat16sr atan(const bfloat16sr&  x)  { return atan(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr cos(const basic_bfloat16sr&  x)  { return cos(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr sin(const basic_bfloat16sr&  x)  { return sin(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr tan(const basic_bfloat16sr&  x)  { return tan(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr acos(const basic_bfloat16sr&  x)  { return acos(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr asin(const basic_bfloat16sr&  x)  { return asin(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr atan(const basic_bfloat16sr&  x)  { return atan(static_cast<float>(x)); }
 
         /* Hyperbolic functions */
-        friend inline bfloat16sr cosh(const bfloat16sr&  x)  { return cosh(static_cast<float>(x)); }
-        friend inline bfloat16sr sinh(const bfloat16sr&  x)  { return sinh(static_cast<float>(x)); }
-        friend inline bfloat16sr tanh(const bfloat16sr&  x)  { return tanh(static_cast<float>(x)); }
-        friend inline bfloat16sr acosh(const bfloat16sr&  x)  { return acosh(static_cast<float>(x)); }
-        friend inline bfloat16sr asinh(const bfloat16sr&  x)  { return asinh(static_cast<float>(x)); }
-        friend inline bfloat16sr atanh(const bfloat16sr&  x)  { return atanh(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr cosh(const basic_bfloat16sr&  x)  { return cosh(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr sinh(const basic_bfloat16sr&  x)  { return sinh(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr tanh(const basic_bfloat16sr&  x)  { return tanh(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr acosh(const basic_bfloat16sr&  x)  { return acosh(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr asinh(const basic_bfloat16sr&  x)  { return asinh(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr atanh(const basic_bfloat16sr&  x)  { return atanh(static_cast<float>(x)); }
 
         /* Exponential and logarithmic functions */
-        friend inline bfloat16sr exp(const bfloat16sr&  x)  { return exp(static_cast<float>(x)); }
-        friend inline bfloat16sr log(const bfloat16sr&  x)  { return log(static_cast<float>(x)); }
-        friend inline bfloat16sr log10(const bfloat16sr&  x)  { return log10(static_cast<float>(x)); }
-        friend inline bfloat16sr logb(const bfloat16sr&  x)  { return logb(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr exp(const basic_bfloat16sr&  x)  { return exp(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr log(const basic_bfloat16sr&  x)  { return log(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr log10(const basic_bfloat16sr&  x)  { return log10(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr logb(const basic_bfloat16sr&  x)  { return logb(static_cast<float>(x)); }
 
         /* Power functions */
-        friend inline bfloat16sr pow(const bfloat16sr&  base, double exponent)  { return pow(static_cast<float>(base), exponent); }
-        friend inline bfloat16sr sqrt(const bfloat16sr&  x)  { return sqrt(static_cast<float>(x)); }
-        friend inline bfloat16sr cbrt(const bfloat16sr&  x)  { return cbrt(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr pow(const basic_bfloat16sr&  base, double exponent)  { return pow(static_cast<float>(base), exponent); }
+        friend inline basic_bfloat16sr sqrt(const basic_bfloat16sr&  x)  { return sqrt(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr cbrt(const basic_bfloat16sr&  x)  { return cbrt(static_cast<float>(x)); }
     
-        friend inline bfloat16sr scalbn(const bfloat16sr&  x, int n)  { return scalbn(static_cast<float>(x), n); }
+        friend inline basic_bfloat16sr scalbn(const basic_bfloat16sr&  x, int n)  { return scalbn(static_cast<float>(x), n); }
+
+        // The exact result in double is rounded once, straight to bfloat16
+        friend inline basic_bfloat16sr fma(const basic_bfloat16sr& a, const basic_bfloat16sr& b, const basic_bfloat16sr& c) {
+            return fromDouble(std::fma(static_cast<double>(a), static_cast<double>(b), static_cast<double>(c)));
+        }
+
+        friend inline basic_bfloat16sr fma(double a, const basic_bfloat16sr& b, const basic_bfloat16sr& c) {
+            return fromDouble(std::fma(a, static_cast<double>(b), static_cast<double>(c)));
+        }
 
         /* Other functions */
-        friend inline bfloat16sr abs(const bfloat16sr&  x)  { return abs(static_cast<float>(x)); }
-        friend inline bfloat16sr fabs(const bfloat16sr&  x)  { return fabs(static_cast<float>(x)); }
-        friend inline bfloat16sr abs2(const bfloat16sr& x)  { return x*x; }
+        friend inline basic_bfloat16sr abs(const basic_bfloat16sr&  x)  { return abs(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr fabs(const basic_bfloat16sr&  x)  { return fabs(static_cast<float>(x)); }
+        friend inline basic_bfloat16sr abs2(const basic_bfloat16sr& x)  { return x*x; }
 
-        friend inline bfloat16sr copysign(const bfloat16sr&  x1, const bfloat16sr& x2)  { return copysign(static_cast<float>(x1), static_cast<float>(x2)); }
-        friend inline bfloat16sr fmax(const bfloat16sr&  x1, const bfloat16sr&  x2) { return x1 < x2 ? x1 : x2; }
-        friend inline bool isfinite(const bfloat16sr& x) { return true; }
+        friend inline basic_bfloat16sr copysign(const basic_bfloat16sr&  x1, const basic_bfloat16sr& x2)  { return copysign(static_cast<float>(x1), static_cast<float>(x2)); }
+        friend inline basic_bfloat16sr fmax(const basic_bfloat16sr&  x1, const basic_bfloat16sr&  x2) { return x1 < x2 ? x1 : x2; }
+        friend inline bool isfinite(const basic_bfloat16sr& x) { return true; }
 
     protected:
+        friend struct detail::PacketOps<basic_bfloat16sr>;
+
+        // Value with the given bits, no rounding and no random bits drawn
+        struct raw_tag {};
+        basic_bfloat16sr(raw_tag, int16_t raw): value(raw) {}
+
+        static basic_bfloat16sr fromDouble(double x) {
+            uint16_t bits = detail::round_double_to_bfloat16(x, RNG::template bits<32>());
+            return basic_bfloat16sr(raw_tag(), static_cast<int16_t>(bits));
+        }
+
         int16_t round(float rhs) {
             int16_t val = 0;
             int32_t rhs_int = reinterpret_cast<int32_t&>(rhs);
-            int32_t p = dist16(bint_generator);
+            int32_t p = RNG::template bits<res16_bits>();
 
             #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
                 memcpy(&val, &rhs, sizeof(val));
@@ -472,14 +532,193 @@ namespace rndcmp {
 
         int16_t value;
     };
+
+    using bfloat16sr = basic_bfloat16sr<>;
+
+    /* Array conversions */
+
+    namespace detail {
+        // words holds one 32-bit random word per element, its upper 16 bits are the threshold
+
+        inline void bfloat16_pack_sr_scalar(const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                uint32_t bits;
+                memcpy(&bits, src + i, sizeof(bits));
+                uint16_t val = static_cast<uint16_t>(bits >> 16);
+                if ((words[i] >> (32 - res16_bits)) < (bits & res16_mask)) {
+                    val += 1;
+                }
+                dst[i] = val;
+            }
+        }
+
+#if RNDCMP_X86_DISPATCH
+        RNDCMP_TARGET("avx2")
+        inline __m256i bfloat16_round_sr_avx2(__m256i x, __m256i w) {
+            const __m256i mask = _mm256_set1_epi32(res16_mask);
+            __m256i up = _mm256_cmpgt_epi32(_mm256_and_si256(x, mask), _mm256_srli_epi32(w, 32 - res16_bits));
+            // up is -1 in rounded lanes; the carry out of 0xffff is dropped like in the 16-bit scalar add
+            return _mm256_and_si256(_mm256_sub_epi32(_mm256_srli_epi32(x, 16), up), mask);
+        }
+
+        RNDCMP_TARGET("avx2")
+        inline void bfloat16_pack_sr_avx2(const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m256i a = bfloat16_round_sr_avx2(
+                    _mm256_castps_si256(_mm256_loadu_ps(src + i)),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i)));
+                __m256i b = bfloat16_round_sr_avx2(
+                    _mm256_castps_si256(_mm256_loadu_ps(src + i + 8)),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i + 8)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), bfloat16_pack_halves_avx2(a, b));
+            }
+            bfloat16_pack_sr_scalar(src + i, words + i, dst + i, n - i);
+        }
+
+        RNDCMP_TARGET("avx512f")
+        inline void bfloat16_pack_sr_avx512(const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+            const __m512i mask = _mm512_set1_epi32(res16_mask);
+            const __m512i one = _mm512_set1_epi32(1);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m512i x = _mm512_castps_si512(_mm512_loadu_ps(src + i));
+                __m512i p = _mm512_srli_epi32(_mm512_loadu_si512(words + i), 32 - res16_bits);
+                __mmask16 up = _mm512_cmpgt_epi32_mask(_mm512_and_si512(x, mask), p);
+                __m512i high = _mm512_srli_epi32(x, 16);
+                // Truncating narrow drops the carry out of 0xffff
+                __m256i packed = _mm512_cvtepi32_epi16(_mm512_mask_add_epi32(high, up, high, one));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+            }
+            bfloat16_pack_sr_scalar(src + i, words + i, dst + i, n - i);
+        }
+#endif
+
+        inline void bfloat16_pack_sr(simd::Isa isa, const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if (isa == simd::Isa::Avx512) {
+                bfloat16_pack_sr_avx512(src, words, dst, n);
+                return;
+            }
+            if (isa == simd::Isa::Avx2) {
+                bfloat16_pack_sr_avx2(src, words, dst, n);
+                return;
+            }
+#endif
+            bfloat16_pack_sr_scalar(src, words, dst, n);
+        }
+    }
+
+    // Stochastically rounds n floats to bfloat16, same distribution as basic_bfloat16sr<RNG>(src[i])
+    template<typename RNG>
+    void round_sr(const float* src, basic_bfloat16sr<RNG>* dst, size_t n) {
+        static_assert(sizeof(basic_bfloat16sr<RNG>) == sizeof(uint16_t), "bfloat16sr must have the layout of its 16-bit pattern");
+        uint16_t* raw = reinterpret_cast<uint16_t*>(dst);
+        uint32_t words[simd::block_size];
+        simd::Isa isa = simd::active_isa();
+        for (size_t i = 0; i < n; i += simd::block_size) {
+            size_t count = std::min(n - i, static_cast<size_t>(simd::block_size));
+            RNG::words(words, count);
+            detail::bfloat16_pack_sr(isa, src + i, words, raw + i, count);
+        }
+    }
+
+    // Rounds n doubles with the given 32-bit threshold words, one per element, instead of drawing them from RNG
+    template<typename RNG>
+    void round_sr(const double* src, const uint32_t* words, basic_bfloat16sr<RNG>* dst, size_t n) {
+        uint16_t* raw = reinterpret_cast<uint16_t*>(dst);
+        for (size_t i = 0; i < n; i++) {
+            raw[i] = detail::round_double_to_bfloat16(src[i], words[i]);
+        }
+    }
+
+    // Widens n bfloat16sr values to float
+    template<typename RNG>
+    void convert(const basic_bfloat16sr<RNG>* src, float* dst, size_t n) {
+        detail::bfloat16_unpack(simd::active_isa(), reinterpret_cast<const uint16_t*>(src), dst, n);
+    }
+
+    /* Eigen packet math */
+
+    namespace detail {
+        // Lanes are computed in float and rounded with the block kernels, as the scalar operators do
+        template<typename RNG>
+        struct PacketOps<basic_bfloat16sr<RNG>> {
+            using lane_t = uint16_t;
+            using scalar_t = basic_bfloat16sr<RNG>;
+
+            static uint16_t lane(const scalar_t& x) {
+                return static_cast<uint16_t>(x.value);
+            }
+
+            static scalar_t scalar(uint16_t raw) {
+                return scalar_t(typename scalar_t::raw_tag(), static_cast<int16_t>(raw));
+            }
+
+            static void add(const uint16_t* a, const uint16_t* b, uint16_t* out) {
+                float x[packet_size], y[packet_size];
+                unpack(a, b, x, y);
+                for (int i = 0; i < packet_size; i++) {
+                    x[i] += y[i];
+                }
+                round(x, out);
+            }
+
+            static void sub(const uint16_t* a, const uint16_t* b, uint16_t* out) {
+                float x[packet_size], y[packet_size];
+                unpack(a, b, x, y);
+                for (int i = 0; i < packet_size; i++) {
+                    x[i] -= y[i];
+                }
+                round(x, out);
+            }
+
+            static void mul(const uint16_t* a, const uint16_t* b, uint16_t* out) {
+                float x[packet_size], y[packet_size];
+                unpack(a, b, x, y);
+                for (int i = 0; i < packet_size; i++) {
+                    x[i] *= y[i];
+                }
+                round(x, out);
+            }
+
+            static void div(const uint16_t* a, const uint16_t* b, uint16_t* out) {
+                float x[packet_size], y[packet_size];
+                unpack(a, b, x, y);
+                for (int i = 0; i < packet_size; i++) {
+                    x[i] /= y[i];
+                }
+                round(x, out);
+            }
+
+            // Negation is exact, only the sign bit changes
+            static void negate(const uint16_t* a, uint16_t* out) {
+                for (int i = 0; i < packet_size; i++) {
+                    out[i] = a[i] ^ 0x8000;
+                }
+            }
+
+        private:
+            static void unpack(const uint16_t* a, const uint16_t* b, float* x, float* y) {
+                bfloat16_unpack_scalar(a, x, packet_size);
+                bfloat16_unpack_scalar(b, y, packet_size);
+            }
+
+            static void round(const float* src, uint16_t* out) {
+                uint32_t words[packet_size];
+                RNG::words(words, packet_size);
+                bfloat16_pack_sr(simd::active_isa(), src, words, out, packet_size);
+            }
+        };
+    }
 }
 
 namespace Eigen {
     // Inheritance from float is a temporary bad solution. Need specify all NumTraits explicitly
-    template<> struct NumTraits<rndcmp::bfloat16sr>: NumTraits<float> {
-        typedef rndcmp::bfloat16sr Real;
-        typedef rndcmp::bfloat16sr NonInteger;
-        typedef rndcmp::bfloat16sr Nested;
+    template<typename RNG> struct NumTraits<rndcmp::basic_bfloat16sr<RNG>>: NumTraits<float> {
+        typedef rndcmp::basic_bfloat16sr<RNG> Real;
+        typedef rndcmp::basic_bfloat16sr<RNG> NonInteger;
+        typedef rndcmp::basic_bfloat16sr<RNG> Nested;
         
         enum {
             IsComplex = 0,
@@ -493,4 +732,6 @@ namespace Eigen {
     };
 }
 
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::bfloat16sr)
+
 #endif  // RNDCMP_INCLUDE_BFLOAT16SR_HPP_
\ No newline at end of file
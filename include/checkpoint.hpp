@@ -0,0 +1,259 @@
+#ifndef RNDCMP_INCLUDE_CHECKPOINT_HPP_
+#define RNDCMP_INCLUDE_CHECKPOINT_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "random.hpp"
+
+
+// Checkpoints of long runs: binary files with the state of an integrator and the position of the random stream
+// it draws from, so that a preempted run continues bit for bit (see CheckpointedRun::setCheckpoint).
+// Values are stored as their bytes in the byte order of the machine; a checkpoint is meant to be read back by
+// the same build.
+namespace rndcmp {
+
+    namespace detail {
+        // Policies with a position that can be saved, see EngineRng::Snapshot
+        template<typename RNG, typename = void>
+        struct has_snapshot: std::false_type {};
+
+        template<typename RNG>
+        struct has_snapshot<RNG, std::void_t<typename RNG::Snapshot>>: std::true_type {};
+
+        // Sinks that buffer their output and write it out on flush(), see BinaryFileSink
+        template<typename SINK, typename = void>
+        struct has_flush: std::false_type {};
+
+        template<typename SINK>
+        struct has_flush<SINK, std::void_t<decltype(std::declval<SINK&>().flush())>>: std::true_type {};
+
+        constexpr char checkpoint_magic[8] = {'R', 'N', 'D', 'C', 'M', 'P', 'C', 'K'};
+        constexpr std::uint32_t checkpoint_version = 1;
+    }
+
+    // Writes a checkpoint next to path and puts it in place on commit(), so an interrupted write leaves
+    // the previous checkpoint intact
+    class CheckpointWriter {
+    public:
+        CheckpointWriter(const std::string& path): _path(path), _file(path + ".tmp", std::ios::binary | std::ios::trunc) {
+            if (!_file) {
+                throw std::runtime_error("cannot open " + path + ".tmp");
+            }
+            _file.write(detail::checkpoint_magic, sizeof(detail::checkpoint_magic));
+            write(detail::checkpoint_version);
+        }
+
+        template<typename T>
+        void write(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "values are stored as their bytes");
+            _file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        // Size, element size and the elements of a state: std::vector, std::array or a fixed-size Eigen vector
+        template<typename STATE>
+        void writeRange(const STATE& values) {
+            write(static_cast<std::uint64_t>(values.size()));
+            write(static_cast<std::uint32_t>(sizeof(values[0])));
+            for (std::size_t i = 0; i < static_cast<std::size_t>(values.size()); i++) {
+                write(values[i]);
+            }
+        }
+
+        // Position of the stream of the calling thread that T rounds with
+        template<typename T>
+        void writeRng() {
+            using RNG = typename detail::rng_policy<T>::type;
+            if constexpr (detail::has_snapshot<RNG>::value) {
+                write(true);
+                write(RNG::save());
+            } else {
+                write(false);
+            }
+        }
+
+        void commit() {
+            _file.close();
+            if (!_file || std::rename((_path + ".tmp").c_str(), _path.c_str()) != 0) {
+                throw std::runtime_error("cannot write " + _path);
+            }
+        }
+
+    private:
+        std::string _path;
+        std::ofstream _file;
+    };
+
+    class CheckpointReader {
+    public:
+        CheckpointReader(const std::string& path): _path(path), _file(path, std::ios::binary) {
+            if (!_file) {
+                throw std::runtime_error("cannot open " + path);
+            }
+            char magic[sizeof(detail::checkpoint_magic)];
+            _file.read(magic, sizeof(magic));
+            if (!_file || !std::equal(magic, magic + sizeof(magic), detail::checkpoint_magic) ||
+                read<std::uint32_t>() != detail::checkpoint_version) {
+                throw std::runtime_error(path + " is not a checkpoint");
+            }
+        }
+
+        template<typename T>
+        T read() {
+            static_assert(std::is_trivially_copyable_v<T>, "values are stored as their bytes");
+            T value;
+            _file.read(reinterpret_cast<char*>(&value), sizeof(T));
+            if (!_file) {
+                throw std::runtime_error(_path + " is truncated");
+            }
+            return value;
+        }
+
+        // The stored size has to be the size of values
+        template<typename STATE>
+        void readRange(STATE& values) {
+            if (read<std::uint64_t>() != static_cast<std::uint64_t>(values.size())) {
+                throw std::runtime_error(_path + " does not match the dimension of the system");
+            }
+            if (read<std::uint32_t>() != sizeof(values[0])) {
+                throw std::runtime_error(_path + " was written for another number type");
+            }
+            for (std::size_t i = 0; i < static_cast<std::size_t>(values.size()); i++) {
+                values[i] = read<std::decay_t<decltype(values[i])>>();
+            }
+        }
+
+        // Moves the stream of the calling thread that T rounds with to the stored position
+        template<typename T>
+        void readRng() {
+            using RNG = typename detail::rng_policy<T>::type;
+            bool stored = read<bool>();
+            if constexpr (detail::has_snapshot<RNG>::value) {
+                if (!stored) {
+                    throw std::runtime_error(_path + " has no random stream position");
+                }
+                RNG::restore(read<typename RNG::Snapshot>());
+            } else if (stored) {
+                throw std::runtime_error(_path + " was written for a stochastic type");
+            }
+        }
+
+        // Checks a parameter of the run against the value the checkpoint was written with
+        template<typename T>
+        void expect(const T& value, const char* name) {
+            if (read<T>() != value) {
+                throw std::runtime_error(_path + " was written with another " + name);
+            }
+        }
+
+    private:
+        std::string _path;
+        std::ifstream _file;
+    };
+
+    // Run of an integrator from timeStart to timeEnd with the step it starts from, and its checkpoints.
+    // IntegratorBase and StaticIntegratorBase derive from it, so both write the same files: a header with the
+    // run, the time and the number of points, then the state, the state of the method and the position of the
+    // random stream the number type rounds with.
+    class CheckpointedRun {
+    public:
+        CheckpointedRun(double timeStart, double timeEnd, double step):
+        _timeStart(timeStart), _timeEnd(timeEnd), _step(step) {}
+
+        // Writes a checkpoint to path after every `every` steps of solve(): the time, the state, the state of
+        // the method and the position of the random stream DTYPE rounds with on the calling thread. 0 turns it off.
+        // A sink with a flush() (BinaryFileSink) is flushed before every checkpoint.
+        void setCheckpoint(const std::string& path, size_t every) {
+            _checkpointPath = path;
+            _checkpointEvery = every;
+        }
+
+        // The next solve() continues the run from a checkpoint instead of starting from the initial point and gives
+        // the points of the run that has not stopped bit for bit, given the same system, times and initial vector.
+        // The random stream continues from the stored position whatever the seed of the calling thread. The points
+        // up to the checkpoint are not passed to the sink (nor kept by solve()) again; returns their number,
+        // e.g. for BinaryFileSink(path, records, dimension).
+        size_t resumeFrom(const std::string& path) {
+            CheckpointReader reader(path);
+            double t;
+            size_t points = readHeader(reader, t);
+            _resumePath = path;
+            return points;
+        }
+
+        // Points of the loop t = timeStart; t <= timeEnd; t += step plus the initial one, up to the rounding of t.
+        // Enough to reserve the storage of a sink, e.g. Trajectory<DTYPE>(integrator.expectedPoints(), dimension)
+        size_t expectedPoints() const {
+            return _step > 0 && _timeEnd >= _timeStart ? static_cast<size_t>((_timeEnd - _timeStart) / _step) + 2 : 1;
+        }
+
+    protected:
+        bool resuming() const {
+            return !_resumePath.empty();
+        }
+
+        // Whether solve() writes a checkpoint once it has passed the given number of points
+        bool checkpointDue(size_t points) const {
+            return _checkpointEvery > 0 && (points - 1) % _checkpointEvery == 0;
+        }
+
+        // saveState(writer) writes the state of the method kept between the steps. The sink is flushed first, so
+        // a run killed after the checkpoint has every point it counts on disk.
+        template<typename DTYPE, typename SINK, typename STATE, typename SAVE>
+        void writeCheckpoint(SINK& sink, double t, size_t points, const STATE& x, SAVE&& saveState) const {
+            if constexpr (detail::has_flush<SINK>::value) {
+                sink.flush();
+            }
+            CheckpointWriter writer(_checkpointPath);
+            writer.write(_timeStart);
+            writer.write(_timeEnd);
+            writer.write(_step);
+            writer.write(t);
+            writer.write(static_cast<std::uint64_t>(points));
+            writer.writeRange(x);
+            saveState(writer);
+            writer.writeRng<DTYPE>();
+            writer.commit();
+        }
+
+        // Reads the checkpoint given to resumeFrom() into x and loadState(reader), returns its time
+        template<typename DTYPE, typename STATE, typename LOAD>
+        double readCheckpoint(STATE& x, size_t& points, LOAD&& loadState) {
+            CheckpointReader reader(_resumePath);
+            _resumePath.clear();
+            double t;
+            points = readHeader(reader, t);
+            reader.readRange(x);
+            loadState(reader);
+            reader.readRng<DTYPE>();
+            return t;
+        }
+
+        double _timeStart;
+        double _timeEnd;
+        double _step;
+
+    private:
+        // Checks the run of a checkpoint, reads its time and returns the number of its points
+        size_t readHeader(CheckpointReader& reader, double& t) const {
+            reader.expect(_timeStart, "start time");
+            reader.expect(_timeEnd, "end time");
+            reader.expect(_step, "step");
+            t = reader.read<double>();
+            return static_cast<size_t>(reader.read<std::uint64_t>());
+        }
+
+        std::string _checkpointPath;
+        size_t _checkpointEvery = 0;
+        std::string _resumePath;
+    };
+}
+
+#endif  // RNDCMP_INCLUDE_CHECKPOINT_HPP_
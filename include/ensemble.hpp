@@ -0,0 +1,286 @@
+#ifndef RNDCMP_INCLUDE_ENSEMBLE_HPP_
+#define RNDCMP_INCLUDE_ENSEMBLE_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+
+#include "simd.hpp"
+#include "integrator.hpp"
+#include "sinks.hpp"
+#include "random.hpp"
+
+
+namespace rndcmp {
+
+    // States of all the members of an ensemble: a row per member, a column per component. The storage is
+    // column-major, so every component is one contiguous array over the members (structure of arrays).
+    template<typename T>
+    using EnsembleState = Eigen::Array<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+    namespace detail {
+        template<typename RNG>
+        constexpr bool is_stochastic_policy() {
+            if constexpr (std::is_void_v<RNG>) {
+                return false;
+            } else {
+                return RNG::is_stochastic;
+            }
+        }
+
+        // Types with an array kernel round_sr(const double*, const uint32_t* words, T*, n) that takes its random
+        // words instead of drawing them
+        template<typename T, typename = void>
+        struct has_word_rounding: std::false_type {};
+
+        template<typename T>
+        struct has_word_rounding<T, std::void_t<decltype(round_sr(std::declval<const double*>(), std::declval<const std::uint32_t*>(), std::declval<T*>(), std::size_t()))>>:
+            std::true_type {};
+
+        // Random words of one rounding pass over an ensemble stored column by column: the word of member m and
+        // component i is out[i * members + m]. Member m draws from the Philox stream (seed, m); position enumerates
+        // the passes, so any pass of any member is a single counter away and nothing is saved between the steps.
+        inline void member_words(std::uint64_t seed, std::uint64_t position, std::size_t members, std::size_t components, std::uint32_t* out) {
+            const Philox4x32::key_type key = {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+            std::size_t groups = (components + 3) / 4;
+            for (std::size_t m = 0; m < members; m++) {
+                for (std::size_t g = 0; g < groups; g++) {
+                    std::uint64_t block = position * groups + g;
+                    Philox4x32::counter_type words = Philox4x32::generate({
+                        static_cast<std::uint32_t>(block), static_cast<std::uint32_t>(block >> 32),
+                        static_cast<std::uint32_t>(m), static_cast<std::uint32_t>(static_cast<std::uint64_t>(m) >> 32)
+                    }, key);
+                    for (std::size_t j = 0; j < 4 && 4 * g + j < components; j++) {
+                        out[(4 * g + j) * members + m] = words[j];
+                    }
+                }
+            }
+        }
+
+        // out[i] = c[i] + a * b[i], the same rounding as multiply_add(a, b[i], c[i])
+        template<typename T>
+        void multiply_add(double a, const T* b, const T* c, T* out, std::size_t n) {
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = multiply_add(a, b[i], c[i]);
+            }
+        }
+
+        // The same with the random words given, one per element. The fused products of a block are rounded to
+        // double and then stochastically, so unlike fma of FloatSR the rest beyond the double is not kept.
+        template<typename T>
+        void multiply_add(double a, const T* b, const T* c, T* out, std::size_t n, const std::uint32_t* words) {
+            double wide[simd::block_size];
+            for (std::size_t i = 0; i < n; i += simd::block_size) {
+                std::size_t count = std::min(n - i, static_cast<std::size_t>(simd::block_size));
+                for (std::size_t j = 0; j < count; j++) {
+                    wide[j] = std::fma(a, static_cast<double>(b[i + j]), static_cast<double>(c[i + j]));
+                }
+                round_sr(wide, words + i, out + i, count);
+            }
+        }
+    }
+
+    // Ensemble form of a system f(const std::vector<T>& x, double t, std::vector<T>& dxdt), evaluated member
+    // by member. Systems written for the whole ensemble at once vectorize better, e.g. for Lorenz:
+    //     dxdt.col(0) = T(10.0) * (x.col(1) - x.col(0));
+    template<typename T, typename SYSTEM = ComponentSystem<T>>
+    class MemberSystem {
+    public:
+        MemberSystem(const SYSTEM& system): _system(system) {}
+
+        void operator()(const EnsembleState<T>& x, double t, EnsembleState<T>& dxdt) {
+            _x.resize(x.cols());
+            _dxdt.resize(x.cols());
+            for (Eigen::Index m = 0; m < x.rows(); m++) {
+                for (Eigen::Index i = 0; i < x.cols(); i++) {
+                    _x[i] = x(m, i);
+                }
+                _system(_x, t, _dxdt);
+                for (Eigen::Index i = 0; i < x.cols(); i++) {
+                    dxdt(m, i) = _dxdt[i];
+                }
+            }
+        }
+
+    private:
+        SYSTEM _system;
+        std::vector<T> _x;
+        std::vector<T> _dxdt;
+    };
+
+    // Advances an ensemble of trajectories with RK4 in lockstep. SYSTEM is a callable
+    // f(const EnsembleState<DTYPE>& x, double t, EnsembleState<DTYPE>& dxdt) over all the members; with the
+    // Eigen packet math of the SR types every operation of it rounds a block of members at once.
+    //
+    // The stages and the update are rounded a whole pass over the ensemble at a time. For the SR types with
+    // a word kernel (FloatSR, bfloat16sr, SRFloat) member m rounds them with the words of the Philox stream
+    // (seed, m), counted by the step and the pass, so these roundings of a member do not depend on the size
+    // of the ensemble. Every solve() draws a new seed from the stream of the calling thread that DTYPE rounds
+    // with, like gemm and run_trials, so consecutive runs are independent and a seeded run replays.
+    // SYSTEM and the SR types without a word kernel (halfsr, FixedSR) draw from the one stream (seed, members)
+    // in the order of the members: their roundings of a member depend on the members before it.
+    template<typename DTYPE, typename SYSTEM>
+    class EnsembleIntegrator {
+    public:
+        using IntegratorException = typename IntegratorBase<DTYPE>::IntegratorException;
+
+    private:
+        using RNG = typename detail::rng_policy<DTYPE>::type;
+
+    public:
+        // Whether the stages and the update round with the per-member Philox words
+        static constexpr bool member_streams = detail::is_stochastic_policy<RNG>() && detail::has_fused_multiply_add<DTYPE>::value &&
+                                               detail::has_word_rounding<DTYPE>::value;
+
+        EnsembleIntegrator(const SYSTEM& system, size_t members, double timeStart, double timeEnd, double step):
+        _system(system), _members(members), _timeStart(timeStart), _timeEnd(timeEnd), _step(step) {}
+
+        // Every member starts from the same point
+        void setInitial(const std::vector<DTYPE>& initial) {
+            _initial.resize(_members, initial.size());
+            for (size_t i = 0; i < initial.size(); i++) {
+                _initial.col(i).setConstant(initial[i]);
+            }
+        }
+
+        // A row of initial per member
+        void setInitialMembers(const EnsembleState<DTYPE>& initial) {
+            if (static_cast<size_t>(initial.rows()) != _members) {
+                throw IntegratorException("incorrect number of members");
+            }
+            _initial = initial;
+        }
+
+        // Keeps the mean and the sample variance over the members of every point, see getMean() and getVariance()
+        void solve() {
+            _mean = Trajectory<double>(expectedPoints(), _initial.cols());
+            _variance = Trajectory<double>(expectedPoints(), _initial.cols());
+            std::vector<double> mean(_initial.cols()), variance(_initial.cols());
+            solve([this, &mean, &variance](double t, const EnsembleState<DTYPE>& x) {
+                for (Eigen::Index i = 0; i < x.cols(); i++) {
+                    double sum = 0.0;
+                    for (Eigen::Index m = 0; m < x.rows(); m++) {
+                        sum += static_cast<double>(x(m, i));
+                    }
+                    mean[i] = sum / x.rows();
+                    double square = 0.0;
+                    for (Eigen::Index m = 0; m < x.rows(); m++) {
+                        double delta = static_cast<double>(x(m, i)) - mean[i];
+                        square += delta * delta;
+                    }
+                    variance[i] = x.rows() > 1 ? square / (x.rows() - 1) : 0.0;
+                }
+                _mean(t, mean);
+                _variance(t, variance);
+            });
+        }
+
+        // Passes the states of all the members at every point to sink(t, x)
+        template<typename SINK>
+        void solve(SINK&& sink) {
+            _x = _initial;
+            for (auto* buffer : {&_k1, &_k2, &_k3, &_k4, &_stage}) {
+                buffer->resize(_x.rows(), _x.cols());
+            }
+            _seed = detail::worker_seed<DTYPE>();
+            _pass = 0;
+            if constexpr (member_streams) {
+                _words.resize(_x.size());
+            }
+            RngContext context(_seed, _members);
+            sink(_timeStart, static_cast<const EnsembleState<DTYPE>&>(_x));
+            for (double t = _timeStart; t <= _timeEnd; t+=_step) {
+                step(t);
+                sink(t + _step, static_cast<const EnsembleState<DTYPE>&>(_x));
+            }
+        }
+
+        const Trajectory<double>& getMean() const {
+            return _mean;
+        }
+
+        const Trajectory<double>& getVariance() const {
+            return _variance;
+        }
+
+        size_t members() const {
+            return _members;
+        }
+
+        size_t expectedPoints() const {
+            return _step > 0 && _timeEnd >= _timeStart ? static_cast<size_t>((_timeEnd - _timeStart) / _step) + 2 : 1;
+        }
+
+    protected:
+        // The stages and the update of all the members at once, rounding as RK4Integrator does
+        void step(double t) {
+            _system(_x, t, _k1);
+            stage(_step / 2., _k1);
+            _system(_stage, t + _step / 2., _k2);
+            stage(_step / 2., _k2);
+            _system(_stage, t + _step / 2., _k3);
+            stage(_step, _k3);
+            _system(_stage, t + _step, _k4);
+
+            size_t n = _x.size();
+            if constexpr (detail::has_fused_multiply_add<DTYPE>::value) {
+                // _stage holds the sum k1 + 2 k2 + 2 k3 + k4
+                multiplyAdd(2., _k2.data(), _k1.data(), _stage.data());
+                multiplyAdd(2., _k3.data(), _stage.data(), _stage.data());
+                if constexpr (member_streams) {
+                    multiplyAdd(1., _k4.data(), _stage.data(), _stage.data());
+                } else {
+                    _stage += _k4;
+                }
+                multiplyAdd(_step / 6., _stage.data(), _x.data(), _x.data());
+            } else {
+                DTYPE* x = _x.data();
+                for (size_t i = 0; i < n; i++) {
+                    x[i] = DTYPE(x[i] + _step / 6. * (_k1.data()[i] + 2. * _k2.data()[i] + 2. * _k3.data()[i] + _k4.data()[i]));
+                }
+            }
+        }
+
+        void stage(double h, const EnsembleState<DTYPE>& k) {
+            multiplyAdd(h, k.data(), _x.data(), _stage.data());
+        }
+
+        // out = c + a * b over the whole ensemble, one rounding pass
+        void multiplyAdd(double a, const DTYPE* b, const DTYPE* c, DTYPE* out) {
+            if constexpr (member_streams) {
+                detail::member_words(_seed, _pass++, _members, static_cast<size_t>(_x.cols()), _words.data());
+                detail::multiply_add(a, b, c, out, static_cast<size_t>(_x.size()), _words.data());
+            } else {
+                detail::multiply_add(a, b, c, out, static_cast<size_t>(_x.size()));
+            }
+        }
+
+        SYSTEM _system;
+        size_t _members;
+        double _timeStart;
+        double _timeEnd;
+        double _step;
+
+        EnsembleState<DTYPE> _initial;
+        EnsembleState<DTYPE> _x;
+        EnsembleState<DTYPE> _k1, _k2, _k3, _k4;
+        EnsembleState<DTYPE> _stage;
+        // Seed of the member streams, the rounding passes done so far and the words of the current one
+        std::uint64_t _seed = 0;
+        std::uint64_t _pass = 0;
+        std::vector<std::uint32_t> _words;
+        Trajectory<double> _mean;
+        Trajectory<double> _variance;
+    };
+
+    template<typename DTYPE, typename SYSTEM>
+    EnsembleIntegrator<DTYPE, SYSTEM> make_ensemble_integrator(const SYSTEM& system, size_t members, double timeStart, double timeEnd, double step) {
+        return EnsembleIntegrator<DTYPE, SYSTEM>(system, members, timeStart, timeEnd, step);
+    }
+}
+
+#endif  // RNDCMP_INCLUDE_ENSEMBLE_HPP_
@@ -1,12 +1,15 @@
 #ifndef RNDCMP_INCLUDE_ESN_HPP_
 #define RNDCMP_INCLUDE_ESN_HPP_
 
+#include <optional>
 #include <random>
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 #include <Eigen/SVD>
 #include <Eigen/QR>
 
+#include "gemm.hpp"
+
 
 namespace rndcmp {
     template<typename DATA_TYPE>
@@ -42,7 +45,9 @@ namespace rndcmp {
             rescale_weight_m(spectral_radius);
         }
 
-        double fit(ESNMatrix inputs, ESNMatrix outputs) {
+        // Takes any Eigen expression of DATA_TYPE, e.g. a Trajectory::matrix() view, without copying it
+        template<typename INPUTS, typename OUTPUTS>
+        double fit(const Eigen::MatrixBase<INPUTS>& inputs, const Eigen::MatrixBase<OUTPUTS>& outputs) {
             ESNMatrix states;
             states.resize(inputs.rows(), _hidden_size);
             states.setZero();
@@ -78,7 +83,8 @@ namespace rndcmp {
             return pred;
         }
 
-        ESNMatrix predict(ESNMatrix inputs, size_t n_future) {
+        template<typename INPUTS>
+        ESNMatrix predict(const Eigen::MatrixBase<INPUTS>& inputs, size_t n_future) {
             size_t n_samples = inputs.rows();
             ESNMatrix outputs;
             outputs.resize(n_samples + n_future, _output_size);
@@ -108,23 +114,36 @@ namespace rndcmp {
             return outputs;
         }
 
-        ESNMatrix predict(ESNMatrix inputs) {
+        // Computes the reservoir update with rndcmp::gemm instead of Eigen products
+        void setGemmOptions(const GemmOptions& options) {
+            _gemm = options;
+        }
+
+        template<typename INPUTS>
+        ESNMatrix predict(const Eigen::MatrixBase<INPUTS>& inputs) {
             return predict(inputs, 0);
         }
 
-        double score(ESNMatrix x, ESNMatrix y) {
+        template<typename X, typename Y>
+        double score(const Eigen::MatrixBase<X>& x, const Eigen::MatrixBase<Y>& y) {
             ESNMatrix y_pred = predict(x);
             return error(y, y_pred);
         }
 
-        double error(ESNMatrix y, ESNMatrix y_pred) {
+        template<typename Y, typename PREDICTED>
+        double error(const Eigen::MatrixBase<Y>& y, const Eigen::MatrixBase<PREDICTED>& y_pred) {
             Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> error_m = (y - y_pred).template cast<double>();
             return sqrt((error_m.array() * error_m.array()).matrix().rowwise().sum().mean());
         }
 
     protected:
         ESNMatrix update(ESNMatrix state, ESNMatrix input_vector) {
-            ESNMatrix preactivation = W * state.matrix() + W_in * input_vector.matrix();
+            ESNMatrix preactivation;
+            if (_gemm) {
+                preactivation = multiply(W, state, *_gemm) + multiply(W_in, input_vector, *_gemm);
+            } else {
+                preactivation = W * state.matrix() + W_in * input_vector.matrix();
+            }
             return preactivation.array().tanh();
         }
 
@@ -173,6 +192,7 @@ namespace rndcmp {
         size_t _hidden_size;
         size_t _output_size;
         double _regularization;
+        std::optional<GemmOptions> _gemm;
     };
 }
 
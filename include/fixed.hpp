@@ -2,11 +2,57 @@
 #define RNDCMP_INCLUDE_FIXED_HPP_
 
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 #include <Eigen/Core>
 
 
 namespace rndcmp {
-    template<typename INT_T, int FRACT_SIZE = 0, int POW = 2>
+    namespace detail {
+        // Signed integer of twice the width, holds the exact product of two INT_T values
+        template<typename INT_T> struct wider;
+        template<> struct wider<std::int8_t> { using type = std::int16_t; };
+        template<> struct wider<std::int16_t> { using type = std::int32_t; };
+        template<> struct wider<std::int32_t> { using type = std::int64_t; };
+        template<> struct wider<std::int64_t> { using type = __int128; };
+
+        template<typename INT_T>
+        using wider_t = typename wider<INT_T>::type;
+
+        // Narrows with two's complement wrap-around, like fixed-point hardware does on overflow
+        template<typename INT_T, typename WIDE_T>
+        constexpr INT_T wrap(WIDE_T v) {
+            using unsigned_t = std::make_unsigned_t<INT_T>;
+            return static_cast<INT_T>(static_cast<unsigned_t>(v));
+        }
+
+        // Integer of any width clamped to the range of WIDE_T
+        template<typename WIDE_T, typename T>
+        constexpr WIDE_T saturate(T v) {
+            if constexpr (std::numeric_limits<T>::digits <= static_cast<int>(sizeof(WIDE_T) * 8 - 1)) {
+                return static_cast<WIDE_T>(v);
+            } else {
+                if (v > static_cast<T>(std::numeric_limits<WIDE_T>::max())) {
+                    return std::numeric_limits<WIDE_T>::max();
+                }
+                if constexpr (std::is_signed_v<T>) {
+                    if (v < static_cast<T>(std::numeric_limits<WIDE_T>::min())) {
+                        return std::numeric_limits<WIDE_T>::min();
+                    }
+                }
+                return static_cast<WIDE_T>(v);
+            }
+        }
+    }
+
+    // How Fixed rounds results that do not fit into FRACT_SIZE fractional bits
+    enum class FixedRounding {
+        Truncate,   // toward zero
+        Nearest     // ties away from zero
+    };
+
+    template<typename INT_T, int FRACT_SIZE = 0, int POW = 2, FixedRounding ROUNDING = FixedRounding::Truncate>
     class Fixed {
     public:
         Fixed() = default;
@@ -20,12 +66,12 @@ namespace rndcmp {
 
         template<typename T>
         Fixed(T v, std::enable_if_t<std::is_integral_v<T>, int> = 0) {
-            setValueFromT(static_cast<double>(v));
+            value = detail::wrap<INT_T>(wrapped(v) * one);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
         operator T() const {
-            return static_cast<T>(value) / (1 << FRACT_SIZE);
+            return static_cast<T>(value) / (std::int64_t(1) << FRACT_SIZE);
         }
 
         /* + operators */
@@ -36,8 +82,7 @@ namespace rndcmp {
         }
 
         Fixed operator+(const Fixed& rhs) const {
-            double val = static_cast<double>(*this) + static_cast<double>(rhs);
-            return Fixed(val);
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) + rhs.value));
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
@@ -54,26 +99,23 @@ namespace rndcmp {
         }
 
         Fixed& operator+=(const Fixed& rhs) {
-            double sum = static_cast<double>(*this) + static_cast<double>(rhs);
-            setValueFromT(sum);
+            value = detail::wrap<INT_T>(wide_t(value) + rhs.value);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed operator+(const T& rhs) const {
-            return Fixed(double(*this) + double(rhs));
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) + wrapped(rhs) * one));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         friend Fixed operator+(T lhs, const Fixed& rhs) {
-            double val = double(lhs) + double(rhs);
-            return Fixed(val);
+            return rhs + lhs;
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed& operator+=(const T& rhs) {
-            double val = double(*this) + double(rhs);
-            setValueFromT<double>(val);
+            value = detail::wrap<INT_T>(wide_t(value) + wrapped(rhs) * one);
             return *this;
         }
 
@@ -85,8 +127,7 @@ namespace rndcmp {
         }
 
         Fixed operator-(const Fixed& rhs) const {
-            double val = static_cast<double>(*this) - static_cast<double>(rhs);
-            return Fixed(val);
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) - rhs.value));
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
@@ -97,8 +138,7 @@ namespace rndcmp {
         }
 
         Fixed& operator-=(const Fixed& rhs) {
-            double val = static_cast<double>(*this) - static_cast<double>(rhs);
-            setValueFromT(val);
+            value = detail::wrap<INT_T>(wide_t(value) - rhs.value);
             return *this;
         }
 
@@ -110,19 +150,17 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed operator-(const T& rhs) const {
-            return Fixed(double(*this) - double(rhs));
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) - wrapped(rhs) * one));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         friend Fixed operator-(T lhs, const Fixed& rhs) {
-            double val = double(lhs) - double(rhs);
-            return Fixed(val);
+            return fromRaw(detail::wrap<INT_T>(wrapped(lhs) * one - rhs.value));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed& operator-=(const T& rhs) {
-            double val = double(*this) - double(rhs);
-            setValueFromT<double>(val);
+            value = detail::wrap<INT_T>(wide_t(value) - wrapped(rhs) * one);
             return *this;
         }
 
@@ -134,12 +172,11 @@ namespace rndcmp {
         }
 
         Fixed operator*(const Fixed& rhs) const {
-            return Fixed(double(*this) * double(rhs));
+            return fromRaw(roundShifted(wide_t(value) * rhs.value));
         }
 
         Fixed& operator*=(const Fixed& rhs) {
-            double val = static_cast<double>(*this) * static_cast<double>(rhs);
-            setValueFromT(val);
+            value = roundShifted(wide_t(value) * rhs.value);
             return *this;
         }
 
@@ -156,21 +193,20 @@ namespace rndcmp {
             return Fixed(val);
         }
 
+        // Products with integers are exact
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed operator*(const T& rhs) const {
-            return Fixed(double(*this) * double(rhs));
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) * wrapped(rhs)));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         friend Fixed operator*(T lhs, const Fixed& rhs) {
-            double val = double(lhs) * double(rhs);
-            return Fixed(val);
+            return rhs * lhs;
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed& operator*=(const T& rhs) {
-            double val = double(*this) * double(rhs);
-            setValueFromT<double>(val);
+            value = detail::wrap<INT_T>(wide_t(value) * wrapped(rhs));
             return *this;
         }
 
@@ -182,7 +218,7 @@ namespace rndcmp {
         }
 
         Fixed operator/(const Fixed& rhs) const {
-            return Fixed(double(*this) / double(rhs));
+            return fromRaw(roundQuotient(wide_t(value) * one, rhs.value));
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
@@ -193,8 +229,7 @@ namespace rndcmp {
         }
 
         Fixed& operator/=(const Fixed& rhs) {
-            double val = static_cast<double>(*this) / static_cast<double>(rhs);
-            setValueFromT(val);
+            value = roundQuotient(wide_t(value) * one, rhs.value);
             return *this;
         }
 
@@ -206,7 +241,7 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed operator/(const T& rhs) const {
-            return Fixed(double(*this) / double(rhs));
+            return fromRaw(roundQuotient(value, detail::saturate<wide_t>(rhs)));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
@@ -217,8 +252,7 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         Fixed& operator/=(const T& rhs) {
-            double val = double(*this) / double(rhs);
-            setValueFromT<double>(val);
+            value = roundQuotient(value, detail::saturate<wide_t>(rhs));
             return *this;
         }
 
@@ -383,8 +417,7 @@ namespace rndcmp {
         /* unary minus */
 
         Fixed operator-() const {
-            double v = - static_cast<double>(*this);
-            return Fixed(v);
+            return fromRaw(detail::wrap<INT_T>(-wide_t(value)));
         }
 
         /* ostream overload */
@@ -432,21 +465,73 @@ namespace rndcmp {
         friend inline bool isfinite(const Fixed& x) { return true; }
 
     protected:
+        // Operations on two fixed-point values are computed exactly in the double-width integer type,
+        // only the final scaling is rounded
+        using wide_t = detail::wider_t<INT_T>;
+
+        static constexpr wide_t one = wide_t(1) << FRACT_SIZE;
+
+        // Integer operand of +, - and *: the wrapped result only depends on it modulo 2^(bits of INT_T), and the
+        // reduced value keeps the products in wide_t
+        template<typename T>
+        static wide_t wrapped(T v) {
+            return wide_t(detail::wrap<INT_T>(v));
+        }
+
         INT_T value;
     private:
+        static Fixed fromRaw(INT_T raw) {
+            Fixed result;
+            result.value = raw;
+            return result;
+        }
+
+        // Divides by 2^FRACT_SIZE
+        static INT_T roundShifted(wide_t v) {
+            if constexpr (FRACT_SIZE == 0) {
+                return detail::wrap<INT_T>(v);
+            } else if constexpr (ROUNDING == FixedRounding::Truncate) {
+                return detail::wrap<INT_T>(v / one);
+            } else {
+                wide_t magnitude = ((v < 0 ? -v : v) + one / 2) >> FRACT_SIZE;
+                return detail::wrap<INT_T>(v < 0 ? -magnitude : magnitude);
+            }
+        }
+
+        // Divisors beyond wide_t are saturated, which does not change a quotient of an INT_T numerator.
+        // Division by zero saturates to the limits of INT_T by the sign of the numerator, 0 / 0 gives 0.
+        static INT_T roundQuotient(wide_t num, wide_t den) {
+            if (den == 0) {
+                return num > 0 ? std::numeric_limits<INT_T>::max() : (num < 0 ? std::numeric_limits<INT_T>::min() : INT_T(0));
+            }
+            wide_t quotient = num / den;
+            if constexpr (ROUNDING == FixedRounding::Nearest) {
+                wide_t remainder = num % den;
+                if (2 * (remainder < 0 ? -remainder : remainder) >= (den < 0 ? -den : den)) {
+                    quotient += ((num < 0) != (den < 0)) ? -1 : 1;
+                }
+            }
+            return detail::wrap<INT_T>(quotient);
+        }
+
         template<typename T>
         void setValueFromT(T v) {
-            value = static_cast<INT_T>(v * (1 << FRACT_SIZE));
+            if constexpr (ROUNDING == FixedRounding::Truncate) {
+                value = static_cast<INT_T>(v * (std::int64_t(1) << FRACT_SIZE));
+            } else {
+                value = static_cast<INT_T>(std::round(v * (std::int64_t(1) << FRACT_SIZE)));
+            }
         }
     };
 }
 
 namespace Eigen {
     // Inheritance from float is a temporary bad solution. Need specify all NumTraits explicitly
-    template<typename INT_T, int FRACT_SIZE, int POW> struct NumTraits<rndcmp::Fixed<INT_T, FRACT_SIZE, POW>>: NumTraits<float> {
-        typedef rndcmp::Fixed<INT_T, FRACT_SIZE, POW> Real;
-        typedef rndcmp::Fixed<INT_T, FRACT_SIZE, POW> NonInteger;
-        typedef rndcmp::Fixed<INT_T, FRACT_SIZE, POW> Nested;
+    template<typename INT_T, int FRACT_SIZE, int POW, rndcmp::FixedRounding ROUNDING>
+    struct NumTraits<rndcmp::Fixed<INT_T, FRACT_SIZE, POW, ROUNDING>>: NumTraits<float> {
+        typedef rndcmp::Fixed<INT_T, FRACT_SIZE, POW, ROUNDING> Real;
+        typedef rndcmp::Fixed<INT_T, FRACT_SIZE, POW, ROUNDING> NonInteger;
+        typedef rndcmp::Fixed<INT_T, FRACT_SIZE, POW, ROUNDING> Nested;
         
         enum {
             IsComplex = 0,
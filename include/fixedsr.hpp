@@ -1,23 +1,25 @@
 #ifndef RNDCMP_INCLUDE_FIXEDSR_HPP_
 #define RNDCMP_INCLUDE_FIXEDSR_HPP_
 
+#include <algorithm>
 #include <type_traits>
+#include <cstdint>
 #include <cmath>
 #include <random>
 #include <iostream>
+#include <limits>
 
 #include "fixed.hpp"
+#include "random.hpp"
+#include "packet.hpp"
 
 
 namespace rndcmp {
     
-    static std::random_device rd;
-    static std::mt19937 generator = std::mt19937(rd());
-    static std::uniform_real_distribution distribution = std::uniform_real_distribution<double>(0.0,1.0);
-
-    template<typename INT_T, int FRACT_SIZE = 0, int POW = 2>
+    template<typename INT_T, int FRACT_SIZE = 0, int POW = 2, typename RNG = DefaultRng>
     class FixedSR: public Fixed<INT_T, FRACT_SIZE, POW> {
     public:
+        using rng_type = RNG;
         using Fixed<INT_T, FRACT_SIZE, POW>::value;
 
         /* Constructors */
@@ -31,7 +33,7 @@ namespace rndcmp {
 
         template<typename T>
         FixedSR(T v, std::enable_if_t<std::is_integral_v<T>, int> = 0) {
-            setValueFromT<double>(static_cast<double>(v));
+            value = detail::wrap<INT_T>(wrapped(v) * one);
         }
 
         /* + operators */
@@ -42,8 +44,7 @@ namespace rndcmp {
         }
 
         FixedSR operator+(const FixedSR& rhs) const {
-            double val = static_cast<double>(*this) + static_cast<double>(rhs);
-            return FixedSR(val);
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) + rhs.value));
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
@@ -54,8 +55,7 @@ namespace rndcmp {
         }
 
         FixedSR& operator+=(const FixedSR& rhs) {
-            double sum = static_cast<double>(*this) + static_cast<double>(rhs);
-            setValueFromT(sum);
+            value = detail::wrap<INT_T>(wide_t(value) + rhs.value);
             return *this;
         }
 
@@ -67,19 +67,17 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR operator+(const T& rhs) const {
-            return FixedSR(double(*this) + double(rhs));
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) + wrapped(rhs) * one));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         friend FixedSR operator+(T lhs, const FixedSR& rhs) {
-            double val = double(lhs) + double(rhs);
-            return FixedSR(val);
+            return rhs + lhs;
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR& operator+=(const T& rhs) {
-            double val = double(*this) + double(rhs);
-            setValueFromT<double>(val);
+            value = detail::wrap<INT_T>(wide_t(value) + wrapped(rhs) * one);
             return *this;
         }
 
@@ -91,8 +89,7 @@ namespace rndcmp {
         }
 
         FixedSR operator-(const FixedSR& rhs) const {
-            double val = static_cast<double>(*this) - static_cast<double>(rhs);
-            return FixedSR(val);
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) - rhs.value));
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
@@ -103,8 +100,7 @@ namespace rndcmp {
         }
 
         FixedSR& operator-=(const FixedSR& rhs) {
-            double val = static_cast<double>(*this) - static_cast<double>(rhs);
-            setValueFromT(val);
+            value = detail::wrap<INT_T>(wide_t(value) - rhs.value);
             return *this;
         }
 
@@ -116,19 +112,17 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR operator-(const T& rhs) const {
-            return FixedSR(double(*this) - double(rhs));
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) - wrapped(rhs) * one));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         friend FixedSR operator-(T lhs, const FixedSR& rhs) {
-            double val = double(lhs) - double(rhs);
-            return FixedSR(val);
+            return fromRaw(detail::wrap<INT_T>(wrapped(lhs) * one - rhs.value));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR& operator-=(const T& rhs) {
-            double val = double(*this) - double(rhs);
-            setValueFromT<double>(val);
+            value = detail::wrap<INT_T>(wide_t(value) - wrapped(rhs) * one);
             return *this;
         }
 
@@ -140,12 +134,11 @@ namespace rndcmp {
         }
 
         FixedSR operator*(const FixedSR& rhs) const {
-            return FixedSR(double(*this) * double(rhs));
+            return fromRaw(roundShifted(wide_t(value) * rhs.value));
         }
 
         FixedSR& operator*=(const FixedSR& rhs) {
-            double val = static_cast<double>(*this) * static_cast<double>(rhs);
-            setValueFromT(val);
+            value = roundShifted(wide_t(value) * rhs.value);
             return *this;
         }
 
@@ -162,21 +155,20 @@ namespace rndcmp {
             return FixedSR(val);
         }
 
+        // Products with integers are exact
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR operator*(const T& rhs) const {
-            return FixedSR(double(*this) * double(rhs));
+            return fromRaw(detail::wrap<INT_T>(wide_t(value) * wrapped(rhs)));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         friend FixedSR operator*(T lhs, const FixedSR& rhs) {
-            double val = double(lhs) * double(rhs);
-            return FixedSR(val);
+            return rhs * lhs;
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR& operator*=(const T& rhs) {
-            double val = double(*this) * double(rhs);
-            setValueFromT<double>(val);
+            value = detail::wrap<INT_T>(wide_t(value) * wrapped(rhs));
             return *this;
         }
 
@@ -184,7 +176,7 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
         FixedSR operator/(const T& rhs) const {
-            return FixedSR<INT_T, FRACT_SIZE, POW> (T(*this) / rhs);
+            return FixedSR(T(*this) / rhs);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
@@ -195,12 +187,11 @@ namespace rndcmp {
         }
 
         FixedSR operator/(const FixedSR& rhs) const {
-            return FixedSR(double(*this) / double(rhs));
+            return fromRaw(roundQuotient(wide_t(value) * one, rhs.value));
         }
 
         FixedSR& operator/=(const FixedSR& rhs) {
-            double val = static_cast<double>(*this) / static_cast<double>(rhs);
-            setValueFromT(val);
+            value = roundQuotient(wide_t(value) * one, rhs.value);
             return *this;
         }
 
@@ -212,7 +203,7 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR operator/(const T& rhs) const {
-            return FixedSR(double(*this) / double(rhs));
+            return fromRaw(roundQuotient(value, detail::saturate<wide_t>(rhs)));
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
@@ -223,16 +214,14 @@ namespace rndcmp {
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
         FixedSR& operator/=(const T& rhs) {
-            double val = double(*this) / double(rhs);
-            setValueFromT<double>(val);
+            value = roundQuotient(value, detail::saturate<wide_t>(rhs));
             return *this;
         }
 
         /* unary minus */
 
         FixedSR operator-() const {
-            double v = - static_cast<double>(*this);
-            return FixedSR(v);
+            return fromRaw(detail::wrap<INT_T>(-wide_t(value)));
         }
 
         /* ostream overload */
@@ -270,6 +259,38 @@ namespace rndcmp {
 
         friend inline FixedSR scalbn(const FixedSR&  x, int n)  { return scalbn(static_cast<double>(x), n); }
 
+        /* Fused multiply-add: a * b + c is exact in the double-width integer and rounded once */
+        friend inline FixedSR fma(const FixedSR& a, const FixedSR& b, const FixedSR& c) {
+            return fromRaw(roundShifted(wide_t(a.value) * b.value + wide_t(c.value) * one));
+        }
+
+        // a = m * 2^e with a 53-bit integer m, so m * b is exact in 128 bits and only the bits below the last
+        // fractional bit are rounded, as in the fma of three fixed-point values
+        friend inline FixedSR fma(double a, const FixedSR& b, const FixedSR& c) {
+            static_assert(sizeof(INT_T) <= 8, "m * b must fit into 128 bits");
+            if (!std::isfinite(a)) {
+                return FixedSR(std::fma(a, static_cast<double>(b), static_cast<double>(c)));
+            }
+            int e;
+            double m = std::frexp(a, &e);
+            __int128 product = static_cast<__int128>(static_cast<std::int64_t>(std::ldexp(m, 53))) * b.value;
+            e -= 53;
+            if (e >= 0) {
+                // Exact, wraps like the other integer operations
+                unsigned __int128 shifted = e < 128 ? static_cast<unsigned __int128>(product) << e : 0;
+                return fromRaw(detail::wrap<INT_T>(shifted + static_cast<unsigned __int128>(static_cast<__int128>(c.value))));
+            }
+            int s = -e;
+            __int128 low = product >> std::min(s, 127);
+            // Fraction below the last bit, the low s bits of the product in two's complement
+            double dropped = s < 127 ? std::ldexp(static_cast<double>(static_cast<unsigned __int128>(product) & ((static_cast<unsigned __int128>(1) << s) - 1)), -s)
+                                     : std::ldexp(static_cast<double>(product), -s) - static_cast<double>(low);
+            if (RNG::template bits<32>() < std::ldexp(dropped, 32)) {
+                low += 1;
+            }
+            return fromRaw(detail::wrap<INT_T>(low + c.value));
+        }
+
         /* Other functions */
         friend inline FixedSR abs(const FixedSR&  x)  { return abs(static_cast<double>(x)); }
         friend inline FixedSR fabs(const FixedSR&  x)  { return fabs(static_cast<double>(x)); }
@@ -280,13 +301,81 @@ namespace rndcmp {
         friend inline bool isfinite(const FixedSR& x) { return true; }
 
     private:
+        friend struct detail::PacketOps<FixedSR>;
+
+        // Operations on two fixed-point values stay in integers: sums are exact, products and quotients
+        // are computed exactly in the double-width type and only the dropped bits are rounded.
+        using typename Fixed<INT_T, FRACT_SIZE, POW>::wide_t;
+        using Fixed<INT_T, FRACT_SIZE, POW>::one;
+        using Fixed<INT_T, FRACT_SIZE, POW>::wrapped;
+
+        static FixedSR fromRaw(INT_T raw) {
+            FixedSR result;
+            result.value = raw;
+            return result;
+        }
+
+        // BITS uniformly distributed random bits, BITS < 64
+        template<int BITS>
+        static std::uint64_t randomBits() {
+            if constexpr (BITS <= 32) {
+                return RNG::template bits<BITS>();
+            } else {
+                std::uint64_t high = RNG::template bits<BITS - 32>();
+                return (high << 32) | RNG::template bits<32>();
+            }
+        }
+
+        // Divides by 2^FRACT_SIZE, rounding up with probability equal to the dropped fraction
+        static INT_T roundShifted(wide_t v) {
+            if constexpr (FRACT_SIZE == 0) {
+                return detail::wrap<INT_T>(v);
+            } else {
+                wide_t floor = v >> FRACT_SIZE;
+                std::uint64_t dropped = static_cast<std::uint64_t>(v & (one - 1));
+                if (randomBits<FRACT_SIZE>() < dropped) {
+                    floor += 1;
+                }
+                return detail::wrap<INT_T>(floor);
+            }
+        }
+
+        // Divides num by den, rounding away from zero with probability |remainder / den|.
+        // Division by zero saturates to the limits of INT_T by the sign of num, 0 / 0 gives 0.
+        static INT_T roundQuotient(wide_t num, wide_t den) {
+            if (den == 0) {
+                return num > 0 ? std::numeric_limits<INT_T>::max() : (num < 0 ? std::numeric_limits<INT_T>::min() : INT_T(0));
+            }
+            wide_t quotient = num / den;
+            wide_t remainder = num % den;
+            if (remainder != 0) {
+                // |remainder| < |den| <= 2^(bits of wide_t - 1), an integer divisor can use all of them,
+                // so the product of 32 random bits and |den| needs 32 bits more than wide_t
+                using unsigned_t = std::conditional_t<(sizeof(wide_t) < 8), std::uint64_t, unsigned __int128>;
+                unsigned_t r = static_cast<unsigned_t>(remainder < 0 ? -remainder : remainder);
+                // Negated in unsigned_t, the saturated divisor can be the minimum of wide_t
+                unsigned_t d = den < 0 ? unsigned_t(0) - static_cast<unsigned_t>(den) : static_cast<unsigned_t>(den);
+                if constexpr (sizeof(wide_t) > 8) {
+                    // 128-bit divisors: dropping low bits of both changes the probability by less than 2^-60
+                    while (d >> 95) {
+                        d >>= 1;
+                        r >>= 1;
+                    }
+                }
+                if (static_cast<unsigned_t>(RNG::template bits<32>()) * d < (r << 32)) {
+                    quotient += ((num < 0) != (den < 0)) ? -1 : 1;
+                }
+            }
+            return detail::wrap<INT_T>(quotient);
+        }
+
         template<typename T>
         void setValueFromT(T v) {
-            T powed = v * (1 << FRACT_SIZE);
+            T powed = v * (std::int64_t(1) << FRACT_SIZE);
 
             T int_part(0.0);
             T fractional_part = std::modf(powed, &int_part);
-            double treshold = distribution(generator);
+            double treshold = RNG::uniform();
             value = static_cast<INT_T>(powed);
             if ((std::fabs(fractional_part) > treshold) && (fractional_part >= 0)) {
                 value += 1;
@@ -295,14 +384,75 @@ namespace rndcmp {
             }
         }
     }; 
+
+    /* Eigen packet math */
+
+    namespace detail {
+        // Sums are exact; products round the dropped bits against one random word per lane, like roundShifted
+        template<typename INT_T, int FRACT_SIZE, int POW, typename RNG>
+        struct PacketOps<FixedSR<INT_T, FRACT_SIZE, POW, RNG>> {
+            using lane_t = INT_T;
+            using scalar_t = FixedSR<INT_T, FRACT_SIZE, POW, RNG>;
+            using wide_t = typename scalar_t::wide_t;
+
+            static INT_T lane(const scalar_t& x) {
+                return x.value;
+            }
+
+            static scalar_t scalar(INT_T raw) {
+                return scalar_t::fromRaw(raw);
+            }
+
+            static void add(const INT_T* a, const INT_T* b, INT_T* out) {
+                for (int i = 0; i < packet_size; i++) {
+                    out[i] = wrap<INT_T>(wide_t(a[i]) + b[i]);
+                }
+            }
+
+            static void sub(const INT_T* a, const INT_T* b, INT_T* out) {
+                for (int i = 0; i < packet_size; i++) {
+                    out[i] = wrap<INT_T>(wide_t(a[i]) - b[i]);
+                }
+            }
+
+            static void mul(const INT_T* a, const INT_T* b, INT_T* out) {
+                if constexpr (FRACT_SIZE == 0 || FRACT_SIZE > 32) {
+                    for (int i = 0; i < packet_size; i++) {
+                        out[i] = scalar_t::roundShifted(wide_t(a[i]) * b[i]);
+                    }
+                } else {
+                    uint32_t words[packet_size];
+                    RNG::words(words, packet_size);
+                    for (int i = 0; i < packet_size; i++) {
+                        wide_t product = wide_t(a[i]) * b[i];
+                        std::uint64_t dropped = static_cast<std::uint64_t>(product & (scalar_t::one - 1));
+                        std::uint64_t threshold = words[i] >> (32 - FRACT_SIZE);
+                        out[i] = wrap<INT_T>((product >> FRACT_SIZE) + (threshold < dropped ? 1 : 0));
+                    }
+                }
+            }
+
+            static void div(const INT_T* a, const INT_T* b, INT_T* out) {
+                for (int i = 0; i < packet_size; i++) {
+                    out[i] = scalar_t::roundQuotient(wide_t(a[i]) * scalar_t::one, b[i]);
+                }
+            }
+
+            static void negate(const INT_T* a, INT_T* out) {
+                for (int i = 0; i < packet_size; i++) {
+                    out[i] = wrap<INT_T>(-wide_t(a[i]));
+                }
+            }
+        };
+    }
 }
 
 namespace Eigen {
     // Inheritance from float is a temporary bad solution. Need specify all NumTraits explicitly
-    template<typename INT_T, int FRACT_SIZE, int POW> struct NumTraits<rndcmp::FixedSR<INT_T, FRACT_SIZE, POW>>: NumTraits<float> {
-        typedef rndcmp::FixedSR<INT_T, FRACT_SIZE, POW> Real;
-        typedef rndcmp::FixedSR<INT_T, FRACT_SIZE, POW> NonInteger;
-        typedef rndcmp::FixedSR<INT_T, FRACT_SIZE, POW> Nested;
+    template<typename INT_T, int FRACT_SIZE, int POW, typename RNG> struct NumTraits<rndcmp::FixedSR<INT_T, FRACT_SIZE, POW, RNG>>: NumTraits<float> {
+        typedef rndcmp::FixedSR<INT_T, FRACT_SIZE, POW, RNG> Real;
+        typedef rndcmp::FixedSR<INT_T, FRACT_SIZE, POW, RNG> NonInteger;
+        typedef rndcmp::FixedSR<INT_T, FRACT_SIZE, POW, RNG> Nested;
         
         enum {
             IsComplex = 0,
@@ -316,4 +466,10 @@ namespace Eigen {
     };
 }
 
+// Formats used by the experiments. Packet math cannot be enabled for every FixedSR at once (see packet.hpp): other
+// formats work with Eigen through the scalar operators, RNDCMP_EIGEN_PACKET_MATH(format) vectorizes them
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::FixedSR<std::int16_t, 8>)
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::FixedSR<std::int32_t, 16>)
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::FixedSR<std::int32_t, 24>)
+
 #endif  // RNDCMP_INCLUDE_FIXEDSR_HPP_
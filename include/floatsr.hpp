@@ -1,14 +1,22 @@
 #ifndef RNDCMP_INCLUDE_FLOATSR_HPP_
 #define RNDCMP_INCLUDE_FLOATSR_HPP_
 
+#include <algorithm>
 #include <type_traits>
 #include <cmath>
+#include <cstring>
 #include <random>
 #include <iostream>
 #include <Eigen/Core>
 
+#include "random.hpp"
+#include "simd.hpp"
+#include "packet.hpp"
+
 
 namespace rndcmp {
+    // Number of low-cut bits for double
+    constexpr int res32_bits = 29;
     // Мask for 29 low-cut bits for double
     constexpr int64_t res32_mask = 0x1fffffff;
     // Epsilon for double to float conversion
@@ -17,18 +25,84 @@ namespace rndcmp {
     constexpr float float_max = std::numeric_limits<float>::max();
     constexpr float float_min = std::numeric_limits<float>::lowest();
 
-    static std::random_device floating_rd;
-    static std::mt19937 int_generator = std::mt19937(floating_rd());
-    static std::uniform_int_distribution<int64_t> dist32 = std::uniform_int_distribution<int64_t>(0, res32_mask);
+    namespace detail {
+        // Rounds x to float, up if the 29-bit random value p is below the cut bits. Clamps to the float range.
+        inline float round_double_to_float(double x, int64_t p) {
+            // Interpret double as int64 for better bits manipulating
+            int64_t x_int;
+            std::memcpy(&x_int, &x, sizeof(x_int));
+            // Truncate lower bits
+            int64_t x_tr = x_int & ~res32_mask;
+            if (p < (x_int & res32_mask)) {
+                x_tr += eps32;
+            }
+            double result;
+            std::memcpy(&result, &x_tr, sizeof(result));
+
+            // Check for overflow
+            if (result > float_max) {
+                return float_max;
+            } else if (result < float_min) {
+                return float_min;
+            }
+            return static_cast<float>(result);
+        }
+
+        // Sum of two doubles without error: a + b = sum + error exactly (TwoSum)
+        inline double two_sum(double a, double b, double& error) {
+            double sum = a + b;
+            double b_virtual = sum - a;
+            error = (a - (sum - b_virtual)) + (b - b_virtual);
+            return sum;
+        }
+
+        // a * b + c as the nearest double and the sign (-1, 0 or 1) of what the exact value has beyond it.
+        // The product error comes from fma (TwoProduct), the sums are error-free, so only the last error
+        // term is rounded and its sign is kept.
+        inline double fma_with_residual(double a, double b, double c, int& residual) {
+            double product = a * b;
+            double product_error = std::fma(a, b, -product);
+            double sum_error;
+            double sum = two_sum(product, c, sum_error);
+            double tail_error;
+            double tail = two_sum(sum_error, product_error, tail_error);
+            double remainder;
+            double result = two_sum(sum, tail, remainder);
+            if (!std::isfinite(result)) {
+                residual = 0;
+                return result;
+            }
+            double rest = remainder != 0. ? remainder : tail_error;
+            residual = (rest > 0.) - (rest < 0.);
+            return result;
+        }
+
+        // Rounds x + r to float, where the remainder r is below half an ulp of x and of the sign residual.
+        // The cut bits of x are an integer number of double ulps, so r only decides when p equals them.
+        inline float round_double_to_float(double x, int residual, int64_t p) {
+            int64_t x_int;
+            std::memcpy(&x_int, &x, sizeof(x_int));
+            int64_t low = x_int & res32_mask;
+            // The remainder away from zero pushes the magnitude up
+            int outward = x_int < 0 ? -residual : residual;
+            if (p == low && outward > 0) {
+                p -= 1;
+            }
+            return round_double_to_float(x, p);
+        }
+    }
 
-    class FloatSR {
+    template<typename RNG = DefaultRng>
+    class BasicFloatSR {
     public:
-        FloatSR() = default;
+        using rng_type = RNG;
+
+        BasicFloatSR() = default;
 
-        FloatSR(float v): value(v) {}
+        BasicFloatSR(float v): value(v) {}
 
         template<typename T>
-        FloatSR(T v, std::enable_if_t<std::is_floating_point<T>::value, bool> = true) {
+        BasicFloatSR(T v, std::enable_if_t<std::is_floating_point<T>::value, bool> = true) {
             double double_val = static_cast<double>(v);
             round(double_val);
         }
@@ -46,49 +120,49 @@ namespace rndcmp {
         /* + operators */
         
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR operator+(const T& rhs) const {
+        BasicFloatSR operator+(const T& rhs) const {
             double v = static_cast<double>(value) + static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
-        FloatSR operator+(const FloatSR& rhs) const {
+        BasicFloatSR operator+(const BasicFloatSR& rhs) const {
             double v =  static_cast<double>(value) + static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend FloatSR operator+(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator+(T lhs, const BasicFloatSR& rhs) {
             double v = static_cast<double>(lhs) + static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR& operator+=(const T& rhs) {
+        BasicFloatSR& operator+=(const T& rhs) {
             double v = static_cast<double>(*this) + static_cast<double>(rhs);
             round(v);
             return *this;
         }
 
-        FloatSR& operator+=(const FloatSR& rhs) {
+        BasicFloatSR& operator+=(const BasicFloatSR& rhs) {
             double v = static_cast<double>(*this) + static_cast<double>(rhs);
             round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR operator+(const T& rhs) const {
+        BasicFloatSR operator+(const T& rhs) const {
             double v = static_cast<double>(*this) + rhs;
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend FloatSR operator+(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator+(T lhs, const BasicFloatSR& rhs) {
             double v = lhs + static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR& operator+=(const T& rhs) {
+        BasicFloatSR& operator+=(const T& rhs) {
             double v = static_cast<double>(*this) + rhs;
             round(v);
             return *this;
@@ -97,105 +171,105 @@ namespace rndcmp {
         /* - operators */
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR operator-(const T& rhs) const {
+        BasicFloatSR operator-(const T& rhs) const {
             double v = static_cast<double>(*this) - static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
-        FloatSR operator-(const FloatSR& rhs) const {
+        BasicFloatSR operator-(const BasicFloatSR& rhs) const {
             double v = static_cast<double>(*this) - static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR& operator-=(const T& rhs) {
+        BasicFloatSR& operator-=(const T& rhs) {
             double v = static_cast<double>(*this) - static_cast<double>(rhs);
             round(v);
             return *this;
         }
 
-        FloatSR& operator-=(const FloatSR& rhs) {
+        BasicFloatSR& operator-=(const BasicFloatSR& rhs) {
             double v = static_cast<double>(value) - static_cast<double>(rhs);
             round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend FloatSR operator-(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator-(T lhs, const BasicFloatSR& rhs) {
             double v = static_cast<double>(lhs) - static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR operator-(const T& rhs) const {
+        BasicFloatSR operator-(const T& rhs) const {
             double v = static_cast<double>(*this) - static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend FloatSR operator-(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator-(T lhs, const BasicFloatSR& rhs) {
             double v = static_cast<double>(lhs) - static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR& operator-=(const T& rhs) {
+        BasicFloatSR& operator-=(const T& rhs) {
             double v = static_cast<double>(*this) - rhs;
             round(v);
             return *this;
         }
 
         // Unary minus
-        FloatSR operator-() const {
-            return FloatSR(-value);
+        BasicFloatSR operator-() const {
+            return BasicFloatSR(-value);
         }
 
         /* multiply operators */
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR operator*(const T& rhs) const {
+        BasicFloatSR operator*(const T& rhs) const {
             double v = static_cast<double>(*this) * static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
-        FloatSR operator*(const FloatSR& rhs) const {
+        BasicFloatSR operator*(const BasicFloatSR& rhs) const {
             double v = static_cast<double>(*this) * static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR& operator*=(const T& rhs) {
+        BasicFloatSR& operator*=(const T& rhs) {
             double v = static_cast<double>(*this) * static_cast<double>(rhs);
             round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend FloatSR operator*(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator*(T lhs, const BasicFloatSR& rhs) {
             double v = static_cast<double>(lhs) * static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR operator*(const T& rhs) const {
+        BasicFloatSR operator*(const T& rhs) const {
             double v = static_cast<double>(*this) * rhs;
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend FloatSR operator*(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator*(T lhs, const BasicFloatSR& rhs) {
             double v = lhs * static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR& operator*=(const T& rhs) {
+        BasicFloatSR& operator*=(const T& rhs) {
             double v = static_cast<double>(*this) * rhs;
             round(v);
             return *this;
         }
 
-        FloatSR& operator*=(const FloatSR& rhs) {
+        BasicFloatSR& operator*=(const BasicFloatSR& rhs) {
             double v = static_cast<double>(value) * static_cast<double>(rhs);
             round(v);
             return *this;
@@ -204,49 +278,49 @@ namespace rndcmp {
         /* divide operators */
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR operator/(const T& rhs) const {
+        BasicFloatSR operator/(const T& rhs) const {
             double v = static_cast<double>(*this) / static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
-        FloatSR operator/(const FloatSR& rhs) const {
+        BasicFloatSR operator/(const BasicFloatSR& rhs) const {
             double v = static_cast<double>(*this) / static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        FloatSR& operator/=(const T& rhs) {
+        BasicFloatSR& operator/=(const T& rhs) {
             double v = static_cast<double>(*this) / static_cast<double>(rhs);
             round(v);
             return *this;
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend FloatSR operator/(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator/(T lhs, const BasicFloatSR& rhs) {
             double v = static_cast<double>(lhs) / static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR operator/(const T& rhs) const {
+        BasicFloatSR operator/(const T& rhs) const {
             double v = static_cast<double>(*this) / rhs;
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend FloatSR operator/(T lhs, const FloatSR& rhs) {
+        friend BasicFloatSR operator/(T lhs, const BasicFloatSR& rhs) {
             double v = lhs / static_cast<double>(rhs);
-            return FloatSR(v);
+            return BasicFloatSR(v);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        FloatSR& operator/=(const T& rhs) {
+        BasicFloatSR& operator/=(const T& rhs) {
             double v = static_cast<double>(*this) / rhs;
             round(v);
             return *this;
         }
 
-        FloatSR& operator/=(const FloatSR& rhs) {
+        BasicFloatSR& operator/=(const BasicFloatSR& rhs) {
             double v = static_cast<double>(value) / static_cast<double>(rhs);
             round(v);
             return *this;
@@ -256,7 +330,7 @@ namespace rndcmp {
 
         /* less */
 
-        bool operator<(const FloatSR& rhs) const {
+        bool operator<(const BasicFloatSR& rhs) const {
             return value < rhs.value;
         }
 
@@ -271,18 +345,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator<(const T& rhs, const FloatSR& lhs) {
+        friend bool operator<(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) < static_cast<double>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator<(const T& rhs, const FloatSR& lhs) {
+        friend bool operator<(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) < static_cast<double>(lhs);
         }
 
         /* greater */
 
-        bool operator>(const FloatSR& rhs) const {
+        bool operator>(const BasicFloatSR& rhs) const {
             return value > rhs.value;
         }
 
@@ -297,18 +371,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator>(const T& rhs, const FloatSR& lhs) {
+        friend bool operator>(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) > static_cast<double>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator>(const T& rhs, const FloatSR& lhs) {
+        friend bool operator>(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) > static_cast<double>(lhs);
         }
 
         /* equal */
 
-        bool operator==(const FloatSR& rhs) const {
+        bool operator==(const BasicFloatSR& rhs) const {
             return value == rhs.value;
         }
 
@@ -323,18 +397,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator==(const T& rhs, const FloatSR& lhs) {
+        friend bool operator==(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) == static_cast<double>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator==(const T& rhs, const FloatSR& lhs) {
+        friend bool operator==(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) == static_cast<double>(lhs);
         }
 
         /* not equal */
        
-        bool operator!=(const FloatSR& rhs) const {
+        bool operator!=(const BasicFloatSR& rhs) const {
             return value != rhs.value;
         }
 
@@ -349,18 +423,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator!=(const T& rhs, const FloatSR& lhs) {
+        friend bool operator!=(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) != static_cast<double>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator!=(const T& rhs, const FloatSR& lhs) {
+        friend bool operator!=(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) != static_cast<double>(lhs);
         }
 
         /* less or equal */
 
-        bool operator<=(const FloatSR& rhs) const {
+        bool operator<=(const BasicFloatSR& rhs) const {
             return value <= rhs.value;
         }
 
@@ -375,18 +449,18 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator<=(const T& rhs, const FloatSR& lhs) {
+        friend bool operator<=(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) <= static_cast<double>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator<=(const T& rhs, const FloatSR& lhs) {
+        friend bool operator<=(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) <= static_cast<double>(lhs);
         }
 
         /* greater or equal */
 
-        bool operator>=(const FloatSR& rhs) const {
+        bool operator>=(const BasicFloatSR& rhs) const {
             return value >= rhs.value;
         }
 
@@ -401,91 +475,255 @@ namespace rndcmp {
         }
 
         template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
-        friend bool operator>=(const T& rhs, const FloatSR& lhs) {
+        friend bool operator>=(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) >= static_cast<double>(lhs);
         }
 
         template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
-        friend bool operator>=(const T& rhs, const FloatSR& lhs) {
+        friend bool operator>=(const T& rhs, const BasicFloatSR& lhs) {
             return static_cast<double>(rhs) >= static_cast<double>(lhs);
         }
 
         /* ostream overload */
-        friend std::ostream& operator<<(std::ostream& os, const FloatSR& v) {
+        friend std::ostream& operator<<(std::ostream& os, const BasicFloatSR& v) {
             os << float(v);
             return os;
         }
 
         /* Trigonometric functions */
-        friend inline FloatSR cos(const FloatSR&  x)  { return cos(static_cast<double>(x)); }
-        friend inline FloatSR sin(const FloatSR&  x)  { return sin(static_cast<double>(x)); }
-        friend inline FloatSR tan(const FloatSR&  x)  { return tan(static_cast<double>(x)); }
-        friend inline FloatSR acos(const FloatSR&  x)  { return acos(static_cast<double>(x)); }
-        friend inline FloatSR asin(const FloatSR&  x)  { return asin(static_cast<double>(x)); }
-        friend inline FloatSR atan(const FloatSR&  x)  { return atan(static_cast<double>(x)); }
+        friend inline BasicFloatSR cos(const BasicFloatSR&  x)  { return cos(static_cast<double>(x)); }
+        friend inline BasicFloatSR sin(const BasicFloatSR&  x)  { return sin(static_cast<double>(x)); }
+        friend inline BasicFloatSR tan(const BasicFloatSR&  x)  { return tan(static_cast<double>(x)); }
+        friend inline BasicFloatSR acos(const BasicFloatSR&  x)  { return acos(static_cast<double>(x)); }
+        friend inline BasicFloatSR asin(const BasicFloatSR&  x)  { return asin(static_cast<double>(x)); }
+        friend inline BasicFloatSR atan(const BasicFloatSR&  x)  { return atan(static_cast<double>(x)); }
 
         /* Hyperbolic functions */
-        friend inline FloatSR cosh(const FloatSR&  x)  { return cosh(static_cast<double>(x)); }
-        friend inline FloatSR sinh(const FloatSR&  x)  { return sinh(static_cast<double>(x)); }
-        friend inline FloatSR tanh(const FloatSR&  x)  { return tanh(static_cast<double>(x)); }
-        friend inline FloatSR acosh(const FloatSR&  x)  { return acosh(static_cast<double>(x)); }
-        friend inline FloatSR asinh(const FloatSR&  x)  { return asinh(static_cast<double>(x)); }
-        friend inline FloatSR atanh(const FloatSR&  x)  { return atanh(static_cast<double>(x)); }
+        friend inline BasicFloatSR cosh(const BasicFloatSR&  x)  { return cosh(static_cast<double>(x)); }
+        friend inline BasicFloatSR sinh(const BasicFloatSR&  x)  { return sinh(static_cast<double>(x)); }
+        friend inline BasicFloatSR tanh(const BasicFloatSR&  x)  { return tanh(static_cast<double>(x)); }
+        friend inline BasicFloatSR acosh(const BasicFloatSR&  x)  { return acosh(static_cast<double>(x)); }
+        friend inline BasicFloatSR asinh(const BasicFloatSR&  x)  { return asinh(static_cast<double>(x)); }
+        friend inline BasicFloatSR atanh(const BasicFloatSR&  x)  { return atanh(static_cast<double>(x)); }
 
         /* Exponential and logarithmic functions */
-        friend inline FloatSR exp(const FloatSR&  x)  { return exp(static_cast<double>(x)); }
-        friend inline FloatSR log(const FloatSR&  x)  { return log(static_cast<double>(x)); }
-        friend inline FloatSR log10(const FloatSR&  x)  { return log10(static_cast<double>(x)); }
-        friend inline FloatSR logb(const FloatSR&  x)  { return logb(static_cast<double>(x)); }
+        friend inline BasicFloatSR exp(const BasicFloatSR&  x)  { return exp(static_cast<double>(x)); }
+        friend inline BasicFloatSR log(const BasicFloatSR&  x)  { return log(static_cast<double>(x)); }
+        friend inline BasicFloatSR log10(const BasicFloatSR&  x)  { return log10(static_cast<double>(x)); }
+        friend inline BasicFloatSR logb(const BasicFloatSR&  x)  { return logb(static_cast<double>(x)); }
 
         /* Power functions */
-        friend inline FloatSR pow(const FloatSR&  base, double exponent)  { return pow(static_cast<double>(base), exponent); }
-        friend inline FloatSR sqrt(const FloatSR&  x)  { return sqrt(static_cast<double>(x)); }
-        friend inline FloatSR cbrt(const FloatSR&  x)  { return cbrt(static_cast<double>(x)); }
+        friend inline BasicFloatSR pow(const BasicFloatSR&  base, double exponent)  { return pow(static_cast<double>(base), exponent); }
+        friend inline BasicFloatSR sqrt(const BasicFloatSR&  x)  { return sqrt(static_cast<double>(x)); }
+        friend inline BasicFloatSR cbrt(const BasicFloatSR&  x)  { return cbrt(static_cast<double>(x)); }
 
-        friend inline FloatSR scalbn(const FloatSR&  x, int n)  { return scalbn(static_cast<double>(x), n); }
+        friend inline BasicFloatSR scalbn(const BasicFloatSR&  x, int n)  { return scalbn(static_cast<double>(x), n); }
+
+        /* Fused multiply-add: a * b + c is rounded once, from its exact value (the nearest double and the
+           sign of the rest), so the double it passes through does not bias the stochastic rounding */
+        friend inline BasicFloatSR fma(const BasicFloatSR& a, const BasicFloatSR& b, const BasicFloatSR& c) {
+            return fusedMultiplyAdd(static_cast<double>(a), static_cast<double>(b), static_cast<double>(c));
+        }
+
+        friend inline BasicFloatSR fma(double a, const BasicFloatSR& b, const BasicFloatSR& c) {
+            return fusedMultiplyAdd(a, static_cast<double>(b), static_cast<double>(c));
+        }
 
         /* Other functions */
-        friend inline FloatSR abs(const FloatSR&  x)  { return abs(static_cast<double>(x)); }
-        friend inline FloatSR fabs(const FloatSR&  x)  { return fabs(static_cast<double>(x)); }
-        friend inline FloatSR abs2(const FloatSR& x)  { return x*x; }
+        friend inline BasicFloatSR abs(const BasicFloatSR&  x)  { return abs(static_cast<double>(x)); }
+        friend inline BasicFloatSR fabs(const BasicFloatSR&  x)  { return fabs(static_cast<double>(x)); }
+        friend inline BasicFloatSR abs2(const BasicFloatSR& x)  { return x*x; }
 
-        friend inline FloatSR copysign(const FloatSR&  x1, const FloatSR& x2)  { return copysign(static_cast<double>(x1), static_cast<double>(x2)); }
-        friend inline FloatSR fmax(const FloatSR&  x1, const FloatSR&  x2) { return x1 < x2 ? x1 : x2; }
-        friend inline bool isfinite(const FloatSR& x) { return true; }
+        friend inline BasicFloatSR copysign(const BasicFloatSR&  x1, const BasicFloatSR& x2)  { return copysign(static_cast<double>(x1), static_cast<double>(x2)); }
+        friend inline BasicFloatSR fmax(const BasicFloatSR&  x1, const BasicFloatSR&  x2) { return x1 < x2 ? x1 : x2; }
+        friend inline bool isfinite(const BasicFloatSR& x) { return true; }
 
     private:
+        friend struct detail::PacketOps<BasicFloatSR>;
+
+        static BasicFloatSR fusedMultiplyAdd(double a, double b, double c) {
+            int residual;
+            double x = detail::fma_with_residual(a, b, c, residual);
+            return BasicFloatSR(detail::round_double_to_float(x, residual, RNG::template bits<res32_bits>()));
+        }
+
         void round(double x) {
-            // Interpret double as int64 for better bits manipulating
-            int64_t x_int = reinterpret_cast<int64_t&>(x);
-            // Truncate lower bits
-            int64_t x_tr = x_int & ~res32_mask;
-            // Generate random value
-            int64_t p = dist32(int_generator);
-            if (p < (x_int & res32_mask)) {
-                x_tr += eps32;
+            value = detail::round_double_to_float(x, RNG::template bits<res32_bits>());
+        }
+
+        float value;
+    };
+
+    using FloatSR = BasicFloatSR<>;
+
+    /* Array rounding */
+
+    namespace detail {
+        // Block kernels: words holds one 32-bit random word per element, its upper 29 bits are the threshold
+
+        inline void round_to_float_scalar(const double* src, const uint32_t* words, float* dst, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                dst[i] = round_double_to_float(src[i], words[i] >> (32 - res32_bits));
             }
-            double result = reinterpret_cast<double&>(x_tr);
+        }
 
-            // Check for overflow
-            if (result > float_max) {
-                value = float_max;
-            } else if (result < float_min) {
-                value = float_min;
-            } else {
-                value = static_cast<float>(result);
+#if RNDCMP_X86_DISPATCH
+        RNDCMP_TARGET("avx2")
+        inline void round_to_float_avx2(const double* src, const uint32_t* words, float* dst, size_t n) {
+            const __m256i mask = _mm256_set1_epi64x(res32_mask);
+            const __m256i eps = _mm256_set1_epi64x(eps32);
+            const __m256d upper = _mm256_set1_pd(float_max);
+            const __m256d lower = _mm256_set1_pd(float_min);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_castpd_si256(_mm256_loadu_pd(src + i));
+                __m256i low = _mm256_and_si256(x, mask);
+                __m256i truncated = _mm256_andnot_si256(mask, x);
+                __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+                __m256i p = _mm256_srli_epi64(_mm256_cvtepu32_epi64(w), 32 - res32_bits);
+                // Both sides are non-negative, so the signed compare is exact
+                __m256i up = _mm256_and_si256(_mm256_cmpgt_epi64(low, p), eps);
+                __m256d result = _mm256_castsi256_pd(_mm256_add_epi64(truncated, up));
+                // NaN is the second operand of max/min and passes through like in the scalar code
+                result = _mm256_min_pd(upper, _mm256_max_pd(lower, result));
+                _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(result));
+            }
+            round_to_float_scalar(src + i, words + i, dst + i, n - i);
+        }
+
+        RNDCMP_TARGET("avx512f")
+        inline void round_to_float_avx512(const double* src, const uint32_t* words, float* dst, size_t n) {
+            const __m512i mask = _mm512_set1_epi64(res32_mask);
+            const __m512i eps = _mm512_set1_epi64(eps32);
+            const __m512d upper = _mm512_set1_pd(float_max);
+            const __m512d lower = _mm512_set1_pd(float_min);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512i x = _mm512_castpd_si512(_mm512_loadu_pd(src + i));
+                __m512i low = _mm512_and_si512(x, mask);
+                __m512i truncated = _mm512_andnot_si512(mask, x);
+                __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+                __m512i p = _mm512_srli_epi64(_mm512_cvtepu32_epi64(w), 32 - res32_bits);
+                __mmask8 up = _mm512_cmpgt_epi64_mask(low, p);
+                __m512d result = _mm512_castsi512_pd(_mm512_mask_add_epi64(truncated, up, truncated, eps));
+                result = _mm512_min_pd(upper, _mm512_max_pd(lower, result));
+                _mm256_storeu_ps(dst + i, _mm512_cvtpd_ps(result));
             }
+            round_to_float_scalar(src + i, words + i, dst + i, n - i);
         }
+#endif
 
-        float value;
-    };
+        inline void round_to_float(simd::Isa isa, const double* src, const uint32_t* words, float* dst, size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if (isa == simd::Isa::Avx512) {
+                round_to_float_avx512(src, words, dst, n);
+                return;
+            }
+            if (isa == simd::Isa::Avx2) {
+                round_to_float_avx2(src, words, dst, n);
+                return;
+            }
+#endif
+            round_to_float_scalar(src, words, dst, n);
+        }
+    }
+
+    // Stochastically rounds n doubles to float with the widest SIMD kernel the CPU supports.
+    // Gives the same distribution as BasicFloatSR<RNG>(src[i]), element by element.
+    template<typename RNG = DefaultRng>
+    void round_sr(const double* src, float* dst, size_t n) {
+        uint32_t words[simd::block_size];
+        simd::Isa isa = simd::active_isa();
+        for (size_t i = 0; i < n; i += simd::block_size) {
+            size_t count = std::min(n - i, static_cast<size_t>(simd::block_size));
+            RNG::words(words, count);
+            detail::round_to_float(isa, src + i, words, dst + i, count);
+        }
+    }
+
+    template<typename RNG>
+    void round_sr(const double* src, BasicFloatSR<RNG>* dst, size_t n) {
+        static_assert(sizeof(BasicFloatSR<RNG>) == sizeof(float), "BasicFloatSR must have the layout of float");
+        round_sr<RNG>(src, reinterpret_cast<float*>(dst), n);
+    }
+
+    // Rounds with the given 32-bit threshold words, one per element, instead of drawing them from RNG
+    template<typename RNG>
+    void round_sr(const double* src, const uint32_t* words, BasicFloatSR<RNG>* dst, size_t n) {
+        detail::round_to_float(simd::active_isa(), src, words, reinterpret_cast<float*>(dst), n);
+    }
+
+    /* Eigen packet math */
+
+    namespace detail {
+        // Lanes are computed exactly in double and rounded with the block kernels, as the scalar operators do
+        template<typename RNG>
+        struct PacketOps<BasicFloatSR<RNG>> {
+            using lane_t = float;
+
+            static float lane(const BasicFloatSR<RNG>& x) {
+                return x.value;
+            }
+
+            static BasicFloatSR<RNG> scalar(float raw) {
+                BasicFloatSR<RNG> result;
+                result.value = raw;
+                return result;
+            }
+
+            static void add(const float* a, const float* b, float* out) {
+                double exact[packet_size];
+                for (int i = 0; i < packet_size; i++) {
+                    exact[i] = static_cast<double>(a[i]) + static_cast<double>(b[i]);
+                }
+                round(exact, out);
+            }
+
+            static void sub(const float* a, const float* b, float* out) {
+                double exact[packet_size];
+                for (int i = 0; i < packet_size; i++) {
+                    exact[i] = static_cast<double>(a[i]) - static_cast<double>(b[i]);
+                }
+                round(exact, out);
+            }
+
+            static void mul(const float* a, const float* b, float* out) {
+                double exact[packet_size];
+                for (int i = 0; i < packet_size; i++) {
+                    exact[i] = static_cast<double>(a[i]) * static_cast<double>(b[i]);
+                }
+                round(exact, out);
+            }
+
+            static void div(const float* a, const float* b, float* out) {
+                double exact[packet_size];
+                for (int i = 0; i < packet_size; i++) {
+                    exact[i] = static_cast<double>(a[i]) / static_cast<double>(b[i]);
+                }
+                round(exact, out);
+            }
+
+            static void negate(const float* a, float* out) {
+                for (int i = 0; i < packet_size; i++) {
+                    out[i] = -a[i];
+                }
+            }
+
+        private:
+            static void round(const double* exact, float* out) {
+                uint32_t words[packet_size];
+                RNG::words(words, packet_size);
+                round_to_float(simd::active_isa(), exact, words, out, packet_size);
+            }
+        };
+    }
 }
 
 namespace Eigen {
-    template<> struct NumTraits<rndcmp::FloatSR>: NumTraits<float> {
-        typedef rndcmp::FloatSR Real;
-        typedef rndcmp::FloatSR NonInteger;
-        typedef rndcmp::FloatSR Nested;
+    template<typename RNG> struct NumTraits<rndcmp::BasicFloatSR<RNG>>: NumTraits<float> {
+        typedef rndcmp::BasicFloatSR<RNG> Real;
+        typedef rndcmp::BasicFloatSR<RNG> NonInteger;
+        typedef rndcmp::BasicFloatSR<RNG> Nested;
         
         enum {
             IsComplex = 0,
@@ -499,4 +737,6 @@ namespace Eigen {
     };
 }
 
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::FloatSR)
+
 #endif  // RNDCMP_INCLUDE_FLOATSR_HPP_
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef RNDCMP_INCLUDE_FP8_HPP_
+#define RNDCMP_INCLUDE_FP8_HPP_
+
+#include "random.hpp"
+#include "srfloat.hpp"
+
+
+namespace rndcmp {
+    // 8-bit floats of the OCP FP8 formats. E4M3 has no infinities, its only NaN is S.1111.111 and the largest
+    // value is 448. E5M2 follows IEEE 754 and reaches 57344. Values decode through a 256-entry constexpr table.
+    // Out-of-range values saturate to the largest finite value.
+
+    template<typename RNG = DefaultRng>
+    using basic_float8_e4m3sr = SRFloat<4, 3, RNG, FloatSpecials::FiniteNan>;
+
+    template<typename RNG = DefaultRng>
+    using basic_float8_e5m2sr = SRFloat<5, 2, RNG>;
+
+    // Round to nearest, ties towards zero (see NearestRng)
+    using float8_e4m3 = basic_float8_e4m3sr<NearestRng>;
+    using float8_e5m2 = basic_float8_e5m2sr<NearestRng>;
+
+    // Stochastic rounding
+    using float8_e4m3sr = basic_float8_e4m3sr<>;
+    using float8_e5m2sr = basic_float8_e5m2sr<>;
+}
+
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::float8_e4m3sr)
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::float8_e5m2sr)
+
+#endif  // RNDCMP_INCLUDE_FP8_HPP_
@@ -0,0 +1,275 @@
+#ifndef RNDCMP_INCLUDE_GEMM_HPP_
+#define RNDCMP_INCLUDE_GEMM_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <Eigen/Core>
+
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "floatsr.hpp"
+#include "bfloat16sr.hpp"
+
+
+namespace rndcmp {
+    // Where a product C = A * B is rounded to the element type
+    enum class GemmRounding {
+        EveryOp,    // every product and every partial sum, like the scalar operators
+        Once,       // the dot products are accumulated in the accumulator format and rounded once at the end
+        PerBlock    // partial sums of k_block terms are accumulated, added to C and rounded once per block
+    };
+
+    enum class GemmAccumulator {
+        Float32,
+        Float64
+    };
+
+    struct GemmOptions {
+        GemmRounding rounding = GemmRounding::EveryOp;
+        GemmAccumulator accumulator = GemmAccumulator::Float64;
+        // Depth of the cache blocks, and the rounding interval for PerBlock
+        std::size_t k_block = 256;
+        // Parts the product is split into and run on ThreadPool::shared(), 0 uses one per thread of the pool.
+        // Each part draws from its own RNG stream. Small products are not split, see detail::gemm_part_work.
+        unsigned threads = 1;
+    };
+
+    namespace detail {
+        // Rows of A kept in cache while a block of B is streamed
+        constexpr std::size_t gemm_m_block = 128;
+
+        // Multiply-adds a part has at least; handing less to another thread costs more than it saves
+        constexpr std::size_t gemm_part_work = std::size_t(1) << 15;
+
+        // Types whose operators compute exactly in a wider floating type and round an array of it with SIMD kernels.
+        // EveryOp runs on those arrays instead of element by element.
+        template<typename T>
+        struct GemmWide {
+            static constexpr bool enabled = false;
+        };
+
+        template<typename RNG>
+        struct GemmWide<BasicFloatSR<RNG>> {
+            static constexpr bool enabled = true;
+            using wide_t = double;
+
+            static void round(const double* src, BasicFloatSR<RNG>* dst, std::size_t n) {
+                round_sr(src, dst, n);
+            }
+        };
+
+        template<typename RNG>
+        struct GemmWide<basic_bfloat16sr<RNG>> {
+            static constexpr bool enabled = true;
+            using wide_t = float;
+
+            static void round(const float* src, basic_bfloat16sr<RNG>* dst, std::size_t n) {
+                round_sr(src, dst, n);
+            }
+        };
+
+        // Rounds n accumulated values to T
+        template<typename T, typename ACC>
+        void gemm_round(const ACC* src, T* dst, std::size_t n) {
+            if constexpr (GemmWide<T>::enabled) {
+                if constexpr (std::is_same_v<ACC, typename GemmWide<T>::wide_t>) {
+                    GemmWide<T>::round(src, dst, n);
+                    return;
+                }
+            }
+            for (std::size_t i = 0; i < n; i++) {
+                dst[i] = T(src[i]);
+            }
+        }
+
+        // Column-major operand: element (i, j) is data[i + j * ld]
+        template<typename T>
+        struct GemmOperand {
+            const T* data;
+            std::size_t ld;
+
+            const T& operator()(std::size_t i, std::size_t j) const { return data[i + j * ld]; }
+        };
+
+        // EveryOp for columns [j_begin, j_end) of C
+        template<typename T>
+        void gemm_every_op(std::size_t m, std::size_t k, GemmOperand<T> a, GemmOperand<T> b, T* c, std::size_t ldc,
+                           std::size_t j_begin, std::size_t j_end, std::size_t k_block) {
+            if constexpr (GemmWide<T>::enabled) {
+                using wide_t = typename GemmWide<T>::wide_t;
+                std::vector<wide_t> packed(gemm_m_block * k_block), exact(gemm_m_block);
+                std::vector<T> product(gemm_m_block);
+                for (std::size_t pc = 0; pc < k; pc += k_block) {
+                    std::size_t kc = std::min(k_block, k - pc);
+                    for (std::size_t ic = 0; ic < m; ic += gemm_m_block) {
+                        std::size_t mc = std::min(gemm_m_block, m - ic);
+                        for (std::size_t p = 0; p < kc; p++) {
+                            for (std::size_t i = 0; i < mc; i++) {
+                                packed[i + p * mc] = static_cast<wide_t>(a(ic + i, pc + p));
+                            }
+                        }
+                        for (std::size_t j = j_begin; j < j_end; j++) {
+                            T* column = c + j * ldc + ic;
+                            for (std::size_t p = 0; p < kc; p++) {
+                                wide_t factor = static_cast<wide_t>(b(pc + p, j));
+                                const wide_t* lhs = packed.data() + p * mc;
+                                for (std::size_t i = 0; i < mc; i++) {
+                                    exact[i] = lhs[i] * factor;
+                                }
+                                if (pc + p == 0) {
+                                    gemm_round(exact.data(), column, mc);
+                                    continue;
+                                }
+                                gemm_round(exact.data(), product.data(), mc);
+                                for (std::size_t i = 0; i < mc; i++) {
+                                    exact[i] = static_cast<wide_t>(column[i]) + static_cast<wide_t>(product[i]);
+                                }
+                                gemm_round(exact.data(), column, mc);
+                            }
+                        }
+                    }
+                }
+            } else {
+                for (std::size_t pc = 0; pc < k; pc += k_block) {
+                    std::size_t kc = std::min(k_block, k - pc);
+                    for (std::size_t ic = 0; ic < m; ic += gemm_m_block) {
+                        std::size_t mc = std::min(gemm_m_block, m - ic);
+                        for (std::size_t j = j_begin; j < j_end; j++) {
+                            T* column = c + j * ldc + ic;
+                            for (std::size_t p = pc; p < pc + kc; p++) {
+                                const T& factor = b(p, j);
+                                for (std::size_t i = 0; i < mc; i++) {
+                                    column[i] = p == 0 ? a(ic + i, p) * factor : column[i] + a(ic + i, p) * factor;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Once and PerBlock for columns [j_begin, j_end) of C, accumulating in ACC
+        template<typename T, typename ACC>
+        void gemm_accumulate(std::size_t m, std::size_t k, GemmOperand<T> a, GemmOperand<T> b, T* c, std::size_t ldc,
+                             std::size_t j_begin, std::size_t j_end, std::size_t k_block, bool per_block) {
+            std::size_t nc = j_end - j_begin;
+            std::vector<ACC> accumulator(m * nc, ACC(0)), packed(gemm_m_block * k_block);
+            for (std::size_t pc = 0; pc < k; pc += k_block) {
+                std::size_t kc = std::min(k_block, k - pc);
+                for (std::size_t ic = 0; ic < m; ic += gemm_m_block) {
+                    std::size_t mc = std::min(gemm_m_block, m - ic);
+                    for (std::size_t p = 0; p < kc; p++) {
+                        for (std::size_t i = 0; i < mc; i++) {
+                            packed[i + p * mc] = static_cast<ACC>(a(ic + i, pc + p));
+                        }
+                    }
+                    for (std::size_t j = 0; j < nc; j++) {
+                        ACC* sum = accumulator.data() + j * m + ic;
+                        for (std::size_t p = 0; p < kc; p++) {
+                            ACC factor = static_cast<ACC>(b(pc + p, j_begin + j));
+                            const ACC* lhs = packed.data() + p * mc;
+                            for (std::size_t i = 0; i < mc; i++) {
+                                sum[i] += lhs[i] * factor;
+                            }
+                        }
+                    }
+                }
+                if (per_block) {
+                    // C + block sum is rounded once per block
+                    for (std::size_t j = 0; j < nc; j++) {
+                        T* column = c + (j_begin + j) * ldc;
+                        ACC* sum = accumulator.data() + j * m;
+                        if (pc > 0) {
+                            for (std::size_t i = 0; i < m; i++) {
+                                sum[i] += static_cast<ACC>(column[i]);
+                            }
+                        }
+                        gemm_round(sum, column, m);
+                        std::fill(sum, sum + m, ACC(0));
+                    }
+                }
+            }
+            if (!per_block) {
+                for (std::size_t j = 0; j < nc; j++) {
+                    gemm_round(accumulator.data() + j * m, c + (j_begin + j) * ldc, m);
+                }
+            }
+        }
+
+        template<typename T>
+        void gemm_columns(std::size_t m, std::size_t k, GemmOperand<T> a, GemmOperand<T> b, T* c, std::size_t ldc,
+                          std::size_t j_begin, std::size_t j_end, const GemmOptions& options) {
+            std::size_t k_block = std::max<std::size_t>(options.k_block, 1);
+            if (options.rounding == GemmRounding::EveryOp) {
+                gemm_every_op(m, k, a, b, c, ldc, j_begin, j_end, k_block);
+                return;
+            }
+            bool per_block = options.rounding == GemmRounding::PerBlock;
+            if (options.accumulator == GemmAccumulator::Float32) {
+                gemm_accumulate<T, float>(m, k, a, b, c, ldc, j_begin, j_end, k_block, per_block);
+            } else {
+                gemm_accumulate<T, double>(m, k, a, b, c, ldc, j_begin, j_end, k_block, per_block);
+            }
+        }
+    }
+
+    // C = A * B for column-major m x k matrix A and k x n matrix B, ld* are the leading dimensions.
+    // C is overwritten. k must be positive.
+    template<typename T>
+    void gemm(std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb,
+              T* c, std::size_t ldc, const GemmOptions& options = GemmOptions()) {
+        detail::GemmOperand<T> rhs{b, ldb};
+        ThreadPool& pool = ThreadPool::shared();
+        std::size_t threads = options.threads == 0 ? pool.size() : options.threads;
+        threads = std::min(threads, std::max<std::size_t>(m * n * k / detail::gemm_part_work, 1));
+        // Wide products are split by columns of C, matrix-vector products by rows
+        bool by_columns = n >= threads;
+        threads = std::max<std::size_t>(std::min(threads, by_columns ? n : m), 1);
+        if (threads == 1) {
+            detail::gemm_columns(m, k, detail::GemmOperand<T>{a, lda}, rhs, c, ldc, 0, n, options);
+            return;
+        }
+
+        // Parts get fresh streams of a seed drawn from the stream T rounds with, so a seeded run replays exactly
+        // whichever thread of the pool runs a part
+        std::uint64_t seed = detail::worker_seed<T>();
+        pool.run(threads, [&](std::size_t t) {
+            std::size_t i_begin = 0, i_end = m, j_begin = 0, j_end = n;
+            if (by_columns) {
+                j_begin = n * t / threads;
+                j_end = n * (t + 1) / threads;
+            } else {
+                i_begin = m * t / threads;
+                i_end = m * (t + 1) / threads;
+            }
+            RngContext context(seed, t);
+            detail::GemmOperand<T> lhs{a + i_begin, lda};
+            detail::gemm_columns(i_end - i_begin, k, lhs, rhs, c + i_begin, ldc, j_begin, j_end, options);
+        });
+    }
+
+    // Eigen front end of gemm
+    template<typename DerivedA, typename DerivedB>
+    Eigen::Matrix<typename DerivedA::Scalar, Eigen::Dynamic, Eigen::Dynamic> multiply(
+            const Eigen::MatrixBase<DerivedA>& a, const Eigen::MatrixBase<DerivedB>& b, const GemmOptions& options = GemmOptions()) {
+        using Scalar = typename DerivedA::Scalar;
+        using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+        static_assert(std::is_same_v<Scalar, typename DerivedB::Scalar>, "operands must have the same scalar type");
+        eigen_assert(a.cols() == b.rows());
+
+        // Refs are free for column-major storage and evaluate other expressions once
+        Eigen::Ref<const Matrix> lhs(a.derived()), rhs(b.derived());
+        Matrix result(lhs.rows(), rhs.cols());
+        if (lhs.cols() == 0) {
+            result.setZero();
+            return result;
+        }
+        gemm<Scalar>(lhs.rows(), rhs.cols(), lhs.cols(), lhs.data(), lhs.outerStride(), rhs.data(), rhs.outerStride(),
+                     result.data(), result.rows(), options);
+        return result;
+    }
+}
+
+#endif  // RNDCMP_INCLUDE_GEMM_HPP_
@@ -2,45 +2,50 @@
 #define RNDCMP_INCLUDE_HALFSR_HPP_
 
 #include "half.hpp"
+#include "random.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <random>
 
 
 namespace half_float {
 
+    // Number of low-cut bits for float
+    constexpr int res16_bits = 13;
     // Мask for 13 low-cut bits for double
     constexpr int64_t res16_mask = 0x1fff;
 
-    static std::random_device half_rd;
-    static std::mt19937 int_generator = std::mt19937(half_rd());
-    static std::uniform_int_distribution<int32_t> dist32 = std::uniform_int_distribution<int32_t>(0, res16_mask);
-
-    class halfsr: public half {
+    template<typename RNG = rndcmp::DefaultRng>
+    class basic_halfsr: public half {
         public:
-            constexpr halfsr() noexcept : half() {}
+            using rng_type = RNG;
+
+            constexpr basic_halfsr() noexcept : half() {}
 
-            halfsr(detail::expr rhs) : half(float2halfsr(static_cast<float>(rhs))) {}
+            basic_halfsr(detail::expr rhs) : half(float2halfsr(static_cast<float>(rhs))) {}
 
-            halfsr(float rhs) : half(float2halfsr(rhs)) {}
+            basic_halfsr(float rhs) : half(float2halfsr(rhs)) {}
 
-            halfsr& operator=(float rhs) { setValue(float2halfsr(rhs)); return *this; }
-            halfsr& operator=(const halfsr& rhs) = default;
+            basic_halfsr& operator=(float rhs) { setValue(float2halfsr(rhs)); return *this; }
+            basic_halfsr& operator=(const basic_halfsr& rhs) = default;
 
             /*  */
-            halfsr& operator+=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) + rhs)); return *this; }
+            basic_halfsr& operator+=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) + rhs)); return *this; }
 
-            halfsr& operator-=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) - rhs)); return *this; }
+            basic_halfsr& operator-=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) - rhs)); return *this; }
 
-            halfsr& operator*=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) * rhs)); return *this; }
+            basic_halfsr& operator*=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) * rhs)); return *this; }
 
-            halfsr& operator/=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) / rhs)); return *this; }
+            basic_halfsr& operator/=(float rhs) { setValue(float2halfsr(static_cast<float>(*this) / rhs)); return *this; }
 
-            halfsr& operator++() { return *this += 1.0f; }
+            basic_halfsr& operator++() { return *this += 1.0f; }
 
-            halfsr& operator--() { return *this -= 1.0f; }
+            basic_halfsr& operator--() { return *this -= 1.0f; }
 
-            halfsr operator++(int) { halfsr out(*this); ++*this; return out; }
+            basic_halfsr operator++(int) { basic_halfsr out(*this); ++*this; return out; }
 
-            halfsr operator--(int) { halfsr out(*this); --*this; return out; }
+            basic_halfsr operator--(int) { basic_halfsr out(*this); --*this; return out; }
 
             template<typename T>
             detail::uint16 float2halfsr(T value) {
@@ -52,17 +57,232 @@ namespace half_float {
                 return rounded;
             }
 
-            friend std::ostream& operator<<(std::ostream& os, const halfsr& v) {
+            friend std::ostream& operator<<(std::ostream& os, const basic_halfsr& v) {
                 os << float(v);
                 return os;
             }
+
+            /* Fused multiply-add: a * b + c is computed in double and rounded once straight to half, unlike half's fma,
+               which gives an expr rounded by the next assignment */
+            friend basic_halfsr fma(const basic_halfsr& a, const basic_halfsr& b, const basic_halfsr& c) {
+                return fromBits(double2halfsr(std::fma(static_cast<double>(a), static_cast<double>(b), static_cast<double>(c))));
+            }
+
+            friend basic_halfsr fma(double a, const basic_halfsr& b, const basic_halfsr& c) {
+                return fromBits(double2halfsr(std::fma(a, static_cast<double>(b), static_cast<double>(c))));
+            }
         private:
+            static basic_halfsr fromBits(detail::uint16 bits) {
+                basic_halfsr result;
+                result.setValue(bits);
+                return result;
+            }
+
+            // Rounds up with probability equal to the part of the step between the two neighbouring halfs that value
+            // covers, taken from the double itself rather than from a float in between. Subnormal halfs are exact too,
+            // values beyond the range clamp to the largest half.
+            static detail::uint16 double2halfsr(double value) {
+                detail::uint16 rounded = detail::float2half<std::round_toward_zero, double>(value);
+                if (!std::isfinite(value)) {
+                    return rounded;
+                }
+                double low = detail::half2float<double>(rounded);
+                double high = detail::half2float<double>(static_cast<detail::uint16>(rounded + 1));
+                if (std::isfinite(high) && RNG::template bits<32>() < std::ldexp((value - low) / (high - low), 32)) {
+                    rounded += 1;
+                }
+                return rounded;
+            }
+
             bool is_need_round_up(float x) {
                 int32_t x_int = reinterpret_cast<int32_t&>(x);
-                int32_t p = dist32(int_generator);
+                int32_t p = RNG::template bits<res16_bits>();
                 return p < (x_int & res16_mask);
             }
     };
+
+    using halfsr = basic_halfsr<>;
+}
+
+namespace rndcmp {
+
+    /* Array conversions */
+
+    namespace detail {
+        // Block kernels on the raw 16-bit patterns. words holds one 32-bit random word per element,
+        // its upper 13 bits are the threshold. Every ISA gives the same bits as basic_halfsr.
+
+        inline void halfsr_pack_scalar(const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                uint32_t bits;
+                memcpy(&bits, src + i, sizeof(bits));
+                uint16_t rounded = half_float::detail::float2half<std::round_toward_zero>(src[i]);
+                if ((words[i] >> (32 - half_float::res16_bits)) < (bits & half_float::res16_mask)) {
+                    rounded += 1;
+                }
+                dst[i] = rounded;
+            }
+        }
+
+        inline void half_unpack_scalar(const uint16_t* src, float* dst, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                dst[i] = half_float::detail::half2float<float>(src[i]);
+            }
+        }
+
+#if RNDCMP_X86_DISPATCH
+        // VCVTPS2PH turns signalling NaNs into quiet ones, the software conversion keeps the payload as is
+        RNDCMP_TARGET("avx2")
+        inline __m256i halfsr_nan_patterns_avx2(__m256i x) {
+            __m256i sign = _mm256_and_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(0x8000));
+            __m256i payload = _mm256_srli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x7fffff)), 13);
+            return _mm256_or_si256(sign, _mm256_or_si256(_mm256_set1_epi32(0x7c00), payload));
+        }
+
+        RNDCMP_TARGET("avx2,f16c")
+        inline void halfsr_pack_avx2(const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+            const __m256i abs_mask = _mm256_set1_epi32(0x7fffffff);
+            const __m256i infinity = _mm256_set1_epi32(0x7f800000);
+            const __m256i low_mask = _mm256_set1_epi32(half_float::res16_mask);
+            const __m256i half_mask = _mm256_set1_epi32(0xffff);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256 x = _mm256_loadu_ps(src + i);
+                __m256i xi = _mm256_castps_si256(x);
+                __m256i h = _mm256_cvtepu16_epi32(_mm256_cvtps_ph(x, _MM_FROUND_TO_ZERO));
+                __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(xi, abs_mask), infinity);
+                h = _mm256_blendv_epi8(h, halfsr_nan_patterns_avx2(xi), nan);
+
+                __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+                __m256i p = _mm256_srli_epi32(w, 32 - half_float::res16_bits);
+                __m256i up = _mm256_cmpgt_epi32(_mm256_and_si256(xi, low_mask), p);
+                // up is -1 in rounded lanes; the carry out of 0xffff is dropped like in the 16-bit scalar add
+                h = _mm256_and_si256(_mm256_sub_epi32(h, up), half_mask);
+                __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+            }
+            halfsr_pack_scalar(src + i, words + i, dst + i, n - i);
+        }
+
+        RNDCMP_TARGET("avx2,f16c")
+        inline void half_unpack_avx2(const uint16_t* src, float* dst, size_t n) {
+            const __m256i abs_mask = _mm256_set1_epi32(0x7fff);
+            const __m256i infinity = _mm256_set1_epi32(0x7c00);
+            const __m256i quiet = _mm256_set1_epi32(0x00400000);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m256i x = _mm256_castps_si256(_mm256_cvtph_ps(h));
+                // Undo the quieting of signalling NaNs
+                __m256i hi = _mm256_cvtepu16_epi32(h);
+                __m256i signalling = _mm256_and_si256(
+                    _mm256_cmpgt_epi32(_mm256_and_si256(hi, abs_mask), infinity),
+                    _mm256_cmpeq_epi32(_mm256_and_si256(hi, _mm256_set1_epi32(0x200)), _mm256_setzero_si256()));
+                x = _mm256_andnot_si256(_mm256_and_si256(signalling, quiet), x);
+                _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(x));
+            }
+            half_unpack_scalar(src + i, dst + i, n - i);
+        }
+
+        RNDCMP_TARGET("avx512f")
+        inline void halfsr_pack_avx512(const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+            const __m512i abs_mask = _mm512_set1_epi32(0x7fffffff);
+            const __m512i infinity = _mm512_set1_epi32(0x7f800000);
+            const __m512i low_mask = _mm512_set1_epi32(half_float::res16_mask);
+            const __m512i payload_mask = _mm512_set1_epi32(0x7fffff);
+            const __m512i sign_mask = _mm512_set1_epi32(0x8000);
+            const __m512i nan_exponent = _mm512_set1_epi32(0x7c00);
+            const __m512i one = _mm512_set1_epi32(1);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m512 x = _mm512_loadu_ps(src + i);
+                __m512i xi = _mm512_castps_si512(x);
+                __m512i h = _mm512_cvtepu16_epi32(_mm512_cvtps_ph(x, _MM_FROUND_TO_ZERO));
+                __mmask16 nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(xi, abs_mask), infinity);
+                __m512i nan_patterns = _mm512_or_si512(
+                    _mm512_and_si512(_mm512_srli_epi32(xi, 16), sign_mask),
+                    _mm512_or_si512(nan_exponent, _mm512_srli_epi32(_mm512_and_si512(xi, payload_mask), 13)));
+                h = _mm512_mask_mov_epi32(h, nan, nan_patterns);
+
+                __m512i p = _mm512_srli_epi32(_mm512_loadu_si512(words + i), 32 - half_float::res16_bits);
+                __mmask16 up = _mm512_cmpgt_epi32_mask(_mm512_and_si512(xi, low_mask), p);
+                // Truncating narrow drops the carry out of 0xffff
+                __m256i packed = _mm512_cvtepi32_epi16(_mm512_mask_add_epi32(h, up, h, one));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+            }
+            halfsr_pack_scalar(src + i, words + i, dst + i, n - i);
+        }
+
+        RNDCMP_TARGET("avx512f")
+        inline void half_unpack_avx512(const uint16_t* src, float* dst, size_t n) {
+            const __m512i abs_mask = _mm512_set1_epi32(0x7fff);
+            const __m512i infinity = _mm512_set1_epi32(0x7c00);
+            const __m512i quiet_bit = _mm512_set1_epi32(0x200);
+            const __m512i quiet = _mm512_set1_epi32(0x00400000);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m512i x = _mm512_castps_si512(_mm512_cvtph_ps(h));
+                __m512i hi = _mm512_cvtepu16_epi32(h);
+                __mmask16 signalling = _mm512_cmpgt_epi32_mask(_mm512_and_si512(hi, abs_mask), infinity) &
+                                       _mm512_testn_epi32_mask(hi, quiet_bit);
+                x = _mm512_mask_andnot_epi32(x, signalling, quiet, x);
+                _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(x));
+            }
+            half_unpack_scalar(src + i, dst + i, n - i);
+        }
+#endif
+
+        inline void halfsr_pack(simd::Isa isa, const float* src, const uint32_t* words, uint16_t* dst, size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if (isa == simd::Isa::Avx512) {
+                halfsr_pack_avx512(src, words, dst, n);
+                return;
+            }
+            if (isa == simd::Isa::Avx2) {
+                halfsr_pack_avx2(src, words, dst, n);
+                return;
+            }
+#endif
+            halfsr_pack_scalar(src, words, dst, n);
+        }
+
+        inline void half_unpack(simd::Isa isa, const uint16_t* src, float* dst, size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if (isa == simd::Isa::Avx512) {
+                half_unpack_avx512(src, dst, n);
+                return;
+            }
+            if (isa == simd::Isa::Avx2) {
+                half_unpack_avx2(src, dst, n);
+                return;
+            }
+#endif
+            half_unpack_scalar(src, dst, n);
+        }
+    }
+
+    // Stochastically rounds n floats to half, same distribution as basic_halfsr<RNG>(src[i]).
+    // Truncation uses VCVTPS2PH where available; subnormals, overflow and NaNs match the scalar path.
+    template<typename RNG>
+    void round_sr(const float* src, half_float::basic_halfsr<RNG>* dst, size_t n) {
+        static_assert(sizeof(half_float::basic_halfsr<RNG>) == sizeof(uint16_t), "halfsr must have the layout of its 16-bit pattern");
+        uint16_t* raw = reinterpret_cast<uint16_t*>(dst);
+        uint32_t words[simd::block_size];
+        simd::Isa isa = simd::active_isa();
+        for (size_t i = 0; i < n; i += simd::block_size) {
+            size_t count = std::min(n - i, static_cast<size_t>(simd::block_size));
+            RNG::words(words, count);
+            detail::halfsr_pack(isa, src + i, words, raw + i, count);
+        }
+    }
+
+    // Widens n half or halfsr values to float
+    template<typename HALF, std::enable_if_t<std::is_base_of_v<half_float::half, HALF>, int> = 0>
+    void convert(const HALF* src, float* dst, size_t n) {
+        static_assert(sizeof(HALF) == sizeof(uint16_t), "half must have the layout of its 16-bit pattern");
+        detail::half_unpack(simd::active_isa(), reinterpret_cast<const uint16_t*>(src), dst, n);
+    }
 }
 
 #endif  // RNDCMP_INCLUDE_FIXEDSR_HPP_
\ No newline at end of file
@@ -1,10 +1,20 @@
 #ifndef RNDCMP_INCLUDE_INTEGRATOR_HPP_
 #define RNDCMP_INCLUDE_INTEGRATOR_HPP_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <exception>
+#include <functional>
 #include <string>
 #include <iostream>
+#include <type_traits>
+#include <utility>
+
+#include "random.hpp"
+#include "sinks.hpp"
+#include "checkpoint.hpp"
 
 
 namespace rndcmp {
@@ -14,8 +24,85 @@ namespace rndcmp {
     template<typename T>
     using system_type = std::vector<system_func<T>>;
 
-    template<typename DTYPE>
-    class IntegratorBase {
+    namespace detail {
+        template<typename T>
+        using fma_result_t = decltype(fma(std::declval<double>(), std::declval<const T&>(), std::declval<const T&>()));
+
+        // Number types with an fma(double, T, T) that rounds a * b + c once
+        template<typename T, typename = void>
+        struct has_fused_multiply_add: std::false_type {};
+
+        template<typename T>
+        struct has_fused_multiply_add<T, std::void_t<fma_result_t<T>>>:
+            std::bool_constant<std::is_class_v<T> && std::is_same_v<fma_result_t<T>, T>> {};
+
+        // c + a * b, rounded once where the type supports it
+        template<typename T>
+        T multiply_add(double a, const T& b, const T& c) {
+            if constexpr (has_fused_multiply_add<T>::value) {
+                return fma(a, b, c);
+            } else {
+                return T(c + a * b);
+            }
+        }
+
+        // Resolution of a number type: the spacing of its values at 1 and its smallest positive power of two.
+        // Found from values that the type represents exactly, so stochastic rounding does not change them;
+        // the draws are made in a scope of their own and do not shift the stream of the thread.
+        struct Resolution {
+            double relative;
+            double absolute;
+        };
+
+        template<typename T>
+        Resolution resolution() {
+            static const Resolution value = [] {
+                RngContext context(0, 0);
+                auto exact = [](double x) { return static_cast<double>(T(x)) == x; };
+                Resolution result{1.0, 1.0};
+                while (1.0 + result.relative / 2. != 1.0 && exact(1.0 + result.relative / 2.)) {
+                    result.relative /= 2.;
+                }
+                while (result.absolute / 2. > 0. && exact(result.absolute / 2.)) {
+                    result.absolute /= 2.;
+                }
+                return result;
+            }();
+            return value;
+        }
+
+        // Systems that know their dimension, the initial vector is checked against it
+        template<typename SYSTEM, typename = void>
+        struct has_dimension: std::false_type {};
+
+        template<typename SYSTEM>
+        struct has_dimension<SYSTEM, std::void_t<decltype(std::declval<const SYSTEM&>().size())>>: std::true_type {};
+    }
+
+    // Adapter of the per-component form to a system f(x, t, dxdt) that fills the whole derivative
+    template<typename T>
+    class ComponentSystem {
+    public:
+        ComponentSystem(const system_type<T>& system): _system(system) {}
+
+        size_t size() const {
+            return _system.size();
+        }
+
+        void operator()(const std::vector<T>& x, double t, std::vector<T>& dxdt) const {
+            for (size_t i = 0; i < _system.size(); i++) {
+                dxdt[i] = T(_system[i](x, t));
+            }
+        }
+
+    private:
+        system_type<T> _system;
+    };
+
+    // SYSTEM is any callable f(const std::vector<DTYPE>& x, double t, std::vector<DTYPE>& dxdt),
+    // the default one keeps the vector of per-component functions
+    template<typename DTYPE, typename SYSTEM = ComponentSystem<DTYPE>>
+    class IntegratorBase: public CheckpointedRun {
     public:
         class IntegratorException: std::exception {
         public:
@@ -27,133 +114,559 @@ namespace rndcmp {
             std::string _msg;
         };
 
-        IntegratorBase(const system_type<DTYPE>& system, double timeStart, double timeEnd, double step):
-        _system(system), _timeStart(timeStart), _timeEnd(timeEnd), _step(step) {}
+        IntegratorBase(const SYSTEM& system, double timeStart, double timeEnd, double step):
+        CheckpointedRun(timeStart, timeEnd, step), _system(system) {}
     
         void setInitial(const std::vector<DTYPE>& initial) {
-            if (initial.size() != _system.size()) {
-                throw IntegratorException("incorrect vector size");
+            if constexpr (detail::has_dimension<SYSTEM>::value) {
+                if (initial.size() != _system.size()) {
+                    throw IntegratorException("incorrect vector size");
+                }
             }
 
             _initial = initial;
         }
 
-        virtual void solve() = 0;
+        virtual ~IntegratorBase() = default;
+
+        // Keeps every point of the trajectory, see getSolution()
+        virtual void solve() {
+            _solution.clear();
+            _solution.reserve(expectedPoints());
+            solve([this](double, const std::vector<DTYPE>& x) { _solution.push_back(x); });
+        }
 
-        std::vector<std::vector<DTYPE>> getSolution() const {
+        // Passes every point to sink(t, x) as soon as it is computed, nothing is stored by the integrator
+        template<typename SINK>
+        void solve(SINK&& sink) {
+            reset();
+            double t = _timeStart;
+            size_t points = 1;
+            if (!resuming()) {
+                sink(_timeStart, static_cast<const std::vector<DTYPE>&>(_x));
+            } else {
+                t = restore(points);
+            }
+            while (!finished(t)) {
+                t = advance(t);
+                sink(t, static_cast<const std::vector<DTYPE>&>(_x));
+                points++;
+                if (checkpointDue(points)) {
+                    checkpoint(sink, t, points);
+                }
+            }
+        }
+
+        const std::vector<std::vector<DTYPE>>& getSolution() const {
             return _solution;
         }
 
     protected:
-        std::vector<DTYPE> calculate(const std::vector<DTYPE>& x, double t) {
-            std::vector<DTYPE> result;
-            for (auto func : _system) {
-                result.push_back(DTYPE(func(x, t)));
-            }
-            return result;
+        // Starts from the initial point and sizes the buffers of the method
+        virtual void reset() {
+            _x = _initial;
+        }
+
+        // Advances _x from t and returns the time it reached. Fixed-step methods take one step of _step.
+        virtual double advance(double t) {
+            step(t);
+            return t + _step;
+        }
+
+        // Advances _x from t to t + _step. Only the default advance() calls it, methods that override advance()
+        // need not implement it.
+        virtual void step(double) {
+            throw IntegratorException("the integrator takes no fixed steps");
+        }
+
+        // The fixed-step loop is t = timeStart; t <= timeEnd; t += step
+        virtual bool finished(double t) const {
+            return t > _timeEnd;
+        }
+
+        // Evaluates the system into result, which must have the dimension of the system
+        void calculate(const std::vector<DTYPE>& x, double t, std::vector<DTYPE>& result) {
+            _system(x, t, result);
+        }
+
+        // State of the method kept between the steps besides _x, e.g. a cached derivative or the step controller
+        virtual void saveState(CheckpointWriter&) const {}
+
+        // Called after reset() and after _x is read
+        virtual void loadState(CheckpointReader&) {}
+
+        template<typename SINK>
+        void checkpoint(SINK& sink, double t, size_t points) {
+            writeCheckpoint<DTYPE>(sink, t, points, _x, [this](CheckpointWriter& writer) { saveState(writer); });
+        }
+
+        // Reads the checkpoint given to resumeFrom() over the state set by reset(), returns its time
+        double restore(size_t& points) {
+            return readCheckpoint<DTYPE>(_x, points, [this](CheckpointReader& reader) { loadState(reader); });
         }
 
         std::vector<DTYPE> _initial;
+        std::vector<DTYPE> _x;
         std::vector<std::vector<DTYPE>> _solution;
-        system_type<DTYPE> _system;
-        double _timeStart;
-        double _timeEnd;
-        double _step;
+        SYSTEM _system;
     };
 
 
-    template<typename DTYPE>
-    class EulerIntegrator: public IntegratorBase<DTYPE> {
+    // The integrators keep the state and the stage vectors between steps, so a step only does arithmetic
+    template<typename DTYPE, typename SYSTEM = ComponentSystem<DTYPE>>
+    class EulerIntegrator: public IntegratorBase<DTYPE, SYSTEM> {
     public:
-        using IntegratorBase<DTYPE>::_initial;
-        using IntegratorBase<DTYPE>::_solution;
-        using IntegratorBase<DTYPE>::_system;
-        using IntegratorBase<DTYPE>::_timeStart;
-        using IntegratorBase<DTYPE>::_timeEnd;
-        using IntegratorBase<DTYPE>::_step;
-
-        EulerIntegrator(const system_type<DTYPE>& system, double timeStart, double timeEnd, double step):
-        IntegratorBase<DTYPE>(system, timeStart, timeEnd, step) {}
-
-        void solve() override {
-            std::vector<DTYPE> tempX(_initial.begin(), _initial.end());
-            _solution.push_back(_initial);
-
-            for (double t = _timeStart; t <= _timeEnd; t+=_step) {
-                std::vector<DTYPE> newX;
-                std::vector<DTYPE> f = this->calculate(tempX, t);
-                for (size_t i = 0; i < tempX.size(); i++) {
-                    newX.push_back(DTYPE(tempX[i] + _step * f[i]));
-                }
-                tempX = newX;
-                _solution.push_back(newX);
+        using IntegratorBase<DTYPE, SYSTEM>::_initial;
+        using IntegratorBase<DTYPE, SYSTEM>::_x;
+        using IntegratorBase<DTYPE, SYSTEM>::_solution;
+        using IntegratorBase<DTYPE, SYSTEM>::_system;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeStart;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeEnd;
+        using IntegratorBase<DTYPE, SYSTEM>::_step;
+
+        EulerIntegrator(const SYSTEM& system, double timeStart, double timeEnd, double step):
+        IntegratorBase<DTYPE, SYSTEM>(system, timeStart, timeEnd, step) {}
+
+        using IntegratorBase<DTYPE, SYSTEM>::solve;
+
+    protected:
+        void reset() override {
+            IntegratorBase<DTYPE, SYSTEM>::reset();
+            _f.resize(_x.size());
+        }
+
+        void step(double t) override {
+            this->calculate(_x, t, _f);
+            for (size_t i = 0; i < _x.size(); i++) {
+                _x[i] = detail::multiply_add(_step, _f[i], _x[i]);
             }
         }
+
+        std::vector<DTYPE> _f;
     };
 
-    template<typename DTYPE>
-    class RK4Integrator: public IntegratorBase<DTYPE> {
+    template<typename DTYPE, typename SYSTEM = ComponentSystem<DTYPE>>
+    class RK4Integrator: public IntegratorBase<DTYPE, SYSTEM> {
     public:
-        using IntegratorBase<DTYPE>::_initial;
-        using IntegratorBase<DTYPE>::_solution;
-        using IntegratorBase<DTYPE>::_system;
-        using IntegratorBase<DTYPE>::_timeStart;
-        using IntegratorBase<DTYPE>::_timeEnd;
-        using IntegratorBase<DTYPE>::_step;
-
-        RK4Integrator(const system_type<DTYPE>& system, double timeStart, double timeEnd, double step):
-        IntegratorBase<DTYPE>(system, timeStart, timeEnd, step) {}
-
-        void solve() override {
-            std::vector<DTYPE> tempX(_initial.begin(), _initial.end());
-            _solution.push_back(_initial);
-
-            for (double t = _timeStart; t <= _timeEnd; t+=_step) {
-                std::vector<DTYPE> k1 = getk1(tempX, t);
-                
-                std::vector<DTYPE> k2 = getk2(tempX, k1, t);
-                std::vector<DTYPE> k3 = getk3(tempX, k2, t);
-                std::vector<DTYPE> k4 = getk4(tempX, k3, t);
-
-                std::vector<DTYPE> newX;
-                for (size_t i = 0; i < tempX.size(); i++) {
-                    newX.push_back(DTYPE(tempX[i] + _step / 6. * (k1[i] + 2. * k2[i] + 2. * k3[i] + k4[i])));
+        using IntegratorBase<DTYPE, SYSTEM>::_initial;
+        using IntegratorBase<DTYPE, SYSTEM>::_x;
+        using IntegratorBase<DTYPE, SYSTEM>::_solution;
+        using IntegratorBase<DTYPE, SYSTEM>::_system;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeStart;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeEnd;
+        using IntegratorBase<DTYPE, SYSTEM>::_step;
+
+        RK4Integrator(const SYSTEM& system, double timeStart, double timeEnd, double step):
+        IntegratorBase<DTYPE, SYSTEM>(system, timeStart, timeEnd, step) {}
+
+        using IntegratorBase<DTYPE, SYSTEM>::solve;
+
+    protected:
+        void reset() override {
+            IntegratorBase<DTYPE, SYSTEM>::reset();
+            for (auto* buffer : {&_k1, &_k2, &_k3, &_k4, &_stage}) {
+                buffer->resize(_x.size());
+            }
+        }
+
+        void step(double t) override {
+            this->calculate(_x, t, _k1);
+            stage(_step / 2., _k1);
+            this->calculate(_stage, t + _step / 2., _k2);
+            stage(_step / 2., _k2);
+            this->calculate(_stage, t + _step / 2., _k3);
+            stage(_step, _k3);
+            this->calculate(_stage, t + _step, _k4);
+
+            for (size_t i = 0; i < _x.size(); i++) {
+                if constexpr (detail::has_fused_multiply_add<DTYPE>::value) {
+                    // Four roundings instead of seven
+                    DTYPE sum = detail::multiply_add(2., _k3[i], detail::multiply_add(2., _k2[i], _k1[i])) + _k4[i];
+                    _x[i] = detail::multiply_add(_step / 6., sum, _x[i]);
+                } else {
+                    _x[i] = DTYPE(_x[i] + _step / 6. * (_k1[i] + 2. * _k2[i] + 2. * _k3[i] + _k4[i]));
                 }
-                tempX = newX;
-                _solution.push_back(newX);
             }
         }
 
+        // Argument of the next stage: x + h * k
+        void stage(double h, const std::vector<DTYPE>& k) {
+            for (size_t i = 0; i < _x.size(); i++) {
+                _stage[i] = detail::multiply_add(h, k[i], _x[i]);
+            }
+        }
+
+        std::vector<DTYPE> _k1, _k2, _k3, _k4;
+        std::vector<DTYPE> _stage;
+    };
+
+    // dq/dt = p, the kinetic energy of unit masses
+    template<typename T>
+    struct IdentityVelocity {
+        void operator()(const std::vector<T>& p, double, std::vector<T>& dqdt) const {
+            dqdt = p;
+        }
+    };
+
+    // Separable Hamiltonian H(q, p) = K(p) + V(q) with n degrees of freedom. The state holds q and then p.
+    // force(q, t, dpdt) computes -dV/dq, velocity(p, t, dqdt) computes dK/dp. The system works as the right-hand
+    // side of any integrator; the symplectic ones call force and velocity separately.
+    template<typename T, typename FORCE, typename VELOCITY = IdentityVelocity<T>>
+    class SeparableSystem {
+    public:
+        SeparableSystem(const FORCE& force, size_t degrees, const VELOCITY& velocity = VELOCITY()):
+        _force(force), _velocity(velocity), _degrees(degrees) {}
+
+        size_t size() const {
+            return 2 * _degrees;
+        }
+
+        size_t degrees() const {
+            return _degrees;
+        }
+
+        void force(const std::vector<T>& q, double t, std::vector<T>& dpdt) {
+            _force(q, t, dpdt);
+        }
+
+        void velocity(const std::vector<T>& p, double t, std::vector<T>& dqdt) {
+            _velocity(p, t, dqdt);
+        }
+
+        void operator()(const std::vector<T>& x, double t, std::vector<T>& dxdt) {
+            _q.assign(x.begin(), x.begin() + _degrees);
+            _p.assign(x.begin() + _degrees, x.end());
+            _dq.resize(_degrees);
+            _dp.resize(_degrees);
+            _velocity(_p, t, _dq);
+            _force(_q, t, _dp);
+            std::copy(_dq.begin(), _dq.end(), dxdt.begin());
+            std::copy(_dp.begin(), _dp.end(), dxdt.begin() + _degrees);
+        }
+
+    private:
+        FORCE _force;
+        VELOCITY _velocity;
+        size_t _degrees;
+        std::vector<T> _q, _p, _dq, _dp;
+    };
+
+    template<typename T, typename FORCE>
+    SeparableSystem<T, FORCE> make_separable_system(const FORCE& force, size_t degrees) {
+        return SeparableSystem<T, FORCE>(force, degrees);
+    }
+
+    // Velocity Verlet (leapfrog in kick-drift-kick form) for a SeparableSystem, second order and symplectic:
+    // the energy error stays bounded over long runs instead of drifting. The force at the end of a step is
+    // reused at the start of the next one, so a step costs one force and one velocity evaluation.
+    template<typename DTYPE, typename SYSTEM>
+    class VerletIntegrator: public IntegratorBase<DTYPE, SYSTEM> {
+    public:
+        using IntegratorBase<DTYPE, SYSTEM>::_initial;
+        using IntegratorBase<DTYPE, SYSTEM>::_x;
+        using IntegratorBase<DTYPE, SYSTEM>::_solution;
+        using IntegratorBase<DTYPE, SYSTEM>::_system;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeStart;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeEnd;
+        using IntegratorBase<DTYPE, SYSTEM>::_step;
+
+        VerletIntegrator(const SYSTEM& system, double timeStart, double timeEnd, double step):
+        IntegratorBase<DTYPE, SYSTEM>(system, timeStart, timeEnd, step) {}
+
+        using IntegratorBase<DTYPE, SYSTEM>::solve;
+
+    protected:
+        void reset() override {
+            IntegratorBase<DTYPE, SYSTEM>::reset();
+            size_t n = _system.degrees();
+            _q.assign(_x.begin(), _x.begin() + n);
+            _p.assign(_x.begin() + n, _x.end());
+            _force.resize(n);
+            _velocity.resize(n);
+            _system.force(_q, _timeStart, _force);
+        }
+
+        void step(double t) override {
+            kickDriftKick(t, _step);
+            store();
+        }
+
+        // One step of h; _force holds the force at (q, t) before and at the new (q, t + h) after
+        void kickDriftKick(double t, double h) {
+            for (size_t i = 0; i < _p.size(); i++) {
+                _p[i] = detail::multiply_add(h / 2., _force[i], _p[i]);
+            }
+            _system.velocity(_p, t + h / 2., _velocity);
+            for (size_t i = 0; i < _q.size(); i++) {
+                _q[i] = detail::multiply_add(h, _velocity[i], _q[i]);
+            }
+            _system.force(_q, t + h, _force);
+            for (size_t i = 0; i < _p.size(); i++) {
+                _p[i] = detail::multiply_add(h / 2., _force[i], _p[i]);
+            }
+        }
+
+        void store() {
+            std::copy(_q.begin(), _q.end(), _x.begin());
+            std::copy(_p.begin(), _p.end(), _x.begin() + _q.size());
+        }
+
+        void saveState(CheckpointWriter& writer) const override {
+            writer.writeRange(_force);
+        }
+
+        // q and p are the halves of the restored _x, the force is not evaluated again
+        void loadState(CheckpointReader& reader) override {
+            std::copy(_x.begin(), _x.begin() + _q.size(), _q.begin());
+            std::copy(_x.begin() + _q.size(), _x.end(), _p.begin());
+            reader.readRange(_force);
+        }
+
+        std::vector<DTYPE> _q, _p;
+        std::vector<DTYPE> _force;
+        std::vector<DTYPE> _velocity;
+    };
+
+    // Fourth order symplectic integrator of Yoshida: three Verlet steps of w1 h, w0 h, w1 h
+    template<typename DTYPE, typename SYSTEM>
+    class YoshidaIntegrator: public VerletIntegrator<DTYPE, SYSTEM> {
+    public:
+        YoshidaIntegrator(const SYSTEM& system, double timeStart, double timeEnd, double step):
+        VerletIntegrator<DTYPE, SYSTEM>(system, timeStart, timeEnd, step) {}
+
     protected:
-        std::vector<DTYPE> getk1(const std::vector<DTYPE>& x, double t) {
-            auto res = this->calculate(x, t);
-            return res;
+        void step(double t) override {
+            double h = this->_step;
+            this->kickDriftKick(t, w1 * h);
+            this->kickDriftKick(t + w1 * h, w0 * h);
+            this->kickDriftKick(t + (w1 + w0) * h, w1 * h);
+            this->store();
+        }
+
+        static constexpr double cbrt2 = 1.2599210498948731648;
+        static constexpr double w1 = 1. / (2. - cbrt2);
+        static constexpr double w0 = -cbrt2 / (2. - cbrt2);
+    };
+
+    // Adaptive embedded Runge-Kutta 5(4) of Dormand and Prince. The state and the right-hand side stay in DTYPE;
+    // the stage sums and the error estimate are computed in WIDE, and every stage value is rounded to DTYPE
+    // once. The error of the 4th order solution is then measured without the rounding noise of DTYPE, and the
+    // tolerance is kept above the resolution of DTYPE, so the controller neither chases the noise nor shrinks
+    // the step forever. The step passed to the constructor is the initial one.
+    template<typename DTYPE, typename SYSTEM = ComponentSystem<DTYPE>, typename WIDE = double>
+    class DormandPrinceIntegrator: public IntegratorBase<DTYPE, SYSTEM> {
+    public:
+        using IntegratorBase<DTYPE, SYSTEM>::_initial;
+        using IntegratorBase<DTYPE, SYSTEM>::_x;
+        using IntegratorBase<DTYPE, SYSTEM>::_solution;
+        using IntegratorBase<DTYPE, SYSTEM>::_system;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeStart;
+        using IntegratorBase<DTYPE, SYSTEM>::_timeEnd;
+        using IntegratorBase<DTYPE, SYSTEM>::_step;
+        using IntegratorException = typename IntegratorBase<DTYPE, SYSTEM>::IntegratorException;
+
+        DormandPrinceIntegrator(const SYSTEM& system, double timeStart, double timeEnd, double step):
+        IntegratorBase<DTYPE, SYSTEM>(system, timeStart, timeEnd, step), _maxStep(timeEnd - timeStart) {}
+
+        using IntegratorBase<DTYPE, SYSTEM>::solve;
+
+        // Componentwise tolerance: absolute + relative * |x|
+        void setTolerance(double absolute, double relative) {
+            _absolute = absolute;
+            _relative = relative;
+        }
+
+        // Steps are not taken smaller than minStep, a step of minStep is accepted whatever its finite error.
+        // A non-finite error at the smallest step, or a step that no longer moves t, throws IntegratorException.
+        void setStepLimits(double minStep, double maxStep) {
+            _minStep = minStep;
+            _maxStep = maxStep;
         }
 
-        std::vector<DTYPE> getk2(const std::vector<DTYPE>& x, const std::vector<DTYPE>& k1, double t) {
-            std::vector<DTYPE> k2X;
-            for (size_t i = 0; i < x.size(); i++) {
-                k2X.push_back(DTYPE(x[i] + _step / 2. * k1[i]));
+        size_t getAcceptedSteps() const {
+            return _accepted;
+        }
+
+        size_t getRejectedSteps() const {
+            return _rejected;
+        }
+
+    protected:
+        static constexpr int stages = 7;
+
+        void reset() override {
+            IntegratorBase<DTYPE, SYSTEM>::reset();
+            for (auto& k : _k) {
+                k.resize(_x.size());
             }
-            return this->calculate(k2X, t + _step / 2.);
+            _stage.resize(_x.size());
+            _next.resize(_x.size());
+            _firstStage = false;
+            _h = std::min(_step, _maxStep);
+            _accepted = 0;
+            _rejected = 0;
         }
 
-        std::vector<DTYPE> getk3(const std::vector<DTYPE>& x, const std::vector<DTYPE>& k2, double t) {
-            std::vector<DTYPE> k3X;
-            for (size_t i = 0; i < x.size(); i++) {
-                k3X.push_back(DTYPE(x[i] + _step / 2. * k2[i]));
+        double advance(double t) override {
+            bool rejected = false;
+            while (true) {
+                // The last step ends exactly at timeEnd
+                bool last = _h >= _timeEnd - t;
+                double h = last ? _timeEnd - t : _h;
+                if (t + h == t) {
+                    throw IntegratorException("step below the resolution of t");
+                }
+                double error = attempt(t, h);
+                // No progress below the resolution of t, the step has to be taken
+                bool smallest = h <= _minStep || t + h / 2. == t;
+                // A NaN or infinite error is a rejection with the largest decrease; at the smallest step there
+                // is nothing left to try
+                if (!std::isfinite(error)) {
+                    if (smallest) {
+                        throw IntegratorException("non-finite error estimate");
+                    }
+                    _rejected++;
+                    rejected = true;
+                    _h = std::min(std::max(h * 0.2, _minStep), _maxStep);
+                    continue;
+                }
+                double factor = error > 0. ? 0.9 * std::pow(error, -0.2) : 5.;
+                factor = std::min(std::max(factor, 0.2), 5.);
+                if (error <= 1. || smallest) {
+                    accept();
+                    _accepted++;
+                    if (!last) {
+                        _h = std::min(std::max(h * (rejected ? std::min(factor, 1.) : factor), _minStep), _maxStep);
+                    }
+                    return last ? _timeEnd : t + h;
+                }
+                _rejected++;
+                rejected = true;
+                _h = std::min(std::max(h * factor, _minStep), _maxStep);
             }
-            return this->calculate(k3X, t + _step / 2.);
         }
 
-        std::vector<DTYPE> getk4(const std::vector<DTYPE>& x, const std::vector<DTYPE>& k3, double t) {
-            std::vector<DTYPE> k4X;
-            for (size_t i = 0; i < x.size(); i++) {
-                k4X.push_back(DTYPE(x[i] + _step * k3[i]));
+        bool finished(double t) const override {
+            return t >= _timeEnd;
+        }
+
+        // Computes the 5th order solution of a step of h into _next, returns the error norm relative to the tolerance
+        WIDE attempt(double t, double h) {
+            if (!_firstStage) {
+                this->calculate(_x, t, _k[0]);
+                _firstStage = true;
+            }
+            for (int s = 1; s < stages; s++) {
+                for (size_t i = 0; i < _x.size(); i++) {
+                    WIDE sum = 0;
+                    for (int j = 0; j < s; j++) {
+                        sum += WIDE(a[s][j]) * wide(_k[j][i]);
+                    }
+                    WIDE value = wide(_x[i]) + WIDE(h) * sum;
+                    (s == stages - 1 ? _next : _stage)[i] = DTYPE(static_cast<double>(value));
+                }
+                this->calculate(s == stages - 1 ? _next : _stage, t + c[s] * h, _k[s]);
             }
-            return this->calculate(k4X, t + _step);
+
+            // The last stage is the 5th order solution, its derivative is the first stage of the next step
+            WIDE norm = 0;
+            detail::Resolution resolution = detail::resolution<DTYPE>();
+            WIDE absolute = std::max(WIDE(_absolute), WIDE(resolution.absolute));
+            WIDE relative = std::max(WIDE(_relative), WIDE(resolution.relative));
+            for (size_t i = 0; i < _x.size(); i++) {
+                WIDE error = 0;
+                for (int j = 0; j < stages; j++) {
+                    error += WIDE(e[j]) * wide(_k[j][i]);
+                }
+                error *= WIDE(h);
+                WIDE scale = absolute + relative * std::max(std::abs(wide(_x[i])), std::abs(wide(_next[i])));
+                norm += (error / scale) * (error / scale);
+            }
+            return _x.empty() ? WIDE(0) : std::sqrt(norm / WIDE(_x.size()));
+        }
+
+        void accept() {
+            _x.swap(_next);
+            _k[0].swap(_k[stages - 1]);
+        }
+
+        // The first stage of the next step and the controller
+        void saveState(CheckpointWriter& writer) const override {
+            writer.writeRange(_k[0]);
+            writer.write(_firstStage);
+            writer.write(_h);
+            writer.write(static_cast<std::uint64_t>(_accepted));
+            writer.write(static_cast<std::uint64_t>(_rejected));
         }
+
+        void loadState(CheckpointReader& reader) override {
+            reader.readRange(_k[0]);
+            _firstStage = reader.read<bool>();
+            _h = reader.read<double>();
+            _accepted = static_cast<size_t>(reader.read<std::uint64_t>());
+            _rejected = static_cast<size_t>(reader.read<std::uint64_t>());
+        }
+
+        static WIDE wide(const DTYPE& value) {
+            return WIDE(static_cast<double>(value));
+        }
+
+        // Butcher tableau; the last row of a is the 5th order weights
+        static constexpr double c[stages] = {0., 1. / 5., 3. / 10., 4. / 5., 8. / 9., 1., 1.};
+        static constexpr double a[stages][stages - 1] = {
+            {},
+            {1. / 5.},
+            {3. / 40., 9. / 40.},
+            {44. / 45., -56. / 15., 32. / 9.},
+            {19372. / 6561., -25360. / 2187., 64448. / 6561., -212. / 729.},
+            {9017. / 3168., -355. / 33., 46732. / 5247., 49. / 176., -5103. / 18656.},
+            {35. / 384., 0., 500. / 1113., 125. / 192., -2187. / 6784., 11. / 84.}
+        };
+        // Difference of the 5th and the 4th order weights
+        static constexpr double e[stages] = {
+            71. / 57600., 0., -71. / 16695., 71. / 1920., -17253. / 339200., 22. / 525., -1. / 40.
+        };
+
+        std::vector<DTYPE> _k[stages];
+        std::vector<DTYPE> _stage;
+        std::vector<DTYPE> _next;
+        bool _firstStage = false;
+
+        double _h = 0.;
+        double _absolute = 1e-6;
+        double _relative = 1e-6;
+        double _minStep = 0.;
+        double _maxStep;
+        size_t _accepted = 0;
+        size_t _rejected = 0;
     };
+
+    // The integrators for a callable system, its type is deduced:
+    // auto integrator = make_rk4_integrator<double>([](const auto& x, double t, auto& dxdt) { ... }, 0., 1., 0.01);
+    template<typename DTYPE, typename SYSTEM>
+    EulerIntegrator<DTYPE, SYSTEM> make_euler_integrator(const SYSTEM& system, double timeStart, double timeEnd, double step) {
+        return EulerIntegrator<DTYPE, SYSTEM>(system, timeStart, timeEnd, step);
+    }
+
+    template<typename DTYPE, typename SYSTEM>
+    RK4Integrator<DTYPE, SYSTEM> make_rk4_integrator(const SYSTEM& system, double timeStart, double timeEnd, double step) {
+        return RK4Integrator<DTYPE, SYSTEM>(system, timeStart, timeEnd, step);
+    }
+
+    template<typename DTYPE, typename SYSTEM>
+    VerletIntegrator<DTYPE, SYSTEM> make_verlet_integrator(const SYSTEM& system, double timeStart, double timeEnd, double step) {
+        return VerletIntegrator<DTYPE, SYSTEM>(system, timeStart, timeEnd, step);
+    }
+
+    template<typename DTYPE, typename SYSTEM>
+    YoshidaIntegrator<DTYPE, SYSTEM> make_yoshida_integrator(const SYSTEM& system, double timeStart, double timeEnd, double step) {
+        return YoshidaIntegrator<DTYPE, SYSTEM>(system, timeStart, timeEnd, step);
+    }
+
+    template<typename DTYPE, typename SYSTEM>
+    DormandPrinceIntegrator<DTYPE, SYSTEM> make_dormand_prince_integrator(const SYSTEM& system, double timeStart, double timeEnd, double step) {
+        return DormandPrinceIntegrator<DTYPE, SYSTEM>(system, timeStart, timeEnd, step);
+    }
 }
 
 #endif  // RNDCMP_INCLUDE_INTEGRATOR_HPP_
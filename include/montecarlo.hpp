@@ -0,0 +1,88 @@
+#ifndef RNDCMP_INCLUDE_MONTECARLO_HPP_
+#define RNDCMP_INCLUDE_MONTECARLO_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "random.hpp"
+#include "sinks.hpp"
+#include "thread_pool.hpp"
+
+
+namespace rndcmp {
+    struct MonteCarloOptions {
+        // Workers run on ThreadPool::shared(), 0 uses every thread of the pool
+        unsigned threads = 0;
+        // Trials a worker takes at once. Statistics are accumulated per chunk and merged in the order of the chunks,
+        // so the result does not depend on the number of threads.
+        std::size_t chunk = 16;
+    };
+
+    namespace detail {
+        // Chunks of trials owned by one worker. The owner and the workers that steal from it claim a chunk with
+        // a fetch_add on next, nobody locks.
+        struct TrialRange {
+            alignas(64) std::atomic<std::size_t> next{0};
+            std::size_t end = 0;
+        };
+
+        template<typename RESULT>
+        void add_trial_result(StatisticsSink& statistics, std::size_t trial, const RESULT& result) {
+            if constexpr (std::is_arithmetic_v<RESULT>) {
+                statistics(static_cast<double>(trial), std::vector<double>{static_cast<double>(result)});
+            } else {
+                statistics(static_cast<double>(trial), result);
+            }
+        }
+    }
+
+    // Runs trial(i) for i = 0 .. trials - 1 on the shared thread pool and returns the mean, variance, minimum
+    // and maximum of the results. trial returns a number or a std::vector of numbers and is called concurrently.
+    //
+    // Trial i draws from the RNG stream i of a seed taken from the calling thread, whichever worker runs it,
+    // so a seeded run replays exactly and a single trial can be replayed with RngContext(seed, i).
+    // The seed is drawn as gemm draws it, from the stream the number type T of the trials rounds with:
+    // run_trials<FloatSR>(...).
+    // Every worker starts with an equal share of the chunks and steals from the others when its own are done.
+    template<typename T, typename TRIAL>
+    StatisticsSink run_trials(std::size_t trials, TRIAL&& trial, const MonteCarloOptions& options = MonteCarloOptions()) {
+        std::size_t chunk = std::max<std::size_t>(options.chunk, 1);
+        std::size_t chunks = (trials + chunk - 1) / chunk;
+        ThreadPool& pool = ThreadPool::shared();
+        std::size_t threads = options.threads == 0 ? pool.size() : options.threads;
+        threads = std::max<std::size_t>(std::min(threads, chunks), 1);
+
+        std::uint64_t seed = detail::worker_seed<T>();
+        std::vector<StatisticsSink> partial(chunks);
+        std::vector<detail::TrialRange> ranges(threads);
+        for (std::size_t w = 0; w < threads; w++) {
+            ranges[w].next = chunks * w / threads;
+            ranges[w].end = chunks * (w + 1) / threads;
+        }
+
+        auto work = [&](std::size_t worker) {
+            for (std::size_t v = 0; v < threads; v++) {
+                detail::TrialRange& range = ranges[(worker + v) % threads];
+                for (std::size_t c = range.next.fetch_add(1); c < range.end; c = range.next.fetch_add(1)) {
+                    for (std::size_t i = c * chunk; i < std::min(trials, (c + 1) * chunk); i++) {
+                        RngContext context(seed, i);
+                        detail::add_trial_result(partial[c], i, trial(i));
+                    }
+                }
+            }
+        };
+
+        pool.run(threads, work);
+
+        StatisticsSink result;
+        for (const StatisticsSink& statistics : partial) {
+            result.merge(statistics);
+        }
+        return result;
+    }
+}
+
+#endif  // RNDCMP_INCLUDE_MONTECARLO_HPP_
@@ -0,0 +1,302 @@
+#ifndef RNDCMP_INCLUDE_PACKET_HPP_
+#define RNDCMP_INCLUDE_PACKET_HPP_
+
+#include <Eigen/Core>
+
+
+// Eigen packet math for the SR types. A packet holds packet_size raw values of an SR type; arithmetic on it is done
+// by detail::PacketOps<SCALAR>, which every type specializes with its block rounding kernels, so Eigen's vectorized
+// assignment, GEMV and GEMM paths round a whole packet at once instead of going through the scalar operators.
+//
+// Eigen selects packet loads by explicit specialization of function templates (pload<Packet>, pset1<Packet>, ...) on
+// the concrete packet type. Function templates cannot be partially specialized, so there is no way to enable packet
+// math for all instantiations of a class template at once: it is enabled per scalar type with
+// RNDCMP_EIGEN_PACKET_MATH(type). The SR headers enable it for their default aliases; other instantiations stay
+// scalar in Eigen until the macro is expanded for them.
+
+namespace rndcmp {
+namespace detail {
+    constexpr int packet_size = 8;
+
+    // Raw storage of one packet: the bits of packet_size values of SCALAR, see PacketOps::lane()
+    template<typename SCALAR, typename LANE>
+    struct SrPacket {
+        LANE lanes[packet_size];
+    };
+
+    // Specialized by every SR type:
+    //   using lane_t = ...;
+    //   static lane_t lane(const SCALAR& x);  // raw bits of x
+    //   static SCALAR scalar(lane_t raw);      // value with the raw bits
+    //   static void add(const lane_t* a, const lane_t* b, lane_t* out);  // and sub, mul, div
+    //   static void negate(const lane_t* a, lane_t* out);
+    template<typename SCALAR>
+    struct PacketOps;
+
+    template<typename SCALAR>
+    using packet_t = SrPacket<SCALAR, typename PacketOps<SCALAR>::lane_t>;
+
+    template<typename SCALAR>
+    packet_t<SCALAR> packet_load(const SCALAR* from) {
+        packet_t<SCALAR> p;
+        for (int i = 0; i < packet_size; i++) {
+            p.lanes[i] = PacketOps<SCALAR>::lane(from[i]);
+        }
+        return p;
+    }
+
+    template<typename SCALAR>
+    void packet_store(SCALAR* to, const packet_t<SCALAR>& p) {
+        for (int i = 0; i < packet_size; i++) {
+            to[i] = PacketOps<SCALAR>::scalar(p.lanes[i]);
+        }
+    }
+
+    // Element i of the packet is from[i / REPEAT]
+    template<int REPEAT, typename SCALAR>
+    packet_t<SCALAR> packet_repeat(const SCALAR* from) {
+        packet_t<SCALAR> p;
+        for (int i = 0; i < packet_size; i++) {
+            p.lanes[i] = PacketOps<SCALAR>::lane(from[i / REPEAT]);
+        }
+        return p;
+    }
+
+    template<typename SCALAR>
+    packet_t<SCALAR> packet_gather(const SCALAR* from, Eigen::Index stride) {
+        packet_t<SCALAR> p;
+        for (int i = 0; i < packet_size; i++) {
+            p.lanes[i] = PacketOps<SCALAR>::lane(from[i * stride]);
+        }
+        return p;
+    }
+
+    template<typename SCALAR>
+    void packet_scatter(SCALAR* to, const packet_t<SCALAR>& p, Eigen::Index stride) {
+        for (int i = 0; i < packet_size; i++) {
+            to[i * stride] = PacketOps<SCALAR>::scalar(p.lanes[i]);
+        }
+    }
+
+    template<typename SCALAR>
+    SCALAR packet_lane(const packet_t<SCALAR>& p, int i) {
+        return PacketOps<SCALAR>::scalar(p.lanes[i]);
+    }
+
+    template<typename SCALAR>
+    packet_t<SCALAR> packet_reverse(const packet_t<SCALAR>& p) {
+        packet_t<SCALAR> result;
+        for (int i = 0; i < packet_size; i++) {
+            result.lanes[i] = p.lanes[packet_size - 1 - i];
+        }
+        return result;
+    }
+
+    // Sums the lanes pairwise with the scalar operator, rounding after every addition like the scalar code does
+    template<typename SCALAR>
+    SCALAR packet_sum(const packet_t<SCALAR>& p) {
+        static_assert(packet_size == 8, "packet_sum is written for 8 lanes");
+        auto lane = [&p](int i) { return packet_lane<SCALAR>(p, i); };
+        SCALAR low = (lane(0) + lane(4)) + (lane(2) + lane(6));
+        SCALAR high = (lane(1) + lane(5)) + (lane(3) + lane(7));
+        return low + high;
+    }
+
+    template<typename SCALAR, int N>
+    void packet_transpose(Eigen::internal::PacketBlock<packet_t<SCALAR>, N>& block) {
+        using lane_t = typename PacketOps<SCALAR>::lane_t;
+        lane_t lanes[N][packet_size];
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < packet_size; j++) {
+                lanes[i][j] = block.packet[i].lanes[j];
+            }
+        }
+        // N rows of packet_size lanes become N packets read down the columns, like Eigen's native transposes
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < packet_size; j++) {
+                int flat = i * packet_size + j;
+                block.packet[i].lanes[j] = lanes[flat % N][flat / N];
+            }
+        }
+    }
+
+    template<typename SCALAR>
+    struct PacketArith {
+        using packet = packet_t<SCALAR>;
+        using ops = PacketOps<SCALAR>;
+
+        static packet add(const packet& a, const packet& b) {
+            packet r;
+            ops::add(a.lanes, b.lanes, r.lanes);
+            return r;
+        }
+
+        static packet sub(const packet& a, const packet& b) {
+            packet r;
+            ops::sub(a.lanes, b.lanes, r.lanes);
+            return r;
+        }
+
+        static packet mul(const packet& a, const packet& b) {
+            packet r;
+            ops::mul(a.lanes, b.lanes, r.lanes);
+            return r;
+        }
+
+        static packet div(const packet& a, const packet& b) {
+            packet r;
+            ops::div(a.lanes, b.lanes, r.lanes);
+            return r;
+        }
+
+        static packet negate(const packet& a) {
+            packet r;
+            ops::negate(a.lanes, r.lanes);
+            return r;
+        }
+    };
+
+    template<typename SCALAR>
+    struct sr_packet_traits: Eigen::internal::default_packet_traits {
+        typedef packet_t<SCALAR> type;
+        typedef packet_t<SCALAR> half;
+        enum {
+            Vectorizable = 1,
+            AlignedOnScalar = 1,
+            size = packet_size,
+            HasHalfPacket = 0,
+
+            HasAdd = 1,
+            HasSub = 1,
+            HasMul = 1,
+            HasDiv = 1,
+            HasNegate = 1,
+            HasConj = 1,
+            HasShift = 0,
+            HasAbs = 0,
+            HasAbs2 = 0,
+            HasMin = 0,
+            HasMax = 0,
+            HasSetLinear = 0,
+            HasBlend = 0
+        };
+    };
+}
+}
+
+namespace Eigen {
+namespace internal {
+    template<typename SCALAR, typename LANE>
+    struct unpacket_traits<rndcmp::detail::SrPacket<SCALAR, LANE>> {
+        typedef SCALAR type;
+        typedef rndcmp::detail::SrPacket<SCALAR, LANE> half;
+        enum {
+            size = rndcmp::detail::packet_size,
+            alignment = Aligned16,
+            vectorizable = true,
+            masked_load_available = false,
+            masked_store_available = false
+        };
+    };
+}
+}
+
+// Enables Eigen vectorization for the SR type passed as the argument (commas in template arguments are fine)
+#define RNDCMP_EIGEN_PACKET_MATH(...) \
+namespace Eigen { \
+namespace internal { \
+    template<> struct packet_traits<__VA_ARGS__>: rndcmp::detail::sr_packet_traits<__VA_ARGS__> {}; \
+    \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pset1<rndcmp::detail::packet_t<__VA_ARGS__>>(const __VA_ARGS__& a) { \
+        return rndcmp::detail::packet_repeat<rndcmp::detail::packet_size>(&a); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pload1<rndcmp::detail::packet_t<__VA_ARGS__>>(const __VA_ARGS__* from) { \
+        return rndcmp::detail::packet_repeat<rndcmp::detail::packet_size>(from); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pload<rndcmp::detail::packet_t<__VA_ARGS__>>(const __VA_ARGS__* from) { \
+        return rndcmp::detail::packet_load(from); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    ploadu<rndcmp::detail::packet_t<__VA_ARGS__>>(const __VA_ARGS__* from) { \
+        return rndcmp::detail::packet_load(from); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    ploaddup<rndcmp::detail::packet_t<__VA_ARGS__>>(const __VA_ARGS__* from) { \
+        return rndcmp::detail::packet_repeat<2>(from); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    ploadquad<rndcmp::detail::packet_t<__VA_ARGS__>>(const __VA_ARGS__* from) { \
+        return rndcmp::detail::packet_repeat<4>(from); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pgather<__VA_ARGS__, rndcmp::detail::packet_t<__VA_ARGS__>>(const __VA_ARGS__* from, Index stride) { \
+        return rndcmp::detail::packet_gather(from, stride); \
+    } \
+    template<> inline void \
+    pscatter<__VA_ARGS__, rndcmp::detail::packet_t<__VA_ARGS__>>(__VA_ARGS__* to, const rndcmp::detail::packet_t<__VA_ARGS__>& from, Index stride) { \
+        rndcmp::detail::packet_scatter(to, from, stride); \
+    } \
+    template<> inline void \
+    pstore<__VA_ARGS__, rndcmp::detail::packet_t<__VA_ARGS__>>(__VA_ARGS__* to, const rndcmp::detail::packet_t<__VA_ARGS__>& from) { \
+        rndcmp::detail::packet_store(to, from); \
+    } \
+    template<> inline void \
+    pstoreu<__VA_ARGS__, rndcmp::detail::packet_t<__VA_ARGS__>>(__VA_ARGS__* to, const rndcmp::detail::packet_t<__VA_ARGS__>& from) { \
+        rndcmp::detail::packet_store(to, from); \
+    } \
+    \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    padd<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a, const rndcmp::detail::packet_t<__VA_ARGS__>& b) { \
+        return rndcmp::detail::PacketArith<__VA_ARGS__>::add(a, b); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    psub<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a, const rndcmp::detail::packet_t<__VA_ARGS__>& b) { \
+        return rndcmp::detail::PacketArith<__VA_ARGS__>::sub(a, b); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pmul<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a, const rndcmp::detail::packet_t<__VA_ARGS__>& b) { \
+        return rndcmp::detail::PacketArith<__VA_ARGS__>::mul(a, b); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pdiv<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a, const rndcmp::detail::packet_t<__VA_ARGS__>& b) { \
+        return rndcmp::detail::PacketArith<__VA_ARGS__>::div(a, b); \
+    } \
+    /* a * b + c rounds twice, like the scalar expression */ \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pmadd<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a, const rndcmp::detail::packet_t<__VA_ARGS__>& b, \
+                                                  const rndcmp::detail::packet_t<__VA_ARGS__>& c) { \
+        return rndcmp::detail::PacketArith<__VA_ARGS__>::add(rndcmp::detail::PacketArith<__VA_ARGS__>::mul(a, b), c); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pnegate<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a) { \
+        return rndcmp::detail::PacketArith<__VA_ARGS__>::negate(a); \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    pconj<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a) { \
+        return a; \
+    } \
+    template<> inline rndcmp::detail::packet_t<__VA_ARGS__> \
+    preverse<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a) { \
+        return rndcmp::detail::packet_reverse<__VA_ARGS__>(a); \
+    } \
+    template<> inline __VA_ARGS__ \
+    pfirst<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a) { \
+        return rndcmp::detail::packet_lane<__VA_ARGS__>(a, 0); \
+    } \
+    template<> inline __VA_ARGS__ \
+    predux<rndcmp::detail::packet_t<__VA_ARGS__>>(const rndcmp::detail::packet_t<__VA_ARGS__>& a) { \
+        return rndcmp::detail::packet_sum<__VA_ARGS__>(a); \
+    } \
+    inline void ptranspose(PacketBlock<rndcmp::detail::packet_t<__VA_ARGS__>, 4>& block) { \
+        rndcmp::detail::packet_transpose<__VA_ARGS__, 4>(block); \
+    } \
+    inline void ptranspose(PacketBlock<rndcmp::detail::packet_t<__VA_ARGS__>, 8>& block) { \
+        rndcmp::detail::packet_transpose<__VA_ARGS__, 8>(block); \
+    } \
+} \
+}
+
+#endif  // RNDCMP_INCLUDE_PACKET_HPP_
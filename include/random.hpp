@@ -0,0 +1,638 @@
+#ifndef RNDCMP_INCLUDE_RANDOM_HPP_
+#define RNDCMP_INCLUDE_RANDOM_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+
+namespace rndcmp {
+
+    // Counter-based Philox4x32-10 generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+    // Every block of 128 random bits is a pure function of a (key, counter) pair, so the state is just
+    // 6 words and independent streams are obtained by fixing the upper half of the counter.
+    class Philox4x32 {
+    public:
+        using result_type = std::uint32_t;
+        using counter_type = std::array<std::uint32_t, 4>;
+        using key_type = std::array<std::uint32_t, 2>;
+
+        static constexpr int rounds = 10;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        Philox4x32(): Philox4x32(0) {}
+
+        // Counter words 0-1 enumerate blocks inside a stream, words 2-3 hold the stream id
+        explicit Philox4x32(std::uint64_t key, std::uint64_t stream = 0) {
+            seed(key, stream);
+        }
+
+        void seed(std::uint64_t key, std::uint64_t stream = 0) {
+            _key = {static_cast<std::uint32_t>(key), static_cast<std::uint32_t>(key >> 32)};
+            _counter = {0, 0, static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)};
+            _index = 4;
+        }
+
+        result_type operator()() {
+            if (_index == 4) {
+                _block = generate(_counter, _key);
+                increment();
+                _index = 0;
+            }
+            return _block[_index++];
+        }
+
+        // Returns the next full 128-bit block, dropping whatever is left of the current one
+        counter_type block() {
+            counter_type result = generate(_counter, _key);
+            increment();
+            _index = 4;
+            return result;
+        }
+
+        // Writes the next n words of the sequence. Whole blocks are generated straight into the output,
+        // which keeps the round function free of the per-word index check and lets it vectorize.
+        void fill(std::uint32_t* out, std::size_t n) {
+            while (n > 0 && _index != 4) {
+                *out++ = _block[_index++];
+                n--;
+            }
+            for (; n >= 4; n -= 4, out += 4) {
+                counter_type result = generate(_counter, _key);
+                increment();
+                std::copy(result.begin(), result.end(), out);
+            }
+            for (; n > 0; n--) {
+                *out++ = (*this)();
+            }
+        }
+
+        void discard(unsigned long long z) {
+            std::uint64_t available = 4 - _index;
+            if (z <= available) {
+                _index += static_cast<int>(z);
+                return;
+            }
+            z -= available;
+            std::uint64_t blocks = (z - 1) / 4;
+            advance(blocks);
+            _block = generate(_counter, _key);
+            increment();
+            _index = static_cast<int>(z - blocks * 4);
+        }
+
+        const counter_type& counter() const { return _counter; }
+
+        const key_type& key() const { return _key; }
+
+        static counter_type generate(counter_type ctr, key_type key) {
+            for (int r = 0; r < rounds; r++) {
+                if (r > 0) {
+                    key[0] += weyl0;
+                    key[1] += weyl1;
+                }
+                std::uint64_t p0 = static_cast<std::uint64_t>(mult0) * ctr[0];
+                std::uint64_t p1 = static_cast<std::uint64_t>(mult1) * ctr[2];
+                ctr = {
+                    static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                    static_cast<std::uint32_t>(p1),
+                    static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                    static_cast<std::uint32_t>(p0)
+                };
+            }
+            return ctr;
+        }
+
+        friend bool operator==(const Philox4x32& lhs, const Philox4x32& rhs) {
+            return lhs._key == rhs._key && lhs._counter == rhs._counter && lhs._index == rhs._index &&
+                   (lhs._index == 4 || lhs._block == rhs._block);
+        }
+
+        friend bool operator!=(const Philox4x32& lhs, const Philox4x32& rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        static constexpr std::uint32_t mult0 = 0xD2511F53;
+        static constexpr std::uint32_t mult1 = 0xCD9E8D57;
+        static constexpr std::uint32_t weyl0 = 0x9E3779B9;
+        static constexpr std::uint32_t weyl1 = 0xBB67AE85;
+
+        void increment() {
+            advance(1);
+        }
+
+        void advance(std::uint64_t blocks) {
+            std::uint64_t position = (static_cast<std::uint64_t>(_counter[1]) << 32) | _counter[0];
+            position += blocks;
+            _counter[0] = static_cast<std::uint32_t>(position);
+            _counter[1] = static_cast<std::uint32_t>(position >> 32);
+        }
+
+        key_type _key;
+        counter_type _counter;
+        counter_type _block;
+        int _index;
+    };
+
+    // SplitMix64 step, used to expand 64-bit seeds into larger generator states
+    inline std::uint64_t splitmix64(std::uint64_t& state) {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256+ (Blackman, Vigna). Low bits are weak, so stochastic rounding takes the upper ones.
+    class Xoshiro256Plus {
+    public:
+        using result_type = std::uint64_t;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        Xoshiro256Plus(): Xoshiro256Plus(0) {}
+
+        // Streams are decorrelated by hashing the stream id into the seed
+        explicit Xoshiro256Plus(std::uint64_t seed, std::uint64_t stream = 0) {
+            this->seed(seed, stream);
+        }
+
+        void seed(std::uint64_t seed, std::uint64_t stream = 0) {
+            std::uint64_t stream_state = stream;
+            std::uint64_t state = seed ^ splitmix64(stream_state);
+            for (auto& word : _s) {
+                word = splitmix64(state);
+            }
+        }
+
+        result_type operator()() {
+            std::uint64_t result = _s[0] + _s[3];
+            std::uint64_t t = _s[1] << 17;
+            _s[2] ^= _s[0];
+            _s[3] ^= _s[1];
+            _s[1] ^= _s[2];
+            _s[0] ^= _s[3];
+            _s[2] ^= t;
+            _s[3] = (_s[3] << 45) | (_s[3] >> 19);
+            return result;
+        }
+
+        void discard(unsigned long long z) {
+            for (unsigned long long i = 0; i < z; i++) {
+                (*this)();
+            }
+        }
+
+        friend bool operator==(const Xoshiro256Plus& lhs, const Xoshiro256Plus& rhs) { return lhs._s == rhs._s; }
+        friend bool operator!=(const Xoshiro256Plus& lhs, const Xoshiro256Plus& rhs) { return lhs._s != rhs._s; }
+
+    private:
+        std::array<std::uint64_t, 4> _s;
+    };
+
+    // PCG32 (O'Neill, XSH-RR output on a 64-bit LCG). The stream id selects the LCG increment.
+    class Pcg32 {
+    public:
+        using result_type = std::uint32_t;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        Pcg32(): Pcg32(0) {}
+
+        explicit Pcg32(std::uint64_t seed, std::uint64_t stream = 0) {
+            this->seed(seed, stream);
+        }
+
+        void seed(std::uint64_t seed, std::uint64_t stream = 0) {
+            _state = 0;
+            _inc = (stream << 1) | 1;
+            step();
+            _state += seed;
+            step();
+        }
+
+        result_type operator()() {
+            std::uint64_t old = _state;
+            step();
+            std::uint32_t xorshifted = static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27);
+            std::uint32_t rot = static_cast<std::uint32_t>(old >> 59);
+            return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+        }
+
+        void discard(unsigned long long z) {
+            for (unsigned long long i = 0; i < z; i++) {
+                step();
+            }
+        }
+
+        friend bool operator==(const Pcg32& lhs, const Pcg32& rhs) {
+            return lhs._state == rhs._state && lhs._inc == rhs._inc;
+        }
+        friend bool operator!=(const Pcg32& lhs, const Pcg32& rhs) { return !(lhs == rhs); }
+
+    private:
+        void step() {
+            _state = _state * 6364136223846793005ULL + _inc;
+        }
+
+        std::uint64_t _state;
+        std::uint64_t _inc;
+    };
+
+    /* Seeding */
+
+    // Every thread draws from its own generators. They are seeded from the process-wide master seed and
+    // the thread's stream id, so a run is reproducible as long as the master seed and the mapping of work
+    // to stream ids are fixed. Stream ids are handed out in the order threads first draw a number;
+    // worker threads that need a stable mapping should call set_thread_stream() themselves.
+    // An RngContext overrides both the seed and the stream of the calling thread for a scope.
+
+    namespace detail {
+        // Bumped by seed(); starts at 1 so that zero-initialized generator states are stale
+        inline std::atomic<std::uint64_t> seed_epoch{1};
+        inline std::atomic<std::uint64_t> next_stream{0};
+
+        inline std::atomic<std::uint64_t>& master_seed_value() {
+            static std::atomic<std::uint64_t> seed{
+                (static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}()
+            };
+            return seed;
+        }
+
+        // Kept trivially constructible so that accessing it does not need a thread_local init guard.
+        // Every change of the seed or stream gets a fresh epoch; leaving an RngContext brings the
+        // previous epoch back, which is how generators recognize the state they had before the scope.
+        struct ThreadStream {
+            std::uint64_t stream;
+            std::uint64_t epoch;
+            std::uint64_t last_epoch;
+            std::uint64_t seed;
+            int depth;
+            bool assigned;
+            bool seeded;
+        };
+
+        inline ThreadStream& thread_stream() {
+            thread_local ThreadStream stream{};
+            return stream;
+        }
+
+        inline std::uint64_t assigned_stream() {
+            ThreadStream& current = thread_stream();
+            if (!current.assigned) {
+                current.stream = next_stream.fetch_add(1, std::memory_order_relaxed);
+                current.assigned = true;
+            }
+            return current.stream;
+        }
+
+        inline std::uint64_t thread_seed() {
+            const ThreadStream& current = thread_stream();
+            return current.seeded ? current.seed : master_seed_value().load(std::memory_order_relaxed);
+        }
+
+        template<typename ENGINE>
+        ENGINE make_engine(std::uint64_t seed, std::uint64_t stream) {
+            if constexpr (std::is_constructible_v<ENGINE, std::uint64_t, std::uint64_t>) {
+                return ENGINE(seed, stream);
+            } else {
+                std::seed_seq sequence{
+                    static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                    static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)
+                };
+                return ENGINE(sequence);
+            }
+        }
+
+        // Bulk generation of 32-bit words. Engines may provide a faster fill() of their own.
+        template<typename ENGINE>
+        void fill_words(ENGINE& engine, std::uint32_t* out, std::size_t n) {
+            if constexpr (std::is_same_v<ENGINE, Philox4x32>) {
+                engine.fill(out, n);
+            } else if constexpr (ENGINE::max() > std::numeric_limits<std::uint32_t>::max()) {
+                for (std::size_t i = 0; i < n; i++) {
+                    out[i] = static_cast<std::uint32_t>(engine() >> 32);
+                }
+            } else {
+                for (std::size_t i = 0; i < n; i++) {
+                    out[i] = static_cast<std::uint32_t>(engine());
+                }
+            }
+        }
+    }
+
+    // Sets the master seed. Generators of every thread are reseeded before their next draw.
+    // Running the same single-threaded code after seed(s) again gives bit-identical results. With several
+    // threads seed() alone is not enough: a thread that has no stream of its own gets the next free stream id
+    // at its first draw, so the ids depend on which thread draws first. Threads whose results have to be
+    // reproducible must fix their stream with set_thread_stream() or an RngContext.
+    inline void seed(std::uint64_t master_seed) {
+        detail::master_seed_value().store(master_seed, std::memory_order_relaxed);
+        detail::seed_epoch.fetch_add(1, std::memory_order_release);
+    }
+
+    inline std::uint64_t master_seed() {
+        return detail::master_seed_value().load(std::memory_order_relaxed);
+    }
+
+    // Binds the calling thread to the given stream and reseeds its generators
+    inline void set_thread_stream(std::uint64_t stream) {
+        detail::ThreadStream& current = detail::thread_stream();
+        current.stream = stream;
+        current.assigned = true;
+        current.epoch = ++current.last_epoch;
+    }
+
+    inline std::uint64_t thread_stream() {
+        return detail::assigned_stream();
+    }
+
+    // Seed the calling thread currently draws with: the one of the innermost RngContext or the master seed
+    inline std::uint64_t thread_seed() {
+        return detail::thread_seed();
+    }
+
+    // Fixes the seed and stream of the calling thread for the lifetime of the object. Generators start
+    // over from (seed, stream) inside the scope and continue where they stopped once it is left, so a
+    // trajectory can be replayed on its own without disturbing the draws around it:
+    //
+    //     for (size_t i = 0; i < trajectories; i++) {
+    //         rndcmp::RngContext context(seed, i);
+    //         run(i);
+    //     }
+    //
+    // seed() does not affect the generators while a context is active. Contexts nest.
+    class RngContext {
+    public:
+        RngContext(std::uint64_t seed, std::uint64_t stream = 0): _saved(detail::thread_stream()) {
+            detail::ThreadStream& current = detail::thread_stream();
+            current.seed = seed;
+            current.seeded = true;
+            current.stream = stream;
+            current.assigned = true;
+            current.depth++;
+            current.epoch = ++current.last_epoch;
+        }
+
+        ~RngContext() {
+            detail::ThreadStream& current = detail::thread_stream();
+            std::uint64_t last_epoch = current.last_epoch;
+            current = _saved;
+            current.last_epoch = last_epoch;
+        }
+
+        RngContext(const RngContext&) = delete;
+        RngContext& operator=(const RngContext&) = delete;
+
+        std::uint64_t seed() const { return detail::thread_stream().seed; }
+
+        std::uint64_t stream() const { return detail::thread_stream().stream; }
+
+    private:
+        detail::ThreadStream _saved;
+    };
+
+    /* RNG policies */
+
+    // An RNG policy is the last template parameter of every stochastic rounding type. It has to provide
+    // bits<N>() returning N uniformly distributed random bits (N <= 32) and uniform() returning a double
+    // in [0, 1). Everything is static, so the rounding code inlines the generator call.
+
+    // Policy backed by a per-thread engine. Engine output is generated in bulk into a pool of 32-bit words,
+    // and every call consumes exactly the requested number of bits from it: FloatSR uses 29 bits per
+    // rounding, bfloat16sr 16 and halfsr 13, so one word covers more than one rounding on average.
+    template<typename ENGINE>
+    struct EngineRng {
+        using engine_type = ENGINE;
+
+        static constexpr bool is_stochastic = true;
+        static constexpr std::size_t pool_words = 512;
+
+        static_assert(ENGINE::min() == 0, "engine must produce full-width words");
+        static_assert(ENGINE::max() == std::numeric_limits<std::uint32_t>::max() ||
+                      ENGINE::max() == std::numeric_limits<std::uint64_t>::max(), "engine must produce 32 or 64 bit words");
+        static_assert(std::is_trivially_copyable_v<ENGINE>, "engine is kept in raw thread_local storage");
+
+        template<int BITS>
+        static std::uint32_t bits() {
+            static_assert(BITS > 0 && BITS <= 32, "policy produces at most 32 bits per call");
+            return state().template take<BITS>();
+        }
+
+        static double uniform() {
+            State& current = state();
+            std::uint64_t high = current.template take<32>();
+            std::uint64_t low = current.template take<21>();
+            return static_cast<double>((high << 21) | low) * 0x1.0p-53;
+        }
+
+        // Raw pool words, for kernels that round whole arrays at once
+        static void words(std::uint32_t* out, std::size_t n) {
+            state().take_words(out, n);
+        }
+
+        // Position of the calling thread in its stream: the engine, the pool and the bits left over.
+        // Restoring it continues the sequence bit for bit, also in another process; see checkpoint.hpp.
+        struct Snapshot {
+            unsigned char engine[sizeof(ENGINE)];
+            std::uint32_t pool[pool_words];
+            std::uint64_t position;
+            std::uint64_t reservoir;
+            std::int64_t available;
+        };
+
+        static Snapshot save() {
+            State& current = state();
+            Snapshot result{};
+            std::copy(current.engine_storage, current.engine_storage + sizeof(ENGINE), result.engine);
+            std::copy(current.pool, current.pool + pool_words, result.pool);
+            result.position = current.position;
+            result.reservoir = current.reservoir;
+            result.available = current.available;
+            return result;
+        }
+
+        // The position replaces the one of the current seed and stream; a later change of either reseeds as usual
+        static void restore(const Snapshot& snapshot) {
+            State& current = state();
+            std::copy(snapshot.engine, snapshot.engine + sizeof(ENGINE), current.engine_storage);
+            std::copy(snapshot.pool, snapshot.pool + pool_words, current.pool);
+            current.position = static_cast<std::size_t>(snapshot.position);
+            current.reservoir = snapshot.reservoir;
+            current.available = static_cast<int>(snapshot.available);
+        }
+
+    private:
+        struct State {
+            alignas(ENGINE) unsigned char engine_storage[sizeof(ENGINE)];
+            std::uint32_t pool[pool_words];
+            std::size_t position;
+            std::uint64_t reservoir;
+            int available;
+            std::uint64_t global_epoch;
+            std::uint64_t thread_epoch;
+            int depth;
+
+            ENGINE& engine() {
+                return *reinterpret_cast<ENGINE*>(engine_storage);
+            }
+
+            void reseed(std::uint64_t global, const detail::ThreadStream& stream) {
+                new (engine_storage) ENGINE(detail::make_engine<ENGINE>(detail::thread_seed(), detail::assigned_stream()));
+                position = pool_words;
+                reservoir = 0;
+                available = 0;
+                global_epoch = global;
+                thread_epoch = stream.epoch;
+                depth = stream.depth;
+            }
+
+            void refill() {
+                detail::fill_words(engine(), pool, pool_words);
+                position = 0;
+            }
+
+            std::uint32_t next_word() {
+                if (position == pool_words) {
+                    refill();
+                }
+                return pool[position++];
+            }
+
+            template<int BITS>
+            std::uint32_t take() {
+                if (available < BITS) {
+                    reservoir |= static_cast<std::uint64_t>(next_word()) << available;
+                    available += 32;
+                }
+                std::uint32_t result = static_cast<std::uint32_t>(reservoir & ((std::uint64_t(1) << BITS) - 1));
+                reservoir >>= BITS;
+                available -= BITS;
+                return result;
+            }
+
+            void take_words(std::uint32_t* out, std::size_t n) {
+                while (n > 0) {
+                    if (position == pool_words) {
+                        refill();
+                    }
+                    std::size_t chunk = std::min(n, pool_words - position);
+                    std::copy(pool + position, pool + position + chunk, out);
+                    position += chunk;
+                    out += chunk;
+                    n -= chunk;
+                }
+            }
+        };
+
+        static State& state() {
+            thread_local State current{};
+            const detail::ThreadStream& stream = detail::thread_stream();
+            // Inside an RngContext the master seed is not used, so seed() must not restart the scope
+            std::uint64_t global = stream.seeded ? 0 : detail::seed_epoch.load(std::memory_order_acquire);
+            if (current.global_epoch != global || current.thread_epoch != stream.epoch) {
+                synchronize(current, global, stream);
+            }
+            return current;
+        }
+
+        // Slow path: the seed or stream of the thread changed since the last draw. Entering an RngContext
+        // stashes the current state, leaving it takes the stashed one back if it is still valid.
+        static void synchronize(State& current, std::uint64_t global, const detail::ThreadStream& stream) {
+            thread_local std::vector<State> stashed;
+            if (stream.depth > current.depth) {
+                stashed.push_back(current);
+            } else if (stream.depth < current.depth) {
+                while (!stashed.empty() && stashed.back().depth > stream.depth) {
+                    stashed.pop_back();
+                }
+                if (!stashed.empty() && stashed.back().depth == stream.depth) {
+                    State outer = stashed.back();
+                    stashed.pop_back();
+                    if (outer.global_epoch == global && outer.thread_epoch == stream.epoch) {
+                        current = outer;
+                        return;
+                    }
+                }
+            }
+            current.reseed(global, stream);
+        }
+    };
+
+    // Deterministic policy: the threshold is always half an ulp, so rounding degenerates to
+    // round-to-nearest (ties towards zero). Handy for regression runs and as a baseline.
+    struct NearestRng {
+        static constexpr bool is_stochastic = false;
+
+        template<int BITS>
+        static constexpr std::uint32_t bits() {
+            static_assert(BITS > 0 && BITS <= 32, "policy produces at most 32 bits per call");
+            return std::uint32_t(1) << (BITS - 1);
+        }
+
+        static constexpr double uniform() {
+            return 0.5;
+        }
+
+        // Thresholds for 32-bit comparisons, see EngineRng::words
+        static void words(std::uint32_t* out, std::size_t n) {
+            std::fill(out, out + n, std::uint32_t(1) << 31);
+        }
+    };
+
+    using Mt19937Rng = EngineRng<std::mt19937>;
+    using Xoshiro256PlusRng = EngineRng<Xoshiro256Plus>;
+    using Pcg32Rng = EngineRng<Pcg32>;
+    using PhiloxRng = EngineRng<Philox4x32>;
+
+    // Policy used when none is given. Configure with -DRNDCMP_PHILOX_RNG=ON
+    // to replace Mersenne Twister with the counter-based generator.
+#if defined(RNDCMP_PHILOX_RNG)
+    using DefaultRng = PhiloxRng;
+#else
+    using DefaultRng = Mt19937Rng;
+#endif
+
+    namespace detail {
+        // RNG policy a number type rounds with, void for the deterministic types
+        template<typename T, typename = void>
+        struct rng_policy {
+            using type = void;
+        };
+
+        template<typename T>
+        struct rng_policy<T, std::void_t<typename T::rng_type>> {
+            using type = typename T::rng_type;
+        };
+
+        // Seed for the streams of worker threads, drawn from the stream of the calling thread that T rounds with.
+        // Types that do not round stochastically draw nothing.
+        template<typename T>
+        std::uint64_t worker_seed() {
+            using RNG = typename rng_policy<T>::type;
+            if constexpr (std::is_void_v<RNG>) {
+                return thread_seed();
+            } else if constexpr (!RNG::is_stochastic) {
+                return thread_seed();
+            } else {
+                // Separate statements, the high word is always drawn first
+                std::uint64_t high = RNG::template bits<32>();
+                std::uint64_t low = RNG::template bits<32>();
+                return (high << 32) | low;
+            }
+        }
+    }
+}
+
+#endif  // RNDCMP_INCLUDE_RANDOM_HPP_
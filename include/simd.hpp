@@ -0,0 +1,72 @@
+#ifndef RNDCMP_INCLUDE_SIMD_HPP_
+#define RNDCMP_INCLUDE_SIMD_HPP_
+
+#include <atomic>
+
+// Array kernels of the SR types are compiled for several x86 instruction sets at once and the widest one
+// supported by the CPU is picked at runtime, so binaries built without -march flags still use AVX2/AVX-512.
+// Other compilers and architectures get the scalar kernels only.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define RNDCMP_X86_DISPATCH 1
+    #define RNDCMP_TARGET(isa) __attribute__((target(isa)))
+    #include <immintrin.h>
+#else
+    #define RNDCMP_X86_DISPATCH 0
+    #define RNDCMP_TARGET(isa)
+#endif
+
+
+namespace rndcmp {
+namespace simd {
+
+    // Ordered by width: a CPU supporting an ISA supports every ISA before it
+    enum class Isa {
+        Scalar = 0,
+        Avx2 = 1,
+        Avx512 = 2
+    };
+
+    namespace detail {
+        inline Isa detect_isa() {
+#if RNDCMP_X86_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                __builtin_cpu_supports("avx512vl")) {
+                return Isa::Avx512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c") && __builtin_cpu_supports("fma")) {
+                return Isa::Avx2;
+            }
+#endif
+            return Isa::Scalar;
+        }
+
+        inline std::atomic<Isa>& isa_limit() {
+            static std::atomic<Isa> limit{Isa::Avx512};
+            return limit;
+        }
+    }
+
+    // Widest ISA of the running CPU
+    inline Isa cpu_isa() {
+        static const Isa isa = detail::detect_isa();
+        return isa;
+    }
+
+    // Caps the ISA used by array kernels, e.g. to compare against the scalar path
+    inline void set_max_isa(Isa isa) {
+        detail::isa_limit().store(isa, std::memory_order_relaxed);
+    }
+
+    // ISA the array kernels dispatch to
+    inline Isa active_isa() {
+        Isa limit = detail::isa_limit().load(std::memory_order_relaxed);
+        return cpu_isa() < limit ? cpu_isa() : limit;
+    }
+
+    // Number of elements kernels process between two refills of their random words
+    constexpr int block_size = 256;
+}
+}
+
+#endif  // RNDCMP_INCLUDE_SIMD_HPP_
@@ -0,0 +1,296 @@
+#ifndef RNDCMP_INCLUDE_SINKS_HPP_
+#define RNDCMP_INCLUDE_SINKS_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+#include <Eigen/Core>
+
+
+// Sinks take the points of a trajectory from IntegratorBase::solve(sink) one by one.
+// A sink is any callable sink(double t, const STATE& x); the state is only valid during the call. The sinks
+// here take any state with size(), operator[] and iterators: std::vector, std::array, fixed-size Eigen vectors.
+namespace rndcmp {
+
+    // Passes the initial point and then every Nth point to another sink
+    template<typename SINK>
+    class DecimatingSink {
+    public:
+        DecimatingSink(SINK& sink, size_t every): _sink(sink), _every(every > 0 ? every : 1) {}
+
+        template<typename STATE>
+        void operator()(double t, const STATE& x) {
+            if (_count++ % _every == 0) {
+                _sink(t, x);
+            }
+        }
+
+    private:
+        SINK& _sink;
+        size_t _every;
+        size_t _count = 0;
+    };
+
+    // Points stored in one contiguous block, viewed as a points x dimension Eigen matrix without copying.
+    // LAYOUT is Eigen::RowMajor (a point after a point) or Eigen::ColMajor (structure of arrays: a component
+    // after a component, with room for capacity() points each).
+    template<typename T, int LAYOUT = Eigen::RowMajor>
+    class Trajectory {
+    public:
+        using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, LAYOUT>;
+        using MatrixView = Eigen::Map<Matrix, 0, Eigen::OuterStride<>>;
+        using ConstMatrixView = Eigen::Map<const Matrix, 0, Eigen::OuterStride<>>;
+        using ConstStridedView = Eigen::Map<const Matrix, 0, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
+
+        Trajectory() = default;
+
+        // Reserves the memory for the expected number of points
+        Trajectory(size_t points, size_t dimension): _dimension(dimension) {
+            _times.reserve(points);
+            reserve(points);
+        }
+
+        // Not a candidate for the element access operator()(row, col)
+        template<typename STATE, typename = std::enable_if_t<!std::is_arithmetic_v<STATE>>>
+        void operator()(double t, const STATE& x) {
+            if (_times.empty() && static_cast<size_t>(x.size()) != _dimension) {
+                _dimension = static_cast<size_t>(x.size());
+                _data.clear();
+                _capacity = 0;
+            }
+            size_t row = _times.size();
+            if constexpr (LAYOUT == Eigen::RowMajor) {
+                _data.insert(_data.end(), x.begin(), x.end());
+            } else {
+                if (row == _capacity) {
+                    reserve(std::max<size_t>(2 * _capacity, 64));
+                }
+                for (size_t j = 0; j < _dimension; j++) {
+                    _data[j * _capacity + row] = x[j];
+                }
+            }
+            _times.push_back(t);
+        }
+
+        size_t rows() const {
+            return _times.size();
+        }
+
+        size_t dimension() const {
+            return _dimension;
+        }
+
+        // Points that fit without moving the data
+        size_t capacity() const {
+            return LAYOUT == Eigen::RowMajor ? (_dimension ? _data.capacity() / _dimension : 0) : _capacity;
+        }
+
+        const T& operator()(size_t row, size_t col) const {
+            return _data[index(row, col)];
+        }
+
+        const T* data() const {
+            return _data.data();
+        }
+
+        const std::vector<double>& times() const {
+            return _times;
+        }
+
+        MatrixView matrix() {
+            return MatrixView(_data.data(), rows(), _dimension, Eigen::OuterStride<>(outerStride()));
+        }
+
+        ConstMatrixView matrix() const {
+            return ConstMatrixView(_data.data(), rows(), _dimension, Eigen::OuterStride<>(outerStride()));
+        }
+
+        // Every nth point, starting from the first one; every = 0 is taken as 1
+        ConstStridedView matrix(size_t every) const {
+            every = every > 0 ? every : 1;
+            size_t points = (rows() + every - 1) / every;
+            if constexpr (LAYOUT == Eigen::RowMajor) {
+                return ConstStridedView(_data.data(), points, _dimension, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(every * _dimension, 1));
+            } else {
+                return ConstStridedView(_data.data(), points, _dimension, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(_capacity, every));
+            }
+        }
+
+        void clear() {
+            _times.clear();
+            if constexpr (LAYOUT == Eigen::RowMajor) {
+                _data.clear();
+            }
+        }
+
+    private:
+        size_t index(size_t row, size_t col) const {
+            return LAYOUT == Eigen::RowMajor ? row * _dimension + col : col * _capacity + row;
+        }
+
+        size_t outerStride() const {
+            return LAYOUT == Eigen::RowMajor ? _dimension : _capacity;
+        }
+
+        void reserve(size_t points) {
+            if constexpr (LAYOUT == Eigen::RowMajor) {
+                _data.reserve(points * _dimension);
+            } else if (points > _capacity) {
+                // The columns move apart, the stored points are copied once per growth
+                std::vector<T> data(points * _dimension);
+                for (size_t j = 0; j < _dimension; j++) {
+                    std::copy(_data.begin() + j * _capacity, _data.begin() + j * _capacity + rows(), data.begin() + j * points);
+                }
+                _data.swap(data);
+                _capacity = points;
+            }
+        }
+
+        std::vector<double> _times;
+        std::vector<T> _data;
+        size_t _dimension = 0;
+        size_t _capacity = 0;
+    };
+
+    // Points stored row by row in one contiguous buffer
+    template<typename T>
+    using FlatSink = Trajectory<T, Eigen::RowMajor>;
+
+    // Writes every point as a record of doubles: t, x[0], ..., x[n-1], in the byte order of the machine.
+    // The values of the float types and of Fixed/FixedSR up to 32-bit storage are exact in double; with 64-bit
+    // storage a value with more than 53 significant bits is rounded to the nearest double.
+    class BinaryFileSink {
+    public:
+        BinaryFileSink(const std::string& path): _file(path, std::ios::binary | std::ios::trunc) {
+            if (!_file) {
+                throw std::runtime_error("cannot open " + path);
+            }
+        }
+
+        // Continues the file of an interrupted run: keeps its first records of dimension values each and
+        // appends after them, e.g. with the number of points returned by CheckpointedRun::resumeFrom()
+        BinaryFileSink(const std::string& path, size_t records, size_t dimension): _records(records) {
+            std::uintmax_t size = records * (dimension + 1) * sizeof(double);
+            std::error_code error;
+            std::uintmax_t existing = std::filesystem::file_size(path, error);
+            if (error || existing < size) {
+                throw std::runtime_error(path + " has less than " + std::to_string(records) + " records");
+            }
+            std::filesystem::resize_file(path, size, error);
+            _file.open(path, std::ios::binary | std::ios::app);
+            if (error || !_file) {
+                throw std::runtime_error("cannot open " + path);
+            }
+        }
+
+        template<typename STATE>
+        void operator()(double t, const STATE& x) {
+            _record.resize(x.size() + 1);
+            _record[0] = t;
+            for (size_t i = 0; i < x.size(); i++) {
+                _record[i + 1] = static_cast<double>(x[i]);
+            }
+            _file.write(reinterpret_cast<const char*>(_record.data()), _record.size() * sizeof(double));
+            _records++;
+        }
+
+        size_t records() const {
+            return _records;
+        }
+
+        void flush() {
+            _file.flush();
+        }
+
+    private:
+        std::ofstream _file;
+        std::vector<double> _record;
+        size_t _records = 0;
+    };
+
+    // Mean, variance, minimum and maximum of every component over the points, in double (Welford's algorithm)
+    class StatisticsSink {
+    public:
+        template<typename STATE>
+        void operator()(double, const STATE& x) {
+            if (_count == 0) {
+                _mean.assign(x.size(), 0.0);
+                _m2.assign(x.size(), 0.0);
+                _min.assign(x.size(), std::numeric_limits<double>::infinity());
+                _max.assign(x.size(), -std::numeric_limits<double>::infinity());
+            }
+            _count++;
+            for (size_t i = 0; i < x.size(); i++) {
+                double value = static_cast<double>(x[i]);
+                double delta = value - _mean[i];
+                _mean[i] += delta / _count;
+                _m2[i] += delta * (value - _mean[i]);
+                _min[i] = std::min(_min[i], value);
+                _max[i] = std::max(_max[i], value);
+            }
+        }
+
+        // Adds the points of another sink (Chan et al. pairwise update)
+        void merge(const StatisticsSink& other) {
+            if (other._count == 0) {
+                return;
+            }
+            if (_count == 0) {
+                *this = other;
+                return;
+            }
+            double total = static_cast<double>(_count + other._count);
+            for (size_t i = 0; i < _mean.size(); i++) {
+                double delta = other._mean[i] - _mean[i];
+                _mean[i] += delta * other._count / total;
+                _m2[i] += other._m2[i] + delta * delta * (static_cast<double>(_count) * other._count / total);
+                _min[i] = std::min(_min[i], other._min[i]);
+                _max[i] = std::max(_max[i], other._max[i]);
+            }
+            _count += other._count;
+        }
+
+        size_t count() const {
+            return _count;
+        }
+
+        const std::vector<double>& mean() const {
+            return _mean;
+        }
+
+        // Sample variance
+        std::vector<double> variance() const {
+            std::vector<double> result(_m2.size(), 0.0);
+            if (_count > 1) {
+                for (size_t i = 0; i < _m2.size(); i++) {
+                    result[i] = _m2[i] / (_count - 1);
+                }
+            }
+            return result;
+        }
+
+        const std::vector<double>& min() const {
+            return _min;
+        }
+
+        const std::vector<double>& max() const {
+            return _max;
+        }
+
+    private:
+        size_t _count = 0;
+        std::vector<double> _mean;
+        std::vector<double> _m2;
+        std::vector<double> _min;
+        std::vector<double> _max;
+    };
+}
+
+#endif  // RNDCMP_INCLUDE_SINKS_HPP_
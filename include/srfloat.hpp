@@ -0,0 +1,738 @@
+#ifndef RNDCMP_INCLUDE_SRFLOAT_HPP_
+#define RNDCMP_INCLUDE_SRFLOAT_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <Eigen/Core>
+
+#include "random.hpp"
+#include "simd.hpp"
+#include "packet.hpp"
+
+
+namespace rndcmp {
+
+    // Meaning of the top exponent
+    enum class FloatSpecials {
+        Ieee,       // infinities and NaNs, like IEEE 754
+        FiniteNan   // normal numbers except the all-ones pattern, which is NaN; no infinities (OCP FP8 E4M3)
+    };
+
+    namespace detail {
+        constexpr double pow2(int n) {
+            return n >= 0 ? double(std::uint64_t(1) << n) : 1.0 / double(std::uint64_t(1) << -n);
+        }
+
+        constexpr double pow2_wide(int n) {
+            return n > 62 ? pow2(62) * pow2_wide(n - 62) : (n < -62 ? pow2(-62) * pow2_wide(n + 62) : pow2(n));
+        }
+
+        // Binary floating-point format with EXP_BITS exponent bits and MANT_BITS stored mantissa bits, laid out
+        // like IEEE 754: sign, biased exponent, mantissa, zero exponent for subnormals.
+        // Every format fits in float, so values decode to float exactly and arithmetic in double is exact
+        // for sums and products up to the resolution of the random threshold.
+        template<int EXP_BITS, int MANT_BITS, FloatSpecials SPECIALS = FloatSpecials::Ieee>
+        struct SRFormat {
+            static_assert(EXP_BITS >= 2 && EXP_BITS <= 8, "exponent must fit the float range");
+            static_assert(MANT_BITS >= 1 && MANT_BITS <= 23, "mantissa must fit float");
+            static_assert(SPECIALS == FloatSpecials::Ieee || EXP_BITS < 8, "the top exponent of float is reserved");
+
+            static constexpr int exp_bits = EXP_BITS;
+            static constexpr int mant_bits = MANT_BITS;
+            static constexpr bool ieee = SPECIALS == FloatSpecials::Ieee;
+
+            static constexpr int bits = 1 + EXP_BITS + MANT_BITS;
+            using code_t = std::conditional_t<(bits <= 8), std::uint8_t,
+                           std::conditional_t<(bits <= 16), std::uint16_t, std::uint32_t>>;
+
+            static constexpr int bias = (1 << (EXP_BITS - 1)) - 1;
+            // Exponents of the smallest and the largest normal numbers
+            static constexpr int min_exponent = 1 - bias;
+            static constexpr int max_exponent = ieee ? bias : bias + 1;
+
+            static constexpr std::uint32_t sign_mask = std::uint32_t(1) << (EXP_BITS + MANT_BITS);
+            static constexpr std::uint32_t mant_mask = (std::uint32_t(1) << MANT_BITS) - 1;
+            static constexpr std::uint32_t exp_mask = ((std::uint32_t(1) << EXP_BITS) - 1) << MANT_BITS;
+            static constexpr std::uint32_t quiet_nan = ieee ? exp_mask | (std::uint32_t(1) << (MANT_BITS - 1)) : exp_mask | mant_mask;
+            static constexpr std::uint32_t max_finite = ieee ? exp_mask - 1 : quiet_nan - 1;
+            // Infinite sources saturate when the format has no infinity
+            static constexpr std::uint32_t infinity = ieee ? exp_mask : max_finite;
+
+            // Mantissa bits of a double below the format, and how many of them the random threshold resolves
+            static constexpr int cut_bits = 52 - MANT_BITS;
+            static constexpr int threshold_bits = cut_bits < 32 ? cut_bits : 32;
+
+            // With the exponent of float the format is a prefix of the float bit pattern, subnormals included:
+            // float sources are rounded and values decoded with shifts only
+            static constexpr bool float_prefix = EXP_BITS == 8;
+            static constexpr int float_cut_bits = 23 - MANT_BITS;
+
+            // Value of the last mantissa bit of subnormals
+            static constexpr double subnormal_ulp = pow2_wide(min_exponent - MANT_BITS);
+        };
+
+        template<typename F>
+        constexpr bool srfloat_is_nan(std::uint32_t code) {
+            std::uint32_t magnitude = code & ~F::sign_mask;
+            return F::ieee ? magnitude > F::exp_mask : magnitude == F::quiet_nan;
+        }
+
+        // Value of a code, computed without bit casts so that it can fill constexpr tables
+        template<typename F>
+        constexpr float srfloat_value(std::uint32_t code) {
+            std::uint32_t exponent = (code & F::exp_mask) >> F::mant_bits;
+            std::uint32_t mantissa = code & F::mant_mask;
+            float magnitude = 0.0f;
+            if (srfloat_is_nan<F>(code)) {
+                return std::numeric_limits<float>::quiet_NaN();
+            } else if (F::ieee && exponent == (F::exp_mask >> F::mant_bits)) {
+                magnitude = std::numeric_limits<float>::infinity();
+            } else if (exponent == 0) {
+                magnitude = static_cast<float>(mantissa * F::subnormal_ulp);
+            } else {
+                magnitude = static_cast<float>((mantissa + F::mant_mask + 1) * pow2_wide(int(exponent) - F::bias - F::mant_bits));
+            }
+            return (code & F::sign_mask) ? -magnitude : magnitude;
+        }
+
+        // All values of a format with at most 8 bits
+        template<typename F>
+        constexpr std::array<float, 256> srfloat_table() {
+            std::array<float, 256> values{};
+            for (std::uint32_t code = 0; code < 256; code++) {
+                values[code] = srfloat_value<F>(code);
+            }
+            return values;
+        }
+
+        template<typename F>
+        struct SRDecodeTable {
+            static constexpr std::array<float, 256> values = srfloat_table<F>();
+        };
+
+        // Rounds x to the format, up if the threshold_bits-wide random value p is below the cut bits.
+        // Finite values beyond the range saturate to the largest finite number, like FloatSR.
+        template<typename F>
+        typename F::code_t srfloat_encode(double x, std::uint64_t p) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            std::uint32_t sign = (bits >> 63) ? F::sign_mask : 0;
+            std::uint64_t abs_bits = bits & ~(std::uint64_t(1) << 63);
+            constexpr std::uint64_t double_infinity = std::uint64_t(0x7ff) << 52;
+            if (abs_bits >= double_infinity) {
+                return sign | (abs_bits == double_infinity ? F::infinity : F::quiet_nan);
+            }
+
+            int exponent = static_cast<int>(abs_bits >> 52) - 1023;
+            // Bits of the significand below the format: cut_bits for normal numbers, more for subnormals
+            int shift = F::cut_bits + std::max(F::min_exponent - exponent, 0);
+            std::uint32_t code;
+            if (exponent > F::max_exponent) {
+                return sign | F::max_finite;
+            } else if (shift < 64) {
+                std::uint64_t significand = abs_bits & ((std::uint64_t(1) << 52) - 1);
+                if (exponent < F::min_exponent) {
+                    significand |= std::uint64_t(1) << 52;
+                }
+                code = static_cast<std::uint32_t>(significand >> shift);
+                if (exponent >= F::min_exponent) {
+                    code |= static_cast<std::uint32_t>(exponent + F::bias) << F::mant_bits;
+                }
+                std::uint64_t dropped = significand & ((std::uint64_t(1) << shift) - 1);
+                if (p < (dropped >> (shift - F::threshold_bits))) {
+                    code += 1;
+                }
+            } else {
+                // Far below the smallest subnormal: the fraction of it is the rounding probability
+                double fraction = std::fabs(x) / F::subnormal_ulp;
+                code = p < static_cast<std::uint64_t>(fraction * pow2(F::threshold_bits)) ? 1 : 0;
+            }
+            return static_cast<typename F::code_t>(sign | std::min(code, F::max_finite));
+        }
+
+        // Same for a float source when the format is a prefix of float, p has float_cut_bits bits
+        template<typename F>
+        typename F::code_t srfloat_encode_float(float x, std::uint32_t p) {
+            static_assert(F::float_prefix, "the format must be a prefix of float");
+            std::uint32_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            std::uint32_t sign = (bits >> 31) ? F::sign_mask : 0;
+            std::uint32_t abs_bits = bits & 0x7fffffff;
+            if (abs_bits >= 0x7f800000) {
+                return sign | (abs_bits == 0x7f800000 ? F::infinity : F::quiet_nan);
+            }
+            std::uint32_t code = abs_bits >> F::float_cut_bits;
+            if (p < (abs_bits & ((std::uint32_t(1) << F::float_cut_bits) - 1))) {
+                code += 1;
+            }
+            return static_cast<typename F::code_t>(sign | std::min(code, F::max_finite));
+        }
+
+        template<typename F>
+        float srfloat_decode(std::uint32_t code) {
+            if constexpr (F::bits <= 8) {
+                return SRDecodeTable<F>::values[code];
+            } else if constexpr (F::float_prefix) {
+                std::uint32_t bits = code << F::float_cut_bits;
+                float result;
+                std::memcpy(&result, &bits, sizeof(result));
+                return result;
+            } else {
+                std::uint32_t exponent = (code & F::exp_mask) >> F::mant_bits;
+                if (exponent == 0 || exponent == (F::exp_mask >> F::mant_bits)) {
+                    return srfloat_value<F>(code);
+                }
+                std::uint32_t sign = (code & F::sign_mask) ? 0x80000000 : 0;
+                std::uint32_t bits = sign | ((exponent - F::bias + 127) << 23) | ((code & F::mant_mask) << F::float_cut_bits);
+                float result;
+                std::memcpy(&result, &bits, sizeof(result));
+                return result;
+            }
+        }
+    }
+
+    // Stochastically rounded float of any format up to fp32 with EXP_BITS exponent and MANT_BITS mantissa bits.
+    // Operations are computed in double and rounded once, masks and limits are derived from the format.
+    // SRFloat<8, 7> rounds like bfloat16sr and SRFloat<5, 10> like halfsr.
+    template<int EXP_BITS, int MANT_BITS, typename RNG = DefaultRng, FloatSpecials SPECIALS = FloatSpecials::Ieee>
+    class SRFloat {
+    public:
+        using format = detail::SRFormat<EXP_BITS, MANT_BITS, SPECIALS>;
+        using code_t = typename format::code_t;
+        using rng_type = RNG;
+
+        SRFloat() = default;
+
+        template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+        SRFloat(T v) {
+            round(v);
+        }
+
+        template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+        SRFloat(T v) {
+            round(static_cast<double>(v));
+        }
+
+        static SRFloat fromRaw(code_t raw) {
+            SRFloat result;
+            result.value = raw;
+            return result;
+        }
+
+        code_t raw() const {
+            return value;
+        }
+
+        template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+        operator T() const {
+            return static_cast<T>(detail::srfloat_decode<format>(value));
+        }
+
+        template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+        operator T() const {
+            return static_cast<T>(detail::srfloat_decode<format>(value));
+        }
+
+        /* arithmetic operators */
+
+        SRFloat operator+(const SRFloat& rhs) const { return SRFloat(wide() + rhs.wide()); }
+        SRFloat operator-(const SRFloat& rhs) const { return SRFloat(wide() - rhs.wide()); }
+        SRFloat operator*(const SRFloat& rhs) const { return SRFloat(wide() * rhs.wide()); }
+        SRFloat operator/(const SRFloat& rhs) const { return SRFloat(wide() / rhs.wide()); }
+
+        SRFloat& operator+=(const SRFloat& rhs) { round(wide() + rhs.wide()); return *this; }
+        SRFloat& operator-=(const SRFloat& rhs) { round(wide() - rhs.wide()); return *this; }
+        SRFloat& operator*=(const SRFloat& rhs) { round(wide() * rhs.wide()); return *this; }
+        SRFloat& operator/=(const SRFloat& rhs) { round(wide() / rhs.wide()); return *this; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat operator+(const T& rhs) const { return SRFloat(wide() + static_cast<double>(rhs)); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat operator-(const T& rhs) const { return SRFloat(wide() - static_cast<double>(rhs)); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat operator*(const T& rhs) const { return SRFloat(wide() * static_cast<double>(rhs)); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat operator/(const T& rhs) const { return SRFloat(wide() / static_cast<double>(rhs)); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat& operator+=(const T& rhs) { round(wide() + static_cast<double>(rhs)); return *this; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat& operator-=(const T& rhs) { round(wide() - static_cast<double>(rhs)); return *this; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat& operator*=(const T& rhs) { round(wide() * static_cast<double>(rhs)); return *this; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        SRFloat& operator/=(const T& rhs) { round(wide() / static_cast<double>(rhs)); return *this; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend SRFloat operator+(const T& lhs, const SRFloat& rhs) { return SRFloat(static_cast<double>(lhs) + rhs.wide()); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend SRFloat operator-(const T& lhs, const SRFloat& rhs) { return SRFloat(static_cast<double>(lhs) - rhs.wide()); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend SRFloat operator*(const T& lhs, const SRFloat& rhs) { return SRFloat(static_cast<double>(lhs) * rhs.wide()); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend SRFloat operator/(const T& lhs, const SRFloat& rhs) { return SRFloat(static_cast<double>(lhs) / rhs.wide()); }
+
+        // Negation only flips the sign bit
+        SRFloat operator-() const {
+            return fromRaw(static_cast<code_t>(value ^ format::sign_mask));
+        }
+
+        /* comparison operators */
+
+        friend bool operator<(const SRFloat& lhs, const SRFloat& rhs) { return lhs.wide() < rhs.wide(); }
+        friend bool operator>(const SRFloat& lhs, const SRFloat& rhs) { return lhs.wide() > rhs.wide(); }
+        friend bool operator<=(const SRFloat& lhs, const SRFloat& rhs) { return lhs.wide() <= rhs.wide(); }
+        friend bool operator>=(const SRFloat& lhs, const SRFloat& rhs) { return lhs.wide() >= rhs.wide(); }
+        friend bool operator==(const SRFloat& lhs, const SRFloat& rhs) { return lhs.wide() == rhs.wide(); }
+        friend bool operator!=(const SRFloat& lhs, const SRFloat& rhs) { return lhs.wide() != rhs.wide(); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator<(const SRFloat& lhs, const T& rhs) { return lhs.wide() < rhs; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator<(const T& lhs, const SRFloat& rhs) { return lhs < rhs.wide(); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator>(const SRFloat& lhs, const T& rhs) { return lhs.wide() > rhs; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator>(const T& lhs, const SRFloat& rhs) { return lhs > rhs.wide(); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator<=(const SRFloat& lhs, const T& rhs) { return lhs.wide() <= rhs; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator<=(const T& lhs, const SRFloat& rhs) { return lhs <= rhs.wide(); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator>=(const SRFloat& lhs, const T& rhs) { return lhs.wide() >= rhs; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator>=(const T& lhs, const SRFloat& rhs) { return lhs >= rhs.wide(); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator==(const SRFloat& lhs, const T& rhs) { return lhs.wide() == rhs; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator==(const T& lhs, const SRFloat& rhs) { return lhs == rhs.wide(); }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator!=(const SRFloat& lhs, const T& rhs) { return lhs.wide() != rhs; }
+
+        template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+        friend bool operator!=(const T& lhs, const SRFloat& rhs) { return lhs != rhs.wide(); }
+
+        friend std::ostream& operator<<(std::ostream& os, const SRFloat& v) {
+            os << float(v);
+            return os;
+        }
+
+        /* Trigonometric functions */
+        friend inline SRFloat cos(const SRFloat&  x)  { return cos(x.wide()); }
+        friend inline SRFloat sin(const SRFloat&  x)  { return sin(x.wide()); }
+        friend inline SRFloat tan(const SRFloat&  x)  { return tan(x.wide()); }
+        friend inline SRFloat acos(const SRFloat&  x)  { return acos(x.wide()); }
+        friend inline SRFloat asin(const SRFloat&  x)  { return asin(x.wide()); }
+        friend inline SRFloat atan(const SRFloat&  x)  { return atan(x.wide()); }
+
+        /* Hyperbolic functions */
+        friend inline SRFloat cosh(const SRFloat&  x)  { return cosh(x.wide()); }
+        friend inline SRFloat sinh(const SRFloat&  x)  { return sinh(x.wide()); }
+        friend inline SRFloat tanh(const SRFloat&  x)  { return tanh(x.wide()); }
+        friend inline SRFloat acosh(const SRFloat&  x)  { return acosh(x.wide()); }
+        friend inline SRFloat asinh(const SRFloat&  x)  { return asinh(x.wide()); }
+        friend inline SRFloat atanh(const SRFloat&  x)  { return atanh(x.wide()); }
+
+        /* Exponential and logarithmic functions */
+        friend inline SRFloat exp(const SRFloat&  x)  { return exp(x.wide()); }
+        friend inline SRFloat log(const SRFloat&  x)  { return log(x.wide()); }
+        friend inline SRFloat log10(const SRFloat&  x)  { return log10(x.wide()); }
+        friend inline SRFloat logb(const SRFloat&  x)  { return logb(x.wide()); }
+
+        /* Power functions */
+        friend inline SRFloat pow(const SRFloat&  base, double exponent)  { return pow(base.wide(), exponent); }
+        friend inline SRFloat sqrt(const SRFloat&  x)  { return sqrt(x.wide()); }
+        friend inline SRFloat cbrt(const SRFloat&  x)  { return cbrt(x.wide()); }
+
+        friend inline SRFloat scalbn(const SRFloat&  x, int n)  { return scalbn(x.wide(), n); }
+
+        /* Fused multiply-add: a * b + c is computed in double and rounded once */
+        friend inline SRFloat fma(const SRFloat& a, const SRFloat& b, const SRFloat& c) {
+            return SRFloat(std::fma(a.wide(), b.wide(), c.wide()));
+        }
+
+        friend inline SRFloat fma(double a, const SRFloat& b, const SRFloat& c) {
+            return SRFloat(std::fma(a, b.wide(), c.wide()));
+        }
+
+        /* Other functions */
+        friend inline SRFloat abs(const SRFloat&  x)  { return fromRaw(static_cast<code_t>(x.value & ~format::sign_mask)); }
+        friend inline SRFloat fabs(const SRFloat&  x)  { return abs(x); }
+        friend inline SRFloat abs2(const SRFloat& x)  { return x*x; }
+
+        friend inline SRFloat copysign(const SRFloat&  x1, const SRFloat& x2)  {
+            return fromRaw(static_cast<code_t>((x1.value & ~format::sign_mask) | (x2.value & format::sign_mask)));
+        }
+        friend inline SRFloat fmax(const SRFloat&  x1, const SRFloat&  x2) { return x1 < x2 ? x2 : x1; }
+        friend inline bool isnan(const SRFloat& x) { return detail::srfloat_is_nan<format>(x.value); }
+        friend inline bool isinf(const SRFloat& x) { return format::ieee && (x.value & ~format::sign_mask) == format::infinity; }
+        friend inline bool isfinite(const SRFloat& x) { return !isnan(x) && !isinf(x); }
+
+    private:
+        double wide() const {
+            return static_cast<double>(detail::srfloat_decode<format>(value));
+        }
+
+        void round(double x) {
+            value = detail::srfloat_encode<format>(x, RNG::template bits<format::threshold_bits>());
+        }
+
+        void round(float x) {
+            if constexpr (!format::float_prefix) {
+                round(static_cast<double>(x));
+            } else if constexpr (format::float_cut_bits == 0) {
+                value = detail::srfloat_encode_float<format>(x, 0);
+            } else {
+                value = detail::srfloat_encode_float<format>(x, RNG::template bits<format::float_cut_bits>());
+            }
+        }
+
+        void round(long double x) {
+            round(static_cast<double>(x));
+        }
+
+        code_t value = 0;
+    };
+
+    /* Array rounding */
+
+    namespace detail {
+        // Block kernels: words holds one 32-bit random word per element, its upper threshold bits are the threshold.
+        // They give the same bits as the scalar constructors.
+        //
+        // AVX2 covers the double sources of every format and, when the format is a prefix of float, the float
+        // sources and the widening. Double sources are re-biased in 64-bit lanes, which is exact for the normal
+        // range of the format; a group of lanes with a subnormal, infinity or NaN goes through srfloat_encode.
+        // The other paths are scalar. CPUs with AVX-512 run the AVX2 kernels.
+
+        template<typename F>
+        void srfloat_pack_scalar(const double* src, const std::uint32_t* words, typename F::code_t* dst, std::size_t n) {
+            for (std::size_t i = 0; i < n; i++) {
+                dst[i] = srfloat_encode<F>(src[i], words[i] >> (32 - F::threshold_bits));
+            }
+        }
+
+        template<typename F>
+        void srfloat_pack_scalar(const float* src, const std::uint32_t* words, typename F::code_t* dst, std::size_t n) {
+            if constexpr (!F::float_prefix) {
+                for (std::size_t i = 0; i < n; i++) {
+                    dst[i] = srfloat_encode<F>(src[i], words[i] >> (32 - F::threshold_bits));
+                }
+            } else {
+                for (std::size_t i = 0; i < n; i++) {
+                    std::uint32_t p = 0;
+                    if constexpr (F::float_cut_bits > 0) {
+                        p = words[i] >> (32 - F::float_cut_bits);
+                    }
+                    dst[i] = srfloat_encode_float<F>(src[i], p);
+                }
+            }
+        }
+
+        template<typename F, typename WIDE>
+        void srfloat_unpack_scalar(const typename F::code_t* src, WIDE* dst, std::size_t n) {
+            for (std::size_t i = 0; i < n; i++) {
+                dst[i] = static_cast<WIDE>(srfloat_decode<F>(src[i]));
+            }
+        }
+
+#if RNDCMP_X86_DISPATCH
+        // Low 16 or 32 bits of the four 64-bit lanes of codes
+        template<typename F>
+        RNDCMP_TARGET("avx2")
+        void srfloat_store4_avx2(__m256i codes, typename F::code_t* dst) {
+            __m128i low = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(codes, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+            if constexpr (sizeof(typename F::code_t) == 4) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), low);
+            } else if constexpr (sizeof(typename F::code_t) == 2) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi32(low, low));
+            } else {
+                std::uint32_t lanes[4];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), low);
+                for (int i = 0; i < 4; i++) {
+                    dst[i] = static_cast<typename F::code_t>(lanes[i]);
+                }
+            }
+        }
+
+        template<typename F>
+        RNDCMP_TARGET("avx2")
+        void srfloat_pack_avx2(const double* src, const std::uint32_t* words, typename F::code_t* dst, std::size_t n) {
+            const __m256i sign_bit = _mm256_set1_epi64x(static_cast<long long>(std::uint64_t(1) << 63));
+            // Smallest normal number of the format and infinity as double bits, less one for the strict compares
+            const __m256i below_normal = _mm256_set1_epi64x((static_cast<long long>(1023 + F::min_exponent) << 52) - 1);
+            const __m256i below_infinity = _mm256_set1_epi64x((0x7ffLL << 52) - 1);
+            const __m256i rebias = _mm256_set1_epi64x(static_cast<long long>(1023 - F::bias) << F::mant_bits);
+            const __m256i cut_mask = _mm256_set1_epi64x((1LL << F::cut_bits) - 1);
+            const __m256i max_finite = _mm256_set1_epi64x(F::max_finite);
+            const __m256i zero = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i x = _mm256_castpd_si256(_mm256_loadu_pd(src + i));
+                __m256i sign = _mm256_and_si256(x, sign_bit);
+                __m256i magnitude = _mm256_andnot_si256(sign_bit, x);
+                __m256i is_zero = _mm256_cmpeq_epi64(magnitude, zero);
+                __m256i normal = _mm256_and_si256(_mm256_cmpgt_epi64(magnitude, below_normal),
+                                                  _mm256_cmpgt_epi64(below_infinity, magnitude));
+                if (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_or_si256(normal, is_zero))) != 0xf) {
+                    srfloat_pack_scalar<F>(src + i, words + i, dst + i, 4);
+                    continue;
+                }
+                __m256i code = _mm256_sub_epi64(_mm256_srli_epi64(magnitude, F::cut_bits), rebias);
+                __m256i dropped = _mm256_srli_epi64(_mm256_and_si256(magnitude, cut_mask), F::cut_bits - F::threshold_bits);
+                __m256i p = _mm256_srli_epi64(_mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i))),
+                                              32 - F::threshold_bits);
+                // up is -1 in rounded lanes
+                code = _mm256_sub_epi64(code, _mm256_cmpgt_epi64(dropped, p));
+                code = _mm256_blendv_epi8(code, max_finite, _mm256_cmpgt_epi64(code, max_finite));
+                code = _mm256_andnot_si256(is_zero, code);
+                code = _mm256_or_si256(code, _mm256_srli_epi64(sign, 63 - F::exp_bits - F::mant_bits));
+                srfloat_store4_avx2<F>(code, dst + i);
+            }
+            srfloat_pack_scalar<F>(src + i, words + i, dst + i, n - i);
+        }
+
+        template<typename F>
+        RNDCMP_TARGET("avx2")
+        void srfloat_pack_avx2(const float* src, const std::uint32_t* words, typename F::code_t* dst, std::size_t n) {
+            static_assert(F::float_prefix, "float sources are vectorized for prefixes of float only");
+            const __m256i sign_bit = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+            const __m256i infinity = _mm256_set1_epi32(0x7f800000);
+            const __m256i below_infinity = _mm256_set1_epi32(0x7f7fffff);
+            const __m256i cut_mask = _mm256_set1_epi32(static_cast<int>((std::uint32_t(1) << F::float_cut_bits) - 1));
+            const __m256i max_finite = _mm256_set1_epi32(static_cast<int>(F::max_finite));
+            const __m256i special_code = _mm256_set1_epi32(static_cast<int>(F::infinity));
+            const __m256i nan_code = _mm256_set1_epi32(static_cast<int>(F::quiet_nan));
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i x = _mm256_castps_si256(_mm256_loadu_ps(src + i));
+                __m256i sign = _mm256_and_si256(x, sign_bit);
+                __m256i magnitude = _mm256_andnot_si256(sign_bit, x);
+                __m256i code = _mm256_srli_epi32(magnitude, F::float_cut_bits);
+                if constexpr (F::float_cut_bits > 0) {
+                    __m256i p = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i)), 32 - F::float_cut_bits);
+                    code = _mm256_sub_epi32(code, _mm256_cmpgt_epi32(_mm256_and_si256(magnitude, cut_mask), p));
+                }
+                code = _mm256_min_epu32(code, max_finite);
+                // Infinities and NaNs keep their meaning
+                __m256i special = _mm256_blendv_epi8(nan_code, special_code, _mm256_cmpeq_epi32(magnitude, infinity));
+                code = _mm256_blendv_epi8(code, special, _mm256_cmpgt_epi32(magnitude, below_infinity));
+                code = _mm256_or_si256(code, _mm256_srli_epi32(sign, 31 - F::exp_bits - F::mant_bits));
+                if constexpr (sizeof(typename F::code_t) == 4) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), code);
+                } else {
+                    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(code, code), _MM_SHUFFLE(3, 1, 2, 0));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(packed));
+                }
+            }
+            srfloat_pack_scalar<F>(src + i, words + i, dst + i, n - i);
+        }
+
+        template<typename F, typename WIDE>
+        RNDCMP_TARGET("avx2")
+        void srfloat_unpack_avx2(const typename F::code_t* src, WIDE* dst, std::size_t n) {
+            static_assert(F::float_prefix, "widening is vectorized for prefixes of float only");
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256i code;
+                if constexpr (sizeof(typename F::code_t) == 4) {
+                    code = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                } else {
+                    code = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+                }
+                __m256 values = _mm256_castsi256_ps(_mm256_slli_epi32(code, F::float_cut_bits));
+                if constexpr (std::is_same_v<WIDE, float>) {
+                    _mm256_storeu_ps(dst + i, values);
+                } else {
+                    _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm256_castps256_ps128(values)));
+                    _mm256_storeu_pd(dst + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(values, 1)));
+                }
+            }
+            srfloat_unpack_scalar<F>(src + i, dst + i, n - i);
+        }
+#endif
+
+        template<typename F>
+        void srfloat_pack(simd::Isa isa, const double* src, const std::uint32_t* words, typename F::code_t* dst, std::size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if (isa >= simd::Isa::Avx2) {
+                srfloat_pack_avx2<F>(src, words, dst, n);
+                return;
+            }
+#endif
+            srfloat_pack_scalar<F>(src, words, dst, n);
+        }
+
+        template<typename F>
+        void srfloat_pack(simd::Isa isa, const float* src, const std::uint32_t* words, typename F::code_t* dst, std::size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if constexpr (F::float_prefix) {
+                if (isa >= simd::Isa::Avx2) {
+                    srfloat_pack_avx2<F>(src, words, dst, n);
+                    return;
+                }
+            }
+#endif
+            srfloat_pack_scalar<F>(src, words, dst, n);
+        }
+
+        template<typename F, typename WIDE>
+        void srfloat_unpack(simd::Isa isa, const typename F::code_t* src, WIDE* dst, std::size_t n) {
+#if RNDCMP_X86_DISPATCH
+            if constexpr (F::float_prefix) {
+                if (isa >= simd::Isa::Avx2) {
+                    srfloat_unpack_avx2<F>(src, dst, n);
+                    return;
+                }
+            }
+#endif
+            srfloat_unpack_scalar<F>(src, dst, n);
+        }
+    }
+
+    // Stochastically rounds n doubles or floats to SRFloat, same distribution as SRFloat<...>(src[i])
+    template<typename WIDE, int EXP_BITS, int MANT_BITS, typename RNG, FloatSpecials SPECIALS,
+             std::enable_if_t<std::is_same_v<WIDE, double> || std::is_same_v<WIDE, float>, int> = 0>
+    void round_sr(const WIDE* src, SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>* dst, std::size_t n) {
+        using format = typename SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>::format;
+        using code_t = typename format::code_t;
+        static_assert(sizeof(SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>) == sizeof(code_t), "SRFloat must have the layout of its bit pattern");
+        code_t* raw = reinterpret_cast<code_t*>(dst);
+        std::uint32_t words[simd::block_size];
+        for (std::size_t i = 0; i < n; i += simd::block_size) {
+            std::size_t count = std::min(n - i, static_cast<std::size_t>(simd::block_size));
+            RNG::words(words, count);
+            detail::srfloat_pack<format>(simd::active_isa(), src + i, words, raw + i, count);
+        }
+    }
+
+    // Rounds with the given 32-bit threshold words, one per element, instead of drawing them from RNG
+    template<typename WIDE, int EXP_BITS, int MANT_BITS, typename RNG, FloatSpecials SPECIALS,
+             std::enable_if_t<std::is_same_v<WIDE, double> || std::is_same_v<WIDE, float>, int> = 0>
+    void round_sr(const WIDE* src, const std::uint32_t* words, SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>* dst, std::size_t n) {
+        using format = typename SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>::format;
+        detail::srfloat_pack<format>(simd::active_isa(), src, words, reinterpret_cast<typename format::code_t*>(dst), n);
+    }
+
+    // Widens n SRFloat values to float or double
+    template<typename WIDE, int EXP_BITS, int MANT_BITS, typename RNG, FloatSpecials SPECIALS,
+             std::enable_if_t<std::is_same_v<WIDE, double> || std::is_same_v<WIDE, float>, int> = 0>
+    void convert(const SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>* src, WIDE* dst, std::size_t n) {
+        using format = typename SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>::format;
+        detail::srfloat_unpack<format>(simd::active_isa(), reinterpret_cast<const typename format::code_t*>(src), dst, n);
+    }
+
+    /* Eigen packet math */
+
+    namespace detail {
+        // Lanes are computed in double and rounded with the block kernel, as the scalar operators do
+        template<int EXP_BITS, int MANT_BITS, typename RNG, FloatSpecials SPECIALS>
+        struct PacketOps<SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>> {
+            using format = SRFormat<EXP_BITS, MANT_BITS, SPECIALS>;
+            using lane_t = typename format::code_t;
+            using scalar_t = SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>;
+
+            static lane_t lane(const scalar_t& x) {
+                return x.raw();
+            }
+
+            static scalar_t scalar(lane_t raw) {
+                return scalar_t::fromRaw(raw);
+            }
+
+            static void add(const lane_t* a, const lane_t* b, lane_t* out) {
+                apply(a, b, out, [](double x, double y) { return x + y; });
+            }
+
+            static void sub(const lane_t* a, const lane_t* b, lane_t* out) {
+                apply(a, b, out, [](double x, double y) { return x - y; });
+            }
+
+            static void mul(const lane_t* a, const lane_t* b, lane_t* out) {
+                apply(a, b, out, [](double x, double y) { return x * y; });
+            }
+
+            static void div(const lane_t* a, const lane_t* b, lane_t* out) {
+                apply(a, b, out, [](double x, double y) { return x / y; });
+            }
+
+            static void negate(const lane_t* a, lane_t* out) {
+                for (int i = 0; i < packet_size; i++) {
+                    out[i] = static_cast<lane_t>(a[i] ^ format::sign_mask);
+                }
+            }
+
+        private:
+            template<typename OP>
+            static void apply(const lane_t* a, const lane_t* b, lane_t* out, OP op) {
+                double x[packet_size], y[packet_size];
+                simd::Isa isa = simd::active_isa();
+                srfloat_unpack<format>(isa, a, x, packet_size);
+                srfloat_unpack<format>(isa, b, y, packet_size);
+                for (int i = 0; i < packet_size; i++) {
+                    x[i] = op(x[i], y[i]);
+                }
+                std::uint32_t words[packet_size];
+                RNG::words(words, packet_size);
+                srfloat_pack<format>(isa, x, words, out, packet_size);
+            }
+        };
+    }
+}
+
+namespace Eigen {
+    template<int EXP_BITS, int MANT_BITS, typename RNG, rndcmp::FloatSpecials SPECIALS>
+    struct NumTraits<rndcmp::SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS>>: NumTraits<float> {
+        typedef rndcmp::SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS> Real;
+        typedef rndcmp::SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS> NonInteger;
+        typedef rndcmp::SRFloat<EXP_BITS, MANT_BITS, RNG, SPECIALS> Nested;
+
+        enum {
+            IsComplex = 0,
+            IsInteger = 0,
+            IsSigned = 1,
+            RequireInitialization = 1,
+            ReadCost = 2,
+            AddCost = 6,
+            MulCost = 8
+        };
+
+        // Limits of the format rather than of float
+        static inline Real epsilon() { return Real(rndcmp::detail::pow2(-MANT_BITS)); }
+        static inline Real dummy_precision() { return Real(rndcmp::detail::pow2(-MANT_BITS / 2)); }
+        static inline Real highest() { return Real::fromRaw(Real::format::max_finite); }
+        static inline Real lowest() { return -highest(); }
+        static inline int digits10() { return static_cast<int>(MANT_BITS * 0.30103); }
+    };
+}
+
+// Formats of bfloat16sr and halfsr; other formats, fp8.hpp aside, opt in with RNDCMP_EIGEN_PACKET_MATH(format)
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::SRFloat<8, 7>)
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::SRFloat<5, 10>)
+
+#endif  // RNDCMP_INCLUDE_SRFLOAT_HPP_
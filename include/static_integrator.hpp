@@ -0,0 +1,148 @@
+#ifndef RNDCMP_INCLUDE_STATIC_INTEGRATOR_HPP_
+#define RNDCMP_INCLUDE_STATIC_INTEGRATOR_HPP_
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "integrator.hpp"
+
+
+// Integrators of systems with the dimension N known at compile time. The state and the stages are values of
+// STATE (std::array<DTYPE, N> or a fixed-size Eigen vector) local to solve(), every loop over the components
+// is unrolled and the steps are not virtual, so a small system stays in registers between the steps.
+// SYSTEM is a callable f(const STATE& x, double t, STATE& dxdt). The roundings are those of the
+// std::vector integrators, the results are the same bit for bit.
+namespace rndcmp {
+
+    namespace detail {
+        template<typename F, std::size_t... I>
+        void unroll_sequence(F& f, std::index_sequence<I...>) {
+            (f(std::integral_constant<std::size_t, I>()), ...);
+        }
+
+        // f(0), f(1), ..., f(N - 1) with compile-time indices
+        template<std::size_t N, typename F>
+        void unroll(F&& f) {
+            unroll_sequence(f, std::make_index_sequence<N>());
+        }
+    }
+
+    template<typename DERIVED, typename DTYPE, std::size_t N, typename SYSTEM, typename STATE>
+    class StaticIntegratorBase: public CheckpointedRun {
+    public:
+        using State = STATE;
+
+        StaticIntegratorBase(const SYSTEM& system, double timeStart, double timeEnd, double step):
+        CheckpointedRun(timeStart, timeEnd, step), _system(system) {}
+
+        void setInitial(const STATE& initial) {
+            _initial = initial;
+        }
+
+        void solve() {
+            _solution.clear();
+            _solution.reserve(expectedPoints());
+            solve([this](double, const STATE& x) {
+                _solution.push_back(x);
+            });
+        }
+
+        // Passes every point to sink(t, x), see sinks.hpp
+        template<typename SINK>
+        void solve(SINK&& sink) {
+            STATE x = _initial;
+            double t = _timeStart;
+            size_t points = 1;
+            if (!resuming()) {
+                sink(_timeStart, static_cast<const STATE&>(x));
+            } else {
+                t = readCheckpoint<DTYPE>(x, points, [](CheckpointReader&) {});
+            }
+            for (; t <= _timeEnd; t+=_step) {
+                static_cast<DERIVED*>(this)->step(x, t);
+                sink(t + _step, static_cast<const STATE&>(x));
+                points++;
+                if (checkpointDue(points)) {
+                    writeCheckpoint<DTYPE>(sink, t + _step, points, x, [](CheckpointWriter&) {});
+                }
+            }
+        }
+
+        const std::vector<STATE>& getSolution() const {
+            return _solution;
+        }
+
+        static constexpr std::size_t dimension() {
+            return N;
+        }
+
+    protected:
+        SYSTEM _system;
+        STATE _initial{};
+        std::vector<STATE> _solution;
+    };
+
+    template<typename DTYPE, std::size_t N, typename SYSTEM, typename STATE = std::array<DTYPE, N>>
+    class StaticEulerIntegrator: public StaticIntegratorBase<StaticEulerIntegrator<DTYPE, N, SYSTEM, STATE>, DTYPE, N, SYSTEM, STATE> {
+        using Base = StaticIntegratorBase<StaticEulerIntegrator<DTYPE, N, SYSTEM, STATE>, DTYPE, N, SYSTEM, STATE>;
+        friend Base;
+
+    public:
+        using Base::Base;
+
+    protected:
+        void step(STATE& x, double t) {
+            STATE f;
+            this->_system(x, t, f);
+            detail::unroll<N>([&](auto i) {
+                x[i] = detail::multiply_add(this->_step, f[i], x[i]);
+            });
+        }
+    };
+
+    template<typename DTYPE, std::size_t N, typename SYSTEM, typename STATE = std::array<DTYPE, N>>
+    class StaticRK4Integrator: public StaticIntegratorBase<StaticRK4Integrator<DTYPE, N, SYSTEM, STATE>, DTYPE, N, SYSTEM, STATE> {
+        using Base = StaticIntegratorBase<StaticRK4Integrator<DTYPE, N, SYSTEM, STATE>, DTYPE, N, SYSTEM, STATE>;
+        friend Base;
+
+    public:
+        using Base::Base;
+
+    protected:
+        void step(STATE& x, double t) {
+            double h = this->_step;
+            STATE k1, k2, k3, k4, stage;
+            this->_system(x, t, k1);
+            detail::unroll<N>([&](auto i) { stage[i] = detail::multiply_add(h / 2., k1[i], x[i]); });
+            this->_system(stage, t + h / 2., k2);
+            detail::unroll<N>([&](auto i) { stage[i] = detail::multiply_add(h / 2., k2[i], x[i]); });
+            this->_system(stage, t + h / 2., k3);
+            detail::unroll<N>([&](auto i) { stage[i] = detail::multiply_add(h, k3[i], x[i]); });
+            this->_system(stage, t + h, k4);
+
+            detail::unroll<N>([&](auto i) {
+                if constexpr (detail::has_fused_multiply_add<DTYPE>::value) {
+                    DTYPE sum = detail::multiply_add(2., k3[i], detail::multiply_add(2., k2[i], k1[i])) + k4[i];
+                    x[i] = detail::multiply_add(h / 6., sum, x[i]);
+                } else {
+                    x[i] = DTYPE(x[i] + h / 6. * (k1[i] + 2. * k2[i] + 2. * k3[i] + k4[i]));
+                }
+            });
+        }
+    };
+
+    template<typename DTYPE, std::size_t N, typename SYSTEM>
+    StaticEulerIntegrator<DTYPE, N, SYSTEM> make_static_euler_integrator(const SYSTEM& system, double timeStart, double timeEnd, double step) {
+        return StaticEulerIntegrator<DTYPE, N, SYSTEM>(system, timeStart, timeEnd, step);
+    }
+
+    template<typename DTYPE, std::size_t N, typename SYSTEM>
+    StaticRK4Integrator<DTYPE, N, SYSTEM> make_static_rk4_integrator(const SYSTEM& system, double timeStart, double timeEnd, double step) {
+        return StaticRK4Integrator<DTYPE, N, SYSTEM>(system, timeStart, timeEnd, step);
+    }
+}
+
+#endif  // RNDCMP_INCLUDE_STATIC_INTEGRATOR_HPP_
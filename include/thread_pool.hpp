@@ -0,0 +1,146 @@
+#ifndef RNDCMP_INCLUDE_THREAD_POOL_HPP_
+#define RNDCMP_INCLUDE_THREAD_POOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace rndcmp {
+    // Worker threads started once and kept for the lifetime of the process, so code that is called every time step
+    // (gemm in ESN::update, run_trials in a loop) does not pay for creating threads.
+    //
+    // run(tasks, task) calls task(i) for i = 0 .. tasks - 1 and returns when all calls are done. The calling thread
+    // runs tasks as well, and the workers take the tasks of the oldest job first. A task may call run() itself: the
+    // nested job is pushed behind the running ones and its caller works on it, so nothing waits for a worker that
+    // is not coming. Which thread runs a task is not fixed, tasks that draw random numbers set their stream with
+    // an RngContext.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned workers) {
+            for (unsigned w = 0; w < workers; w++) {
+                _workers.emplace_back([this] { loop(); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _wake.notify_all();
+            for (std::thread& worker : _workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Pool of gemm and run_trials, started on first use with a worker for every hardware thread but the caller's
+        static ThreadPool& shared() {
+            static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+            return pool;
+        }
+
+        // Threads that can run the tasks of a job at once, the caller included
+        std::size_t size() const {
+            return _workers.size() + 1;
+        }
+
+        // The first exception thrown by a task is rethrown here once every task has finished
+        template<typename TASK>
+        void run(std::size_t tasks, TASK&& task) {
+            if (tasks == 0) {
+                return;
+            }
+            if (tasks == 1 || _workers.empty()) {
+                for (std::size_t i = 0; i < tasks; i++) {
+                    task(i);
+                }
+                return;
+            }
+
+            auto job = std::make_shared<Job>();
+            job->task = std::ref(task);
+            job->tasks = tasks;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _jobs.push_back(job);
+            }
+            _wake.notify_all();
+
+            work(*job);
+            std::unique_lock<std::mutex> lock(_mutex);
+            _finished.wait(lock, [&] { return job->done == job->tasks; });
+            if (job->error) {
+                std::rethrow_exception(job->error);
+            }
+        }
+
+    private:
+        struct Job {
+            std::function<void(std::size_t)> task;
+            std::size_t tasks = 0;
+            std::atomic<std::size_t> next{0};
+            std::atomic<std::size_t> done{0};
+            std::exception_ptr error;
+        };
+
+        // Claims the tasks of job one at a time until none are left
+        void work(Job& job) {
+            for (std::size_t i = job.next.fetch_add(1); i < job.tasks; i = job.next.fetch_add(1)) {
+                try {
+                    job.task(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (!job.error) {
+                        job.error = std::current_exception();
+                    }
+                }
+                if (job.done.fetch_add(1) + 1 == job.tasks) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _finished.notify_all();
+                }
+            }
+            // Every task is claimed, the job leaves the queue
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto found = std::find_if(_jobs.begin(), _jobs.end(), [&](const std::shared_ptr<Job>& queued) { return queued.get() == &job; });
+            if (found != _jobs.end()) {
+                _jobs.erase(found);
+            }
+        }
+
+        void loop() {
+            while (true) {
+                std::shared_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _wake.wait(lock, [this] { return _stop || !_jobs.empty(); });
+                    if (_stop) {
+                        return;
+                    }
+                    job = _jobs.front();
+                }
+                work(*job);
+            }
+        }
+
+        std::vector<std::thread> _workers;
+        std::deque<std::shared_ptr<Job>> _jobs;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::condition_variable _finished;
+        bool _stop = false;
+    };
+}
+
+#endif  // RNDCMP_INCLUDE_THREAD_POOL_HPP_
@@ -8,5 +8,7 @@
 #include "halfsr.hpp"
 #include "bfloat16.hpp"
 #include "bfloat16sr.hpp"
+#include "srfloat.hpp"
+#include "fp8.hpp"
 
 #endif  // RNDCMP_INCLUDE_TYPES_HPP_
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "types.hpp"
 #include "integrator.hpp"
 #include "esn.hpp"
+#include "montecarlo.hpp"
 
 using Fixed16 = rndcmp::Fixed<std::int32_t, 16>;
 using FixedSR16 = rndcmp::FixedSR<std::int32_t, 16>;
@@ -15,7 +16,7 @@ using Fixed8 = rndcmp::Fixed<std::int16_t, 8>;
 using FixedSR8 = rndcmp::FixedSR<std::int16_t, 8>;
 
 template<typename T>
-std::vector<std::vector<T>> calculate(double time_end, double step) {
+rndcmp::Trajectory<T> calculate(double time_end, double step) {
     rndcmp::system_type<T> system = {
         [] (const std::vector<T>& x, double t) { return T(10.0 * (x[1] - x[0])); },
         [] (const std::vector<T>& x, double t) { return T(x[0] * (28.0 - x[2]) - x[1]); },
@@ -25,29 +26,25 @@ std::vector<std::vector<T>> calculate(double time_end, double step) {
     std::vector<T> initial = {T(1.), T(1.), T(1.)};
     auto integrator = rndcmp::RK4Integrator<T>(system, 0.0, time_end, step);
     integrator.setInitial(initial);
-    integrator.solve();
+    rndcmp::Trajectory<T> trajectory(integrator.expectedPoints(), initial.size());
+    integrator.solve(trajectory);
 
-    return integrator.getSolution();
+    return trajectory;
 }
 
 template<typename T>
 std::vector<double> run_once(size_t layers_cnt, double time_end, double step, double sparsity, double spectral_radius) {
-    size_t seed = time(NULL);
-    std::vector<std::vector<double>> inputs = calculate<double>(time_end, step);
-    size_t full_size = inputs.size() / 10;
+    // Drawn from the RNG stream of the trial, so every repetition gets its own network
+    size_t seed = rndcmp::DefaultRng::bits<32>();
+    rndcmp::Trajectory<double> inputs = calculate<double>(time_end, step);
+    size_t full_size = inputs.rows() / 10;
     size_t train_size = full_size / 6.0 * 5;
     size_t test_size = full_size - train_size;    
 
-    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> eigen_inputs_d;
-    eigen_inputs_d.resize(full_size, 3);
+    size_t idx_step = inputs.rows() / full_size;
 
-    size_t idx_step = inputs.size() / full_size;
-
-    for (size_t i = 0; i < full_size; i++) {
-        eigen_inputs_d.row(i) = Eigen::Map<Eigen::Matrix<double, 1, 3>>(inputs[i * idx_step].data());
-    }
-
-    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> eigen_inputs = eigen_inputs_d.template cast<T>();
+    // Every idx_step-th point, read in place and rounded to T
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> eigen_inputs = inputs.matrix(idx_step).topRows(full_size).template cast<T>();
 
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> train = eigen_inputs.block(0, 0, train_size, 3);
 
@@ -75,10 +72,13 @@ std::vector<double> run_once(size_t layers_cnt, double time_end, double step, do
 
 template<typename T>
 void run(size_t layers_cnt, double time_end, double step, double sparsity, double spectral_radius) {
-    std::vector<std::vector<double>> errors_arr;
-    for (size_t i = 0; i < 1; i++) {
-        errors_arr.push_back(run_once<T>(layers_cnt, time_end, step, sparsity, spectral_radius));
-    }
+    const size_t repetitions = 1;
+    std::vector<std::vector<double>> errors_arr(repetitions);
+    rndcmp::seed(time(NULL));
+    rndcmp::run_trials<T>(repetitions, [&](size_t i) {
+        errors_arr[i] = run_once<T>(layers_cnt, time_end, step, sparsity, spectral_radius);
+        return errors_arr[i].back();
+    });
 
     size_t best = 0;
     double min = -1;
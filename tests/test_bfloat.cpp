@@ -1,4 +1,8 @@
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "bfloat16.hpp"
@@ -143,3 +147,117 @@ TEST(bfloatsr_test_case, math_functions_test) {
 
     EXPECT_EQ(abs(rndcmp::bfloat16sr(-2.5)), 2.5);
 }
+
+/* Array conversion test cases */
+
+std::vector<float> bfloat_test_values(size_t n, std::mt19937& gen) {
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    std::vector<float> values(n);
+    for (auto& v : values) {
+        v = dist(gen);
+    }
+    std::vector<float> special = {
+        0.0f, -0.0f, 1e-40f, std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(),
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::quiet_NaN()
+    };
+    std::copy(special.begin(), special.end(), values.begin() + 20);
+    return values;
+}
+
+TEST(bfloat_test_case, array_kernels_test) {
+    // Every SIMD kernel the CPU supports must match the scalar one bit for bit
+    std::mt19937 gen(3);
+    size_t N = 1003;
+    std::vector<float> src = bfloat_test_values(N, gen);
+    std::vector<uint32_t> words(N);
+    for (auto& w : words) {
+        w = gen();
+    }
+    // Word that forces rounding up the negative NaN 0xffff... and wraps its pattern
+    words[26] = 0;
+
+    std::vector<uint16_t> packed(N);
+    std::vector<uint16_t> packed_sr(N);
+    std::vector<float> unpacked(N);
+    rndcmp::detail::bfloat16_pack(rndcmp::simd::Isa::Scalar, src.data(), packed.data(), N);
+    rndcmp::detail::bfloat16_pack_sr(rndcmp::simd::Isa::Scalar, src.data(), words.data(), packed_sr.data(), N);
+    rndcmp::detail::bfloat16_unpack(rndcmp::simd::Isa::Scalar, packed.data(), unpacked.data(), N);
+    for (auto isa : {rndcmp::simd::Isa::Avx2, rndcmp::simd::Isa::Avx512}) {
+        if (rndcmp::simd::cpu_isa() < isa) {
+            continue;
+        }
+        std::vector<uint16_t> actual(N);
+        rndcmp::detail::bfloat16_pack(isa, src.data(), actual.data(), N);
+        EXPECT_EQ(packed, actual) << "isa: " << static_cast<int>(isa);
+        rndcmp::detail::bfloat16_pack_sr(isa, src.data(), words.data(), actual.data(), N);
+        EXPECT_EQ(packed_sr, actual) << "isa: " << static_cast<int>(isa);
+        std::vector<float> actual_unpacked(N);
+        rndcmp::detail::bfloat16_unpack(isa, packed.data(), actual_unpacked.data(), N);
+        EXPECT_EQ(0, memcmp(unpacked.data(), actual_unpacked.data(), N * sizeof(float))) << "isa: " << static_cast<int>(isa);
+    }
+}
+
+TEST(bfloat_test_case, array_conversion_test) {
+    std::mt19937 gen(5);
+    size_t N = 517;
+    std::vector<float> src = bfloat_test_values(N, gen);
+    src[26] = 1.5f;
+
+    std::vector<rndcmp::bfloat16> dst(N);
+    rndcmp::convert(src.data(), dst.data(), N);
+    std::vector<float> back(N);
+    rndcmp::convert(dst.data(), back.data(), N);
+    for (size_t i = 0; i < N; i++) {
+        EXPECT_EQ(dst[i], rndcmp::bfloat16(src[i])) << "value: " << src[i];
+        EXPECT_EQ(back[i], static_cast<float>(rndcmp::bfloat16(src[i]))) << "value: " << src[i];
+    }
+
+    std::vector<rndcmp::basic_bfloat16sr<rndcmp::NearestRng>> nearest(N);
+    rndcmp::round_sr(src.data(), nearest.data(), N);
+    rndcmp::convert(nearest.data(), back.data(), N);
+    for (size_t i = 0; i < N; i++) {
+        rndcmp::basic_bfloat16sr<rndcmp::NearestRng> expected(src[i]);
+        EXPECT_EQ(back[i], static_cast<float>(expected)) << "value: " << src[i];
+    }
+}
+
+TEST(bfloat_test_case, array_stochastic_rounding_test) {
+    size_t N = 100000;
+    float expected = 1.0f / 3.0f;
+    std::vector<float> src(N, expected);
+    std::vector<rndcmp::bfloat16sr> dst(N);
+    rndcmp::round_sr(src.data(), dst.data(), N);
+    std::vector<float> back(N);
+    rndcmp::convert(dst.data(), back.data(), N);
+    double mean = 0.0;
+    for (float v : back) {
+        mean += v;
+    }
+    EXPECT_NEAR(mean / N, expected, 3e-5);
+}
+
+TEST(bfloatsr_test_case, fma_test) {
+    // (1 + 2^-7)^2 - (1 + 2^-6) = 2^-14 is lost when the product is rounded before the sum
+    double eps = std::ldexp(1.0, -7);
+    rndcmp::bfloat16sr a(static_cast<float>(1.0 + eps)), c(static_cast<float>(-(1.0 + 2 * eps)));
+    EXPECT_EQ(static_cast<double>(fma(a, a, c)), std::ldexp(1.0, -14));
+    EXPECT_EQ(static_cast<double>(fma(1.0 + eps, a, c)), std::ldexp(1.0, -14));
+    using Nearest = rndcmp::basic_bfloat16sr<rndcmp::NearestRng>;
+    Nearest nearest_a(static_cast<float>(a)), nearest_c(static_cast<float>(c));
+    EXPECT_EQ(static_cast<double>(nearest_a * nearest_a + nearest_c), 0.0);
+
+    // The single rounding is unbiased
+    size_t N = 20000;
+    rndcmp::bfloat16sr x(0.1f), y(0.3f), z(0.7f);
+    double exact = static_cast<double>(x) * static_cast<double>(y) + static_cast<double>(z);
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(fma(x, y, z)) / N;
+    }
+    EXPECT_NEAR(mean, exact, 1e-4);
+
+    // 1 + 2^-8 + 2^-30 is past the middle of the step, as float it would be exactly the middle
+    Nearest one(1.0f), zero(0.0f);
+    EXPECT_EQ(static_cast<double>(fma(1.0 + std::ldexp(1.0, -8) + std::ldexp(1.0, -30), one, zero)), 1.0 + eps);
+    EXPECT_EQ(static_cast<double>(fma(-1.0 - std::ldexp(1.0, -8) - std::ldexp(1.0, -30), one, zero)), -1.0 - eps);
+}
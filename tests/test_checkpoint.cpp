@@ -0,0 +1,269 @@
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "random.hpp"
+#include "types.hpp"
+#include "integrator.hpp"
+#include "static_integrator.hpp"
+#include "checkpoint.hpp"
+
+
+namespace {
+    // Thrown by a sink to stop a run in the middle, as a preemption would
+    struct Preempted {};
+
+    template<typename T>
+    struct Lorenz {
+        template<typename STATE>
+        void operator()(const STATE& x, double, STATE& dxdt) const {
+            dxdt[0] = T(10.0 * (x[1] - x[0]));
+            dxdt[1] = T(x[0] * (28.0 - x[2]) - x[1]);
+            dxdt[2] = T(x[0] * x[1] - 8.0 / 3.0 * x[2]);
+        }
+    };
+
+    struct Point {
+        double t;
+        std::vector<double> x;
+    };
+
+    // Collects the points, throws Preempted after stop points
+    struct Recorder {
+        std::vector<Point> points;
+        size_t stop = 0;
+
+        template<typename STATE>
+        void operator()(double t, const STATE& x) {
+            if (stop > 0 && points.size() == stop) {
+                throw Preempted();
+            }
+            Point point{t, {}};
+            for (size_t i = 0; i < static_cast<size_t>(x.size()); i++) {
+                point.x.push_back(static_cast<double>(x[i]));
+            }
+            points.push_back(point);
+        }
+    };
+
+    // Writes to a file sink, throws Preempted after stop points
+    struct PreemptedFile {
+        rndcmp::BinaryFileSink& file;
+        size_t stop;
+        size_t count = 0;
+
+        template<typename STATE>
+        void operator()(double t, const STATE& x) {
+            if (count++ == stop) {
+                throw Preempted();
+            }
+            file(t, x);
+        }
+
+        void flush() {
+            file.flush();
+        }
+    };
+
+    // Runs make() to the end, then again with checkpoints and a preemption, and resumes a fresh integrator
+    // from the last checkpoint. The resumed points are the ones of the uninterrupted run bit for bit.
+    template<typename MAKE>
+    void check_resume(MAKE make, size_t every, size_t stop) {
+        std::string path = ::testing::TempDir() + "rndcmp_checkpoint_test.bin";
+        Recorder reference;
+        {
+            rndcmp::RngContext context(11, 2);
+            auto integrator = make();
+            integrator.solve(reference);
+        }
+        ASSERT_GT(reference.points.size(), stop);
+
+        Recorder preempted;
+        preempted.stop = stop;
+        {
+            rndcmp::RngContext context(11, 2);
+            auto integrator = make();
+            integrator.setCheckpoint(path, every);
+            EXPECT_THROW(integrator.solve(preempted), Preempted);
+        }
+
+        // The stream continues from the checkpoint whatever the seed of the new process
+        Recorder resumed;
+        size_t points;
+        {
+            rndcmp::RngContext context(99, 7);
+            auto integrator = make();
+            points = integrator.resumeFrom(path);
+            integrator.solve(resumed);
+        }
+        EXPECT_EQ(points, (stop - 1) / every * every + 1);
+        ASSERT_EQ(points + resumed.points.size(), reference.points.size());
+        for (size_t i = 0; i < resumed.points.size(); i++) {
+            const Point& expected = reference.points[points + i];
+            EXPECT_EQ(resumed.points[i].t, expected.t) << i;
+            EXPECT_EQ(resumed.points[i].x, expected.x) << i;
+        }
+        std::remove(path.c_str());
+    }
+}
+
+TEST(checkpoint_test_case, rng_snapshot_test) {
+    using RNG = rndcmp::DefaultRng;
+    rndcmp::RngContext context(5, 1);
+    RNG::bits<13>();
+    RNG::Snapshot snapshot = RNG::save();
+    std::vector<std::uint32_t> first;
+    for (int i = 0; i < 2000; i++) {
+        first.push_back(RNG::bits<29>());
+    }
+    RNG::restore(snapshot);
+    for (int i = 0; i < 2000; i++) {
+        EXPECT_EQ(RNG::bits<29>(), first[i]) << i;
+    }
+}
+
+TEST(checkpoint_test_case, rk4_resume_test) {
+    using T = rndcmp::FloatSR;
+    check_resume([] {
+        auto integrator = rndcmp::make_rk4_integrator<T>(Lorenz<T>(), 0.0, 2.0, 0.01);
+        integrator.setInitial({T(1.0f), T(1.0f), T(1.0f)});
+        return integrator;
+    }, 37, 120);
+}
+
+TEST(checkpoint_test_case, dormand_prince_resume_test) {
+    using T = rndcmp::bfloat16sr;
+    check_resume([] {
+        auto integrator = rndcmp::make_dormand_prince_integrator<T>(Lorenz<T>(), 0.0, 20.0, 0.01);
+        integrator.setTolerance(1e-3, 1e-3);
+        integrator.setInitial({T(1.0f), T(1.0f), T(1.0f)});
+        return integrator;
+    }, 10, 45);
+}
+
+TEST(checkpoint_test_case, verlet_resume_test) {
+    using T = rndcmp::FloatSR;
+    auto spring = [](const std::vector<T>& q, double, std::vector<T>& dpdt) { dpdt[0] = -q[0]; };
+    auto system = rndcmp::make_separable_system<T>(spring, 1);
+    check_resume([system] {
+        auto integrator = rndcmp::make_yoshida_integrator<T>(system, 0.0, 10.0, 0.05);
+        integrator.setInitial({T(1.0f), T(0.0f)});
+        return integrator;
+    }, 20, 90);
+}
+
+TEST(checkpoint_test_case, static_resume_test) {
+    using T = rndcmp::FloatSR;
+    check_resume([] {
+        auto integrator = rndcmp::make_static_rk4_integrator<T, 3>(Lorenz<T>(), 0.0, 2.0, 0.01);
+        integrator.setInitial({T(1.0f), T(1.0f), T(1.0f)});
+        return integrator;
+    }, 25, 101);
+}
+
+// A preempted run that writes a file continues it, the file is the one of the uninterrupted run
+TEST(checkpoint_test_case, file_resume_test) {
+    using T = rndcmp::FloatSR;
+    std::string checkpoint = ::testing::TempDir() + "rndcmp_checkpoint_file_test.ckpt";
+    std::string reference = ::testing::TempDir() + "rndcmp_checkpoint_reference.bin";
+    std::string output = ::testing::TempDir() + "rndcmp_checkpoint_output.bin";
+    auto make = [] {
+        auto integrator = rndcmp::make_static_rk4_integrator<T, 3>(Lorenz<T>(), 0.0, 1.0, 0.01);
+        integrator.setInitial({T(1.0f), T(1.0f), T(1.0f)});
+        return integrator;
+    };
+    {
+        rndcmp::RngContext context(3, 0);
+        rndcmp::BinaryFileSink file(reference);
+        make().solve(file);
+    }
+    {
+        rndcmp::RngContext context(3, 0);
+        rndcmp::BinaryFileSink file(output);
+        auto integrator = make();
+        integrator.setCheckpoint(checkpoint, 16);
+        PreemptedFile preempted{file, 70};
+        EXPECT_THROW(integrator.solve(preempted), Preempted);
+    }
+    {
+        rndcmp::RngContext context(3, 0);
+        auto integrator = make();
+        size_t points = integrator.resumeFrom(checkpoint);
+        EXPECT_EQ(points, 65);
+        rndcmp::BinaryFileSink file(output, points, 3);
+        integrator.solve(file);
+    }
+    auto read = [](const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    };
+    EXPECT_EQ(read(output), read(reference));
+    EXPECT_THROW(rndcmp::BinaryFileSink(output, 1000, 3), std::runtime_error);
+    for (const auto& path : {checkpoint, reference, output}) {
+        std::remove(path.c_str());
+    }
+}
+
+// Every point a checkpoint counts is on disk when the checkpoint is committed, not only once the sink is
+// destroyed: a killed run does not lose them in the buffer of the file
+TEST(checkpoint_test_case, file_flush_test) {
+    std::string checkpoint = ::testing::TempDir() + "rndcmp_checkpoint_flush_test.ckpt";
+    std::string output = ::testing::TempDir() + "rndcmp_checkpoint_flush_output.bin";
+    std::remove(checkpoint.c_str());
+    auto probe = rndcmp::make_rk4_integrator<double>(Lorenz<double>(), 0.0, 1.0, 0.01);
+    size_t checked = 0;
+    // The system runs after every checkpoint, before the next point reaches the sink
+    auto system = [&](const std::vector<double>& x, double t, std::vector<double>& dxdt) {
+        if (std::ifstream(checkpoint)) {
+            size_t points = probe.resumeFrom(checkpoint);
+            EXPECT_GE(std::filesystem::file_size(output), points * 4 * sizeof(double)) << t;
+            checked++;
+        }
+        Lorenz<double>()(x, t, dxdt);
+    };
+    {
+        auto integrator = rndcmp::make_rk4_integrator<double>(system, 0.0, 1.0, 0.01);
+        integrator.setInitial({1.0, 1.0, 1.0});
+        integrator.setCheckpoint(checkpoint, 10);
+        rndcmp::BinaryFileSink file(output);
+        integrator.solve(file);
+    }
+    EXPECT_GT(checked, 0);
+    for (const auto& path : {checkpoint, output}) {
+        std::remove(path.c_str());
+    }
+}
+
+TEST(checkpoint_test_case, mismatch_test) {
+    std::string path = ::testing::TempDir() + "rndcmp_checkpoint_mismatch.ckpt";
+    auto integrator = rndcmp::make_rk4_integrator<double>(Lorenz<double>(), 0.0, 1.0, 0.01);
+    integrator.setInitial({1.0, 1.0, 1.0});
+    integrator.setCheckpoint(path, 10);
+    integrator.solve();
+
+    // Another step, another dimension, not a checkpoint
+    auto other = rndcmp::make_rk4_integrator<double>(Lorenz<double>(), 0.0, 1.0, 0.02);
+    EXPECT_THROW(other.resumeFrom(path), std::runtime_error);
+    auto smaller = rndcmp::make_rk4_integrator<double>(Lorenz<double>(), 0.0, 1.0, 0.01);
+    smaller.setInitial({1.0, 1.0});
+    smaller.resumeFrom(path);
+    EXPECT_THROW(smaller.solve(), std::runtime_error);
+    auto stochastic = rndcmp::make_rk4_integrator<rndcmp::FloatSR>(Lorenz<rndcmp::FloatSR>(), 0.0, 1.0, 0.01);
+    stochastic.setInitial({1.0f, 1.0f, 1.0f});
+    stochastic.resumeFrom(path);
+    EXPECT_THROW(stochastic.solve(), std::runtime_error);
+    EXPECT_THROW(integrator.resumeFrom(path + ".missing"), std::runtime_error);
+    {
+        std::ofstream garbage(path, std::ios::binary | std::ios::trunc);
+        garbage << "not a checkpoint";
+    }
+    EXPECT_THROW(integrator.resumeFrom(path), std::runtime_error);
+    std::remove(path.c_str());
+}
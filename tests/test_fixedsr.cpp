@@ -1,4 +1,6 @@
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 #include "gtest/gtest.h"
 #include "fixed.hpp"
@@ -64,6 +66,73 @@ TEST(fp_test_case, math_functions_test) {
     EXPECT_EQ(abs(rndcmp::Fixed<std::int16_t, 8>(-2.5)), 2.5);
 }
 
+TEST(fp_test_case, integer_arithmetic_test) {
+    using Fixed8 = rndcmp::Fixed<std::int16_t, 8>;
+    // Products of 16-bit values are exact in double, so the double path is the reference
+    for (int a = -600; a <= 600; a += 7) {
+        for (int b = -600; b <= 600; b += 11) {
+            Fixed8 x(a / 256.0), y(b / 256.0);
+            EXPECT_EQ(double(x * y), double(Fixed8(double(x) * double(y)))) << a << " * " << b;
+            if (b != 0) {
+                EXPECT_EQ(double(x / y), double(Fixed8(double(x) / double(y)))) << a << " / " << b;
+            }
+            EXPECT_EQ(double(x + y), (a + b) / 256.0);
+            EXPECT_EQ(double(x - y), (a - b) / 256.0);
+        }
+    }
+
+    // 64-bit values multiply through a 128-bit intermediate
+    rndcmp::Fixed<std::int64_t, 40> big(1000.25);
+    EXPECT_EQ(double(big * big), 1000500.0625);
+    EXPECT_EQ(double(big / rndcmp::Fixed<std::int64_t, 40>(0.5)), 2000.5);
+}
+
+TEST(fp_test_case, rounding_mode_test) {
+    using Truncated = rndcmp::Fixed<std::int16_t, 8>;
+    using Nearest = rndcmp::Fixed<std::int16_t, 8, 2, rndcmp::FixedRounding::Nearest>;
+    const double ulp = 1.0 / 256;
+
+    EXPECT_EQ(double(Truncated(3 * ulp) * Truncated(0.5)), ulp);
+    EXPECT_EQ(double(Truncated(-3 * ulp) * Truncated(0.5)), -ulp);
+    EXPECT_EQ(double(Nearest(3 * ulp) * Nearest(0.5)), 2 * ulp);
+    EXPECT_EQ(double(Nearest(-3 * ulp) * Nearest(0.5)), -2 * ulp);
+    EXPECT_EQ(double(Nearest(ulp) * Nearest(0.25)), 0.0);
+
+    EXPECT_EQ(double(Truncated(2) / Truncated(3)), 170 * ulp);
+    EXPECT_EQ(double(Nearest(2) / Nearest(3)), 171 * ulp);
+    EXPECT_EQ(double(Nearest(-2) / Nearest(3)), -171 * ulp);
+    EXPECT_EQ(double(Nearest(1) / 3), 85 * ulp);
+
+    EXPECT_EQ(double(Truncated(0.7 * ulp)), 0.0);
+    EXPECT_EQ(double(Nearest(0.7 * ulp)), ulp);
+}
+
+TEST(fp_test_case, division_by_zero_test) {
+    using Fixed8 = rndcmp::Fixed<std::int16_t, 8>;
+    const double max = std::numeric_limits<std::int16_t>::max() / 256.0;
+    const double min = std::numeric_limits<std::int16_t>::min() / 256.0;
+    // Saturates by the sign of the numerator instead of trapping
+    EXPECT_EQ(double(Fixed8(1) / Fixed8(0)), max);
+    EXPECT_EQ(double(Fixed8(-1) / Fixed8(0)), min);
+    EXPECT_EQ(double(Fixed8(0) / Fixed8(0)), 0.0);
+    EXPECT_EQ(double(Fixed8(3) / 0), max);
+    Fixed8 x(-2);
+    x /= 0u;
+    EXPECT_EQ(double(x), min);
+}
+
+TEST(fp_test_case, wide_integer_operand_test) {
+    using Fixed16 = rndcmp::Fixed<std::int32_t, 16>;
+    const std::uint64_t huge = std::uint64_t(1) << 63;
+    // Divisors beyond the range of the operands do not wrap to negative values
+    EXPECT_EQ(double(Fixed16(5) / huge), 0.0);
+    EXPECT_EQ(double(Fixed16(-5) / huge), 0.0);
+    // Sums and products wrap like the same operations on int32_t
+    EXPECT_EQ(double(Fixed16(1.5) + (huge + 2)), 3.5);
+    EXPECT_EQ(double(Fixed16(1.5) * (huge + 2)), 3.0);
+    EXPECT_EQ(double((huge + 3) - Fixed16(0.5)), 2.5);
+}
+
 /* Fixed point stochastic test cases */
 
 TEST(fpsr_test_case, integer_precision_test)
@@ -161,3 +230,128 @@ TEST(fpsr_test_case, math_functions_test) {
     EXPECT_EQ(abs(rndcmp::FixedSR<std::int16_t, 8>(-2.5)), 2.5);
 }
 
+
+TEST(fpsr_test_case, integer_arithmetic_test) {
+    using FP = rndcmp::FixedSR<std::int32_t, 16>;
+    FP a(1.5);
+    FP b(-0.25);
+    // Sums, differences and products with integers are exact
+    EXPECT_EQ(static_cast<double>(a + b), 1.25);
+    EXPECT_EQ(static_cast<double>(b - a), -1.75);
+    EXPECT_EQ(static_cast<double>(a * 3), 4.5);
+    EXPECT_EQ(static_cast<double>(2 - a), 0.5);
+    EXPECT_EQ(static_cast<double>(-b), 0.25);
+    // Products of exactly representable values with few bits are exact as well
+    EXPECT_EQ(static_cast<double>(a * b), -0.375);
+    EXPECT_EQ(static_cast<double>(a / b), -6.0);
+    EXPECT_EQ(static_cast<double>(a / 3), 0.5);
+
+    rndcmp::FixedSR<std::int64_t, 40> big(3.0);
+    EXPECT_EQ(static_cast<double>(big * big), 9.0);
+    EXPECT_EQ(static_cast<double>(big / 2), 1.5);
+}
+
+template<typename FP>
+void check_stochastic_product(double lhs, double rhs) {
+    size_t N = 20000;
+    FP a(lhs);
+    FP b(rhs);
+    double exact = static_cast<double>(a) * static_cast<double>(b);
+    double ulp = 1.0 / (1 << 8);
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        double v = static_cast<double>(a * b);
+        EXPECT_TRUE(v == std::floor(exact / ulp) * ulp || v == std::ceil(exact / ulp) * ulp) << "received: " << v;
+        mean += v;
+    }
+    EXPECT_NEAR(mean / N, exact, ulp / 50) << lhs << " * " << rhs;
+}
+
+TEST(fpsr_test_case, stochastic_product_test) {
+    check_stochastic_product<rndcmp::FixedSR<std::int16_t, 8>>(0.33, 0.71);
+    check_stochastic_product<rndcmp::FixedSR<std::int16_t, 8>>(-0.33, 0.71);
+    check_stochastic_product<rndcmp::FixedSR<std::int16_t, 8>>(-1.17, -2.03);
+}
+
+TEST(fpsr_test_case, stochastic_quotient_test) {
+    using FP = rndcmp::FixedSR<std::int16_t, 8>;
+    size_t N = 20000;
+    for (double lhs : {1.0, -1.0}) {
+        FP a(lhs);
+        FP b(3.0);
+        double ulp = 1.0 / (1 << 8);
+        double mean = 0.0;
+        for (size_t i = 0; i < N; i++) {
+            mean += static_cast<double>(a / b);
+        }
+        EXPECT_NEAR(mean / N, lhs / 3.0, ulp / 50);
+    }
+
+    // Deterministic policy rounds to nearest
+    rndcmp::FixedSR<std::int16_t, 8, 2, rndcmp::NearestRng> one(1.0);
+    EXPECT_EQ(static_cast<double>(one / 3), 85.0 / 256.0);
+    EXPECT_EQ(static_cast<double>(-one / 3), -85.0 / 256.0);
+    EXPECT_EQ(static_cast<double>(one * rndcmp::FixedSR<std::int16_t, 8, 2, rndcmp::NearestRng>(0.75) / 3), 64.0 / 256.0);
+}
+
+TEST(fpsr_test_case, division_by_zero_test) {
+    using FP = rndcmp::FixedSR<std::int16_t, 8>;
+    const double max = std::numeric_limits<std::int16_t>::max() / 256.0;
+    const double min = std::numeric_limits<std::int16_t>::min() / 256.0;
+    EXPECT_EQ(static_cast<double>(FP(1.0) / FP(0.0)), max);
+    EXPECT_EQ(static_cast<double>(FP(-1.0) / FP(0.0)), min);
+    EXPECT_EQ(static_cast<double>(FP(0.0) / FP(0.0)), 0.0);
+    EXPECT_EQ(static_cast<double>(FP(0.5) / 0), max);
+    FP x(-0.5);
+    x /= std::uint64_t(0);
+    EXPECT_EQ(static_cast<double>(x), min);
+}
+
+TEST(fpsr_test_case, wide_integer_divisor_test) {
+    using FP = rndcmp::FixedSR<std::int32_t, 16>;
+    size_t N = 20000;
+    double ulp = 1.0 / (1 << 16);
+    // 2^30 ulp divided by 3 * 2^31 rounds up with probability 1/6, |den| is beyond 32 bits
+    FP a(16384.0);
+    std::int64_t d = std::int64_t(3) << 31;
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(a / d);
+    }
+    EXPECT_NEAR(mean / N, ulp / 6, ulp / 50);
+    EXPECT_LE(static_cast<double>(a / std::numeric_limits<std::int64_t>::min()), 0.0);
+    EXPECT_EQ(static_cast<double>(FP(1.5) * ((std::uint64_t(1) << 63) + 2)), 3.0);
+}
+
+TEST(fpsr_test_case, fma_test) {
+    using FP = rndcmp::FixedSR<std::int16_t, 8>;
+    double ulp = 1.0 / (1 << 8);
+    FP a(0.33), b(0.71), c(-1.17);
+    double exact = static_cast<double>(a) * static_cast<double>(b) + static_cast<double>(c);
+    size_t N = 20000;
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        double v = static_cast<double>(fma(a, b, c));
+        EXPECT_TRUE(v == std::floor(exact / ulp) * ulp || v == std::ceil(exact / ulp) * ulp) << "received: " << v;
+        mean += v / N;
+    }
+    EXPECT_NEAR(mean, exact, ulp / 50);
+
+    // With the deterministic policy the product is rounded to nearest and the sum is exact
+    using Nearest = rndcmp::FixedSR<std::int16_t, 8, 2, rndcmp::NearestRng>;
+    Nearest na(0.33), nb(0.71), nc(-1.17);
+    EXPECT_EQ(static_cast<double>(fma(na, nb, nc)), static_cast<double>(na * nb + nc));
+    EXPECT_EQ(static_cast<double>(fma(0.5, nb, nc)), static_cast<double>(Nearest(0.5 * static_cast<double>(nb) + static_cast<double>(nc))));
+
+    // A double multiplier stays in integers: 0.75 * (2^55 + 1) ulp = 3 * 2^53 + 0.75 ulp, which double cannot hold
+    using Wide = rndcmp::FixedSR<std::int64_t, 8>;
+    Wide wide_b = Wide(std::int64_t(1) << 47) + Wide(ulp);
+    Wide base(std::int64_t(3) << 45);
+    mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(fma(0.75, wide_b, Wide(0)) - base) / N;
+    }
+    EXPECT_NEAR(mean, 0.75 * ulp, ulp / 50);
+    EXPECT_EQ(static_cast<double>(fma(-3.0, FP(0.5), FP(1.0))), -0.5);
+    EXPECT_EQ(static_cast<double>(fma(1e-30, FP(0.5), FP(1.0))), 1.0);
+}
@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "floatsr.hpp"
@@ -127,3 +133,142 @@ TEST(floatsr_test_case, math_functions_test) {
 
     EXPECT_EQ(abs(rndcmp::FloatSR(-2.5)), 2.5);
 }
+
+TEST(floatsr_test_case, array_kernels_test) {
+    // Every SIMD kernel the CPU supports must match the scalar one bit for bit
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<double> dist(-10.0, 10.0);
+    size_t N = 1000;
+    std::vector<double> src(N);
+    std::vector<uint32_t> words(N);
+    for (size_t i = 0; i < N; i++) {
+        src[i] = dist(gen);
+        words[i] = gen();
+    }
+    std::vector<double> special = {
+        0.0, -0.0, 1e300, -1e300, 1e-300, 1e-40, static_cast<double>(rndcmp::float_max) * (1 + 1e-12),
+        std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()
+    };
+    std::copy(special.begin(), special.end(), src.begin() + 100);
+
+    std::vector<float> expected(N);
+    rndcmp::detail::round_to_float(rndcmp::simd::Isa::Scalar, src.data(), words.data(), expected.data(), N);
+    for (auto isa : {rndcmp::simd::Isa::Avx2, rndcmp::simd::Isa::Avx512}) {
+        if (rndcmp::simd::cpu_isa() < isa) {
+            continue;
+        }
+        std::vector<float> actual(N);
+        rndcmp::detail::round_to_float(isa, src.data(), words.data(), actual.data(), N);
+        for (size_t i = 0; i < N; i++) {
+            EXPECT_EQ(expected[i], actual[i]) << "isa: " << static_cast<int>(isa) << ", value: " << src[i];
+        }
+    }
+
+    std::vector<double> nan = {std::numeric_limits<double>::quiet_NaN()};
+    std::vector<float> nan_result(1);
+    rndcmp::round_sr(nan.data(), nan_result.data(), 1);
+    EXPECT_TRUE(std::isnan(nan_result[0]));
+}
+
+TEST(floatsr_test_case, array_rounding_test) {
+    size_t N = 100000;
+    double expected = 1.0 / 3.0;
+    std::vector<double> src(N, expected);
+    std::vector<rndcmp::FloatSR> dst(N);
+    rndcmp::round_sr(src.data(), dst.data(), N);
+    float nearest_value = static_cast<float>(expected);
+    float down = nearest_value > expected ? std::nextafter(nearest_value, 0.0f) : nearest_value;
+    float up = std::nextafter(down, 1.0f);
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        float v = static_cast<float>(dst[i]);
+        EXPECT_TRUE(v == down || v == up) << "received: " << v;
+        mean += static_cast<double>(v);
+    }
+    EXPECT_NEAR(mean / N, expected, 1e-9);
+
+    std::vector<rndcmp::BasicFloatSR<rndcmp::NearestRng>> nearest(N);
+    rndcmp::round_sr(src.data(), nearest.data(), N);
+    EXPECT_EQ(static_cast<float>(nearest[N - 1]), static_cast<float>(expected));
+}
+
+// Counts the thresholds drawn, each one is a rounding
+struct CountingRng {
+    static inline std::size_t draws = 0;
+
+    template<int BITS>
+    static std::uint32_t bits() {
+        draws++;
+        return rndcmp::NearestRng::bits<BITS>();
+    }
+
+    static double uniform() {
+        draws++;
+        return rndcmp::NearestRng::uniform();
+    }
+
+    static void words(std::uint32_t* out, std::size_t n) {
+        draws += n;
+        rndcmp::NearestRng::words(out, n);
+    }
+};
+
+// Always the lowest threshold: rounds up whenever the value is above the lower neighbour
+struct LowestRng {
+    static constexpr bool is_stochastic = true;
+
+    template<int BITS>
+    static std::uint32_t bits() {
+        return 0;
+    }
+
+    static double uniform() {
+        return 0.0;
+    }
+
+    static void words(std::uint32_t* out, std::size_t n) {
+        std::fill(out, out + n, 0u);
+    }
+};
+
+TEST(floatsr_test_case, fma_test) {
+    // (1 + 2^-23)^2 - (1 + 2^-22) = 2^-46 is lost when the product is rounded before the sum
+    double eps = std::ldexp(1.0, -23);
+    rndcmp::FloatSR a(1.0 + eps), c(-(1.0 + 2 * eps));
+    EXPECT_EQ(static_cast<double>(fma(a, a, c)), std::ldexp(1.0, -46));
+    EXPECT_EQ(static_cast<double>(fma(1.0 + eps, a, c)), std::ldexp(1.0, -46));
+    using Nearest = rndcmp::BasicFloatSR<rndcmp::NearestRng>;
+    Nearest nearest_a(static_cast<float>(a)), nearest_c(static_cast<float>(c));
+    EXPECT_EQ(static_cast<double>(fma(nearest_a, nearest_a, nearest_c)), std::ldexp(1.0, -46));
+    EXPECT_EQ(static_cast<double>(nearest_a * nearest_a + nearest_c), 0.0);
+
+    using Counted = rndcmp::BasicFloatSR<CountingRng>;
+    Counted x(0.1f), y(0.3f), z(0.7f);
+    CountingRng::draws = 0;
+    Counted fused = fma(x, y, z);
+    EXPECT_EQ(CountingRng::draws, 1);
+    Counted separate = x * y + z;
+    EXPECT_EQ(CountingRng::draws, 3);
+    EXPECT_NEAR(static_cast<double>(separate), static_cast<double>(fused), 1e-7);
+    EXPECT_EQ(static_cast<float>(fused), std::fma(0.1f, 0.3f, 0.7f));
+
+    // 1 + 2^-60 is 1 in double: the rest beyond it still rounds up on the lowest threshold, and the rest
+    // below it does not
+    using Lowest = rndcmp::BasicFloatSR<LowestRng>;
+    double tiny = std::ldexp(1.0, -30);
+    EXPECT_EQ(static_cast<double>(fma(Lowest(tiny), Lowest(tiny), Lowest(1.0f))), 1.0 + eps);
+    EXPECT_EQ(static_cast<double>(fma(tiny * tiny, Lowest(1.0f), Lowest(1.0f))), 1.0 + eps);
+    EXPECT_EQ(static_cast<double>(fma(-tiny, Lowest(tiny), Lowest(1.0f))), 1.0);
+    EXPECT_EQ(static_cast<double>(fma(-tiny, Lowest(-tiny), Lowest(-1.0f))), -1.0);
+    EXPECT_EQ(static_cast<double>(fma(tiny, Lowest(-tiny), Lowest(-1.0f))), -1.0 - eps);
+
+    // The single rounding is unbiased
+    size_t N = 20000;
+    rndcmp::FloatSR sx(0.1f), sy(0.3f), sz(0.7f);
+    double exact = static_cast<double>(0.1f) * static_cast<double>(0.3f) + static_cast<double>(0.7f);
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(fma(sx, sy, sz)) / N;
+    }
+    EXPECT_NEAR(mean, exact, 1e-9);
+}
@@ -0,0 +1,119 @@
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "fp8.hpp"
+#include "esn.hpp"
+#include "integrator.hpp"
+
+
+TEST(fp8_test_case, size_test) {
+    EXPECT_EQ(sizeof(rndcmp::float8_e4m3), 1);
+    EXPECT_EQ(sizeof(rndcmp::float8_e5m2sr), 1);
+}
+
+TEST(fp8_test_case, e4m3_codes_test) {
+    using T = rndcmp::float8_e4m3;
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x7e)), 448.0);
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0xfe)), -448.0);
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x78)), 256.0);
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x38)), 1.0);
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x08)), std::ldexp(1.0, -6));
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x01)), std::ldexp(1.0, -9));
+    EXPECT_TRUE(isnan(T::fromRaw(0x7f)));
+    EXPECT_TRUE(isnan(T::fromRaw(0xff)));
+    EXPECT_TRUE(std::isnan(static_cast<float>(T::fromRaw(0x7f))));
+    for (std::uint32_t code = 0; code < 256; code++) {
+        T value = T::fromRaw(static_cast<std::uint8_t>(code));
+        if ((code & 0x7f) == 0x7f) {
+            continue;
+        }
+        EXPECT_TRUE(isfinite(value)) << code;
+        EXPECT_EQ(T(static_cast<double>(value)).raw(), code) << code;
+    }
+
+    // No infinities: everything beyond the range saturates
+    EXPECT_EQ(static_cast<double>(T(1e6)), 448.0);
+    EXPECT_EQ(static_cast<double>(T(-std::numeric_limits<double>::infinity())), -448.0);
+    EXPECT_TRUE(isnan(T(std::numeric_limits<double>::quiet_NaN())));
+    EXPECT_EQ(static_cast<double>(Eigen::NumTraits<T>::highest()), 448.0);
+}
+
+TEST(fp8_test_case, e5m2_codes_test) {
+    using T = rndcmp::float8_e5m2;
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x7b)), 57344.0);
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x3c)), 1.0);
+    EXPECT_EQ(static_cast<double>(T::fromRaw(0x01)), std::ldexp(1.0, -16));
+    EXPECT_TRUE(isinf(T::fromRaw(0x7c)));
+    EXPECT_TRUE(isinf(T::fromRaw(0xfc)));
+    EXPECT_TRUE(isnan(T::fromRaw(0x7d)));
+    EXPECT_TRUE(isinf(T(std::numeric_limits<double>::infinity())));
+    EXPECT_EQ(static_cast<double>(T(1e6)), 57344.0);
+}
+
+TEST(fp8_test_case, rounding_test) {
+    // Nearest: 1.1 lies between 1 and 1.125 for E4M3, between 1 and 1.25 for E5M2
+    EXPECT_EQ(static_cast<double>(rndcmp::float8_e4m3(1.1)), 1.125);
+    EXPECT_EQ(static_cast<double>(rndcmp::float8_e5m2(1.1)), 1.0);
+
+    size_t N = 20000;
+    for (double x : {1.1, -0.37, 300.0, std::ldexp(1.3, -9)}) {
+        double mean_e4m3 = 0.0, mean_e5m2 = 0.0;
+        for (size_t i = 0; i < N; i++) {
+            mean_e4m3 += static_cast<double>(rndcmp::float8_e4m3sr(x)) / N;
+            mean_e5m2 += static_cast<double>(rndcmp::float8_e5m2sr(x)) / N;
+        }
+        EXPECT_NEAR(mean_e4m3, x, std::abs(x) * 0.01) << x;
+        EXPECT_NEAR(mean_e5m2, x, std::abs(x) * 0.02) << x;
+    }
+}
+
+TEST(fp8_test_case, array_test) {
+    std::vector<double> src = {0.1, -2.7, 500.0, 1e-4, 0.0, -0.0, 3.0};
+    std::vector<rndcmp::float8_e4m3> dst(src.size());
+    std::vector<float> back(src.size());
+    rndcmp::round_sr(src.data(), dst.data(), src.size());
+    rndcmp::convert(dst.data(), back.data(), src.size());
+    for (size_t i = 0; i < src.size(); i++) {
+        EXPECT_EQ(dst[i].raw(), rndcmp::float8_e4m3(src[i]).raw()) << src[i];
+        EXPECT_EQ(back[i], static_cast<float>(dst[i])) << src[i];
+    }
+}
+
+// The types drop into the library's models
+TEST(fp8_test_case, models_test) {
+    using T = rndcmp::float8_e5m2sr;
+    rndcmp::system_type<T> system = {
+        [](const std::vector<T>& x, double) { return T(-static_cast<double>(x[0])); }
+    };
+    rndcmp::system_type<double> reference_system = {
+        [](const std::vector<double>& x, double) { return -x[0]; }
+    };
+    rndcmp::RK4Integrator<double> reference(reference_system, 0.0, 1.0, 0.1);
+    reference.setInitial({1.0});
+    reference.solve();
+
+    // A single run is noisy at 2 mantissa bits, the mean of the runs follows the exact solution
+    double mean = 0.0;
+    int runs = 200;
+    for (int i = 0; i < runs; i++) {
+        rndcmp::RK4Integrator<T> integrator(system, 0.0, 1.0, 0.1);
+        integrator.setInitial({T(1.0)});
+        integrator.solve();
+        mean += static_cast<double>(integrator.getSolution().back()[0]) / runs;
+    }
+    EXPECT_NEAR(mean, reference.getSolution().back()[0], 0.05);
+
+    rndcmp::ESN<rndcmp::float8_e4m3sr> esn(1, 16, 1, 0.9, 0.5, 1e-6, 1);
+    rndcmp::ESN<rndcmp::float8_e4m3sr>::ESNMatrix inputs(40, 1), outputs(40, 1);
+    for (int i = 0; i < 40; i++) {
+        inputs(i, 0) = std::sin(0.2 * i);
+        outputs(i, 0) = std::sin(0.2 * (i + 1));
+    }
+    double error = esn.fit(inputs, outputs);
+    EXPECT_TRUE(std::isfinite(error));
+    EXPECT_LT(error, 1.0);
+}
@@ -0,0 +1,135 @@
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+#include "gtest/gtest.h"
+#include "types.hpp"
+#include "gemm.hpp"
+
+
+using NearestFloat = rndcmp::BasicFloatSR<rndcmp::NearestRng>;
+using NearestFixed = rndcmp::FixedSR<std::int32_t, 16, 2, rndcmp::NearestRng>;
+
+template<typename T>
+using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+template<typename T>
+Matrix<T> random_matrix(int rows, int cols) {
+    Eigen::MatrixXd values = Eigen::MatrixXd::Random(rows, cols) * 0.5;
+    Matrix<T> result(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            result(i, j) = T(values(i, j));
+        }
+    }
+    return result;
+}
+
+template<typename MATRIX>
+Eigen::MatrixXd to_double(const MATRIX& m) {
+    Eigen::MatrixXd result(m.rows(), m.cols());
+    for (int i = 0; i < m.rows(); i++) {
+        for (int j = 0; j < m.cols(); j++) {
+            result(i, j) = static_cast<double>(m(i, j));
+        }
+    }
+    return result;
+}
+
+rndcmp::GemmOptions options(rndcmp::GemmRounding rounding, rndcmp::GemmAccumulator accumulator, unsigned threads = 1) {
+    rndcmp::GemmOptions result;
+    result.rounding = rounding;
+    result.accumulator = accumulator;
+    result.k_block = 16;
+    result.threads = threads;
+    return result;
+}
+
+template<typename T>
+void check_against_double(double tolerance) {
+    // Sizes that are not multiples of the blocks
+    Matrix<T> a = random_matrix<T>(133, 41), b = random_matrix<T>(41, 7), x = random_matrix<T>(41, 1);
+    Eigen::MatrixXd expected = to_double(a) * to_double(b), expected_gemv = to_double(a) * to_double(x);
+    for (auto rounding : {rndcmp::GemmRounding::EveryOp, rndcmp::GemmRounding::Once, rndcmp::GemmRounding::PerBlock}) {
+        for (auto accumulator : {rndcmp::GemmAccumulator::Float32, rndcmp::GemmAccumulator::Float64}) {
+            for (unsigned threads : {1u, 3u}) {
+                auto config = options(rounding, accumulator, threads);
+                EXPECT_LT((to_double(rndcmp::multiply(a, b, config)) - expected).cwiseAbs().maxCoeff(), tolerance);
+                EXPECT_LT((to_double(rndcmp::multiply(a, x, config)) - expected_gemv).cwiseAbs().maxCoeff(), tolerance);
+            }
+        }
+    }
+}
+
+TEST(gemm_test_case, accuracy_test) {
+    check_against_double<rndcmp::FloatSR>(1e-5);
+    check_against_double<rndcmp::bfloat16sr>(0.1);
+    check_against_double<rndcmp::FixedSR<std::int32_t, 16>>(1e-3);
+    check_against_double<half_float::halfsr>(0.05);
+    check_against_double<double>(1e-6);
+}
+
+// With NearestRng every mode has a deterministic reference computed with the scalar operators
+template<typename T>
+void check_rounding_points() {
+    int k = 37;
+    Matrix<T> a = random_matrix<T>(19, k), b = random_matrix<T>(k, 5);
+    Matrix<T> every_op = rndcmp::multiply(a, b, options(rndcmp::GemmRounding::EveryOp, rndcmp::GemmAccumulator::Float64));
+    Matrix<T> once = rndcmp::multiply(a, b, options(rndcmp::GemmRounding::Once, rndcmp::GemmAccumulator::Float64));
+    Matrix<T> per_block = rndcmp::multiply(a, b, options(rndcmp::GemmRounding::PerBlock, rndcmp::GemmAccumulator::Float64));
+    for (int i = 0; i < a.rows(); i++) {
+        for (int j = 0; j < b.cols(); j++) {
+            T sum = a(i, 0) * b(0, j);
+            double exact = 0.0, block = 0.0;
+            T blocked(0.0);
+            for (int p = 0; p < k; p++) {
+                if (p > 0) {
+                    sum = sum + a(i, p) * b(p, j);
+                }
+                exact += static_cast<double>(a(i, p)) * static_cast<double>(b(p, j));
+                block += static_cast<double>(a(i, p)) * static_cast<double>(b(p, j));
+                if ((p + 1) % 16 == 0 || p + 1 == k) {
+                    blocked = T(static_cast<double>(blocked) + block);
+                    block = 0.0;
+                }
+            }
+            EXPECT_EQ(static_cast<double>(every_op(i, j)), static_cast<double>(sum)) << i << ", " << j;
+            EXPECT_EQ(static_cast<double>(once(i, j)), static_cast<double>(T(exact))) << i << ", " << j;
+            EXPECT_EQ(static_cast<double>(per_block(i, j)), static_cast<double>(blocked)) << i << ", " << j;
+        }
+    }
+}
+
+TEST(gemm_test_case, rounding_points_test) {
+    check_rounding_points<NearestFloat>();
+    check_rounding_points<NearestFixed>();
+}
+
+TEST(gemm_test_case, thread_replay_test) {
+    Matrix<rndcmp::FloatSR> a = random_matrix<rndcmp::FloatSR>(64, 64), x = random_matrix<rndcmp::FloatSR>(64, 1);
+    for (unsigned threads : {1u, 4u}) {
+        auto config = options(rndcmp::GemmRounding::EveryOp, rndcmp::GemmAccumulator::Float64, threads);
+        rndcmp::seed(11);
+        Matrix<rndcmp::FloatSR> first = rndcmp::multiply(a, a, config), first_gemv = rndcmp::multiply(a, x, config);
+        rndcmp::seed(11);
+        Matrix<rndcmp::FloatSR> second = rndcmp::multiply(a, a, config), second_gemv = rndcmp::multiply(a, x, config);
+        EXPECT_EQ(to_double(first), to_double(second)) << threads;
+        EXPECT_EQ(to_double(first_gemv), to_double(second_gemv)) << threads;
+    }
+}
+
+TEST(gemm_test_case, stochastic_test) {
+    // The rounding is stochastic in every mode, so the mean of repeated products approaches the exact one
+    Matrix<rndcmp::bfloat16sr> a = random_matrix<rndcmp::bfloat16sr>(1, 64), b = random_matrix<rndcmp::bfloat16sr>(64, 1);
+    double exact = (to_double(a) * to_double(b))(0, 0);
+    for (auto rounding : {rndcmp::GemmRounding::EveryOp, rndcmp::GemmRounding::Once, rndcmp::GemmRounding::PerBlock}) {
+        auto config = options(rounding, rndcmp::GemmAccumulator::Float64);
+        double mean = 0.0;
+        int runs = 2000;
+        for (int i = 0; i < runs; i++) {
+            mean += static_cast<double>(rndcmp::multiply(a, b, config)(0, 0)) / runs;
+        }
+        EXPECT_NEAR(mean, exact, 2e-3);
+    }
+}
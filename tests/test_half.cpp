@@ -1,4 +1,8 @@
+#include <cmath>
 #include <iostream>
+#include <cstring>
+#include <random>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "half.hpp"
@@ -72,3 +76,114 @@ TEST(halfsr_test_case, operators_test) {
 
     EXPECT_EQ(val < val2, true);
 }
+
+/* Array conversion test cases */
+
+TEST(half_test_case, array_kernels_test) {
+    // Every SIMD kernel the CPU supports must match the scalar one bit for bit,
+    // including subnormals, overflow and signalling NaNs
+    std::mt19937 gen(11);
+    std::vector<float> src;
+    for (uint32_t exponent = 0; exponent < 256; exponent++) {
+        for (uint32_t sign = 0; sign < 2; sign++) {
+            for (size_t i = 0; i < 8; i++) {
+                uint32_t bits = (sign << 31) | (exponent << 23) | (gen() & 0x7fffff);
+                float v;
+                memcpy(&v, &bits, sizeof(v));
+                src.push_back(v);
+            }
+        }
+    }
+    for (uint32_t bits : {0x7f800001u, 0xffa00000u, 0x7fc00000u, 0x477fefffu, 0x477ff000u, 0x387fe000u}) {
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        src.push_back(v);
+    }
+    size_t N = src.size();
+    std::vector<uint32_t> words(N);
+    for (auto& w : words) {
+        w = gen();
+    }
+    std::vector<uint16_t> patterns(1 << 16);
+    for (size_t i = 0; i < patterns.size(); i++) {
+        patterns[i] = static_cast<uint16_t>(i);
+    }
+
+    std::vector<uint16_t> packed(N);
+    std::vector<float> unpacked(patterns.size());
+    rndcmp::detail::halfsr_pack(rndcmp::simd::Isa::Scalar, src.data(), words.data(), packed.data(), N);
+    rndcmp::detail::half_unpack(rndcmp::simd::Isa::Scalar, patterns.data(), unpacked.data(), patterns.size());
+    for (auto isa : {rndcmp::simd::Isa::Avx2, rndcmp::simd::Isa::Avx512}) {
+        if (rndcmp::simd::cpu_isa() < isa) {
+            continue;
+        }
+        std::vector<uint16_t> actual(N);
+        rndcmp::detail::halfsr_pack(isa, src.data(), words.data(), actual.data(), N);
+        for (size_t i = 0; i < N; i++) {
+            EXPECT_EQ(packed[i], actual[i]) << "isa: " << static_cast<int>(isa) << ", value: " << src[i];
+        }
+        std::vector<float> actual_unpacked(patterns.size());
+        rndcmp::detail::half_unpack(isa, patterns.data(), actual_unpacked.data(), patterns.size());
+        EXPECT_EQ(0, memcmp(unpacked.data(), actual_unpacked.data(), unpacked.size() * sizeof(float)))
+            << "isa: " << static_cast<int>(isa);
+    }
+}
+
+TEST(half_test_case, array_conversion_test) {
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+    size_t N = 1001;
+    std::vector<float> src(N);
+    for (auto& v : src) {
+        v = dist(gen);
+    }
+    std::vector<half_float::basic_halfsr<rndcmp::NearestRng>> nearest(N);
+    rndcmp::round_sr(src.data(), nearest.data(), N);
+    std::vector<float> back(N);
+    rndcmp::convert(nearest.data(), back.data(), N);
+    for (size_t i = 0; i < N; i++) {
+        half_float::basic_halfsr<rndcmp::NearestRng> expected(src[i]);
+        EXPECT_EQ(back[i], static_cast<float>(expected)) << "value: " << src[i];
+    }
+
+    float value = 1.0f / 3.0f;
+    size_t M = 100000;
+    std::vector<float> thirds(M, value);
+    std::vector<half_float::halfsr> rounded(M);
+    rndcmp::round_sr(thirds.data(), rounded.data(), M);
+    std::vector<float> rounded_back(M);
+    rndcmp::convert(rounded.data(), rounded_back.data(), M);
+    double mean = 0.0;
+    for (float v : rounded_back) {
+        mean += v;
+    }
+    EXPECT_NEAR(mean / M, value, 1e-5);
+}
+
+TEST(halfsr_test_case, fma_test) {
+    // (1 + 2^-10)^2 - (1 + 2^-9) = 2^-20 is lost when the product is rounded before the sum
+    double eps = std::ldexp(1.0, -10);
+    half_float::halfsr a(static_cast<float>(1.0 + eps)), c(static_cast<float>(-(1.0 + 2 * eps)));
+    EXPECT_EQ(static_cast<double>(fma(a, a, c)), std::ldexp(1.0, -20));
+    EXPECT_EQ(static_cast<double>(fma(1.0 + eps, a, c)), std::ldexp(1.0, -20));
+    using Nearest = half_float::basic_halfsr<rndcmp::NearestRng>;
+    Nearest nearest_a(static_cast<float>(a)), nearest_c(static_cast<float>(c));
+    Nearest product(static_cast<float>(nearest_a) * static_cast<float>(nearest_a));
+    EXPECT_EQ(static_cast<float>(product) + static_cast<float>(nearest_c), 0.0f);
+
+    // The single rounding is unbiased
+    size_t N = 20000;
+    half_float::halfsr x(0.1f), y(0.3f), z(0.7f);
+    double exact = static_cast<double>(x) * static_cast<double>(y) + static_cast<double>(z);
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(fma(x, y, z)) / N;
+    }
+    EXPECT_NEAR(mean, exact, 2e-5);
+
+    // 1 + 2^-11 + 2^-30 is past the middle of the step, as float it would be exactly the middle
+    Nearest one(1.0f), zero(0.0f);
+    EXPECT_EQ(static_cast<double>(fma(1.0 + std::ldexp(1.0, -11) + std::ldexp(1.0, -30), one, zero)), 1.0 + eps);
+    // Subnormal halfs are rounded from the exact value as well
+    EXPECT_EQ(static_cast<double>(fma(0.75 * std::ldexp(1.0, -24), one, zero)), std::ldexp(1.0, -24));
+}
@@ -0,0 +1,662 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "random.hpp"
+#include "types.hpp"
+#include "integrator.hpp"
+#include "esn.hpp"
+#include "ensemble.hpp"
+#include "static_integrator.hpp"
+
+
+template<typename T>
+rndcmp::system_type<T> lorenz_system() {
+    return {
+        [](const std::vector<T>& x, double) { return T(10.0 * (x[1] - x[0])); },
+        [](const std::vector<T>& x, double) { return T(x[0] * (28.0 - x[2]) - x[1]); },
+        [](const std::vector<T>& x, double) { return T(x[0] * x[1] - 8.0 / 3.0 * x[2]); }
+    };
+}
+
+// Step of the integrator written out with fresh vectors for every stage
+template<typename T>
+std::vector<T> rk4_reference_step(const rndcmp::system_type<T>& system, const std::vector<T>& x, double t, double h) {
+    auto f = [&system](const std::vector<T>& y, double time) {
+        std::vector<T> result;
+        for (const auto& func : system) {
+            result.push_back(T(func(y, time)));
+        }
+        return result;
+    };
+    auto shifted = [&x](double step, const std::vector<T>& k) {
+        std::vector<T> result;
+        for (size_t i = 0; i < x.size(); i++) {
+            result.push_back(T(x[i] + step * k[i]));
+        }
+        return result;
+    };
+    std::vector<T> k1 = f(x, t);
+    std::vector<T> k2 = f(shifted(h / 2., k1), t + h / 2.);
+    std::vector<T> k3 = f(shifted(h / 2., k2), t + h / 2.);
+    std::vector<T> k4 = f(shifted(h, k3), t + h);
+    std::vector<T> result;
+    for (size_t i = 0; i < x.size(); i++) {
+        result.push_back(T(x[i] + h / 6. * (k1[i] + 2. * k2[i] + 2. * k3[i] + k4[i])));
+    }
+    return result;
+}
+
+TEST(integrator_test_case, rk4_reference_test) {
+    auto system = lorenz_system<double>();
+    rndcmp::RK4Integrator<double> integrator(system, 0.0, 1.0, 0.01);
+    integrator.setInitial({1.0, 1.0, 1.0});
+    integrator.solve();
+    auto solution = integrator.getSolution();
+
+    std::vector<double> x = {1.0, 1.0, 1.0};
+    ASSERT_GT(solution.size(), 100);
+    EXPECT_EQ(solution[0], x);
+    double t = 0.0;
+    for (size_t i = 1; i < solution.size(); i++, t += 0.01) {
+        x = rk4_reference_step(system, x, t, 0.01);
+        EXPECT_EQ(solution[i], x) << i;
+    }
+}
+
+TEST(integrator_test_case, euler_reference_test) {
+    rndcmp::system_type<double> system = {
+        [](const std::vector<double>& x, double) { return x[1]; },
+        [](const std::vector<double>& x, double t) { return -x[0] + t; }
+    };
+    rndcmp::EulerIntegrator<double> integrator(system, 0.0, 1.0, 0.1);
+    integrator.setInitial({1.0, 0.0});
+    integrator.solve();
+    auto solution = integrator.getSolution();
+
+    std::vector<double> x = {1.0, 0.0};
+    double t = 0.0;
+    for (size_t i = 1; i < solution.size(); i++, t += 0.1) {
+        x = {x[0] + 0.1 * x[1], x[1] + 0.1 * (-x[0] + t)};
+        EXPECT_EQ(solution[i], x) << i;
+    }
+}
+
+// The buffers kept between steps do not leak state from one solve into the next
+TEST(integrator_test_case, repeated_solve_test) {
+    rndcmp::RK4Integrator<rndcmp::FloatSR> integrator(lorenz_system<rndcmp::FloatSR>(), 0.0, 1.0, 0.01);
+    integrator.setInitial({1.0f, 1.0f, 1.0f});
+    rndcmp::seed(11);
+    integrator.solve();
+    auto first = integrator.getSolution();
+    integrator.solve();
+    EXPECT_EQ(integrator.getSolution().size(), first.size());
+
+    rndcmp::seed(11);
+    integrator.solve();
+    auto replay = integrator.getSolution();
+    ASSERT_EQ(replay.size(), first.size());
+    for (size_t i = 0; i < first.size(); i++) {
+        for (size_t j = 0; j < first[i].size(); j++) {
+            EXPECT_EQ(static_cast<float>(replay[i][j]), static_cast<float>(first[i][j]));
+        }
+    }
+
+    integrator.setInitial({2.0f, 0.0f, 0.0f});
+    integrator.solve();
+    EXPECT_EQ(static_cast<float>(integrator.getSolution()[0][0]), 2.0f);
+    EXPECT_NE(static_cast<float>(integrator.getSolution().back()[0]), static_cast<float>(first.back()[0]));
+}
+
+template<typename T>
+struct Lorenz {
+    void operator()(const std::vector<T>& x, double, std::vector<T>& dxdt) const {
+        dxdt[0] = T(10.0 * (x[1] - x[0]));
+        dxdt[1] = T(x[0] * (28.0 - x[2]) - x[1]);
+        dxdt[2] = T(x[0] * x[1] - 8.0 / 3.0 * x[2]);
+    }
+};
+
+template<typename T>
+void expect_same_solution(const std::vector<std::vector<T>>& a, const std::vector<std::vector<T>>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < a[i].size(); j++) {
+            EXPECT_EQ(static_cast<double>(a[i][j]), static_cast<double>(b[i][j])) << i;
+        }
+    }
+}
+
+// The in-place system gives the same trajectory as the vector of per-component functions
+TEST(integrator_test_case, callable_system_test) {
+    rndcmp::RK4Integrator<double> components(lorenz_system<double>(), 0.0, 1.0, 0.01);
+    rndcmp::RK4Integrator<double, Lorenz<double>> functor(Lorenz<double>(), 0.0, 1.0, 0.01);
+    components.setInitial({1.0, 1.0, 1.0});
+    functor.setInitial({1.0, 1.0, 1.0});
+    components.solve();
+    functor.solve();
+    expect_same_solution(components.getSolution(), functor.getSolution());
+
+    using T = rndcmp::FloatSR;
+    auto lambda = rndcmp::make_rk4_integrator<T>([](const auto& x, double t, auto& dxdt) { Lorenz<T>()(x, t, dxdt); }, 0.0, 1.0, 0.01);
+    rndcmp::RK4Integrator<T> components_sr(lorenz_system<T>(), 0.0, 1.0, 0.01);
+    lambda.setInitial({1.0f, 1.0f, 1.0f});
+    components_sr.setInitial({1.0f, 1.0f, 1.0f});
+    rndcmp::seed(3);
+    lambda.solve();
+    rndcmp::seed(3);
+    components_sr.solve();
+    expect_same_solution(components_sr.getSolution(), lambda.getSolution());
+
+    auto euler = rndcmp::make_euler_integrator<double>(Lorenz<double>(), 0.0, 1.0, 0.01);
+    rndcmp::EulerIntegrator<double> euler_components(lorenz_system<double>(), 0.0, 1.0, 0.01);
+    euler.setInitial({1.0, 1.0, 1.0});
+    euler_components.setInitial({1.0, 1.0, 1.0});
+    euler.solve();
+    euler_components.solve();
+    expect_same_solution(euler_components.getSolution(), euler.getSolution());
+}
+
+TEST(integrator_test_case, initial_size_test) {
+    rndcmp::RK4Integrator<double> integrator(lorenz_system<double>(), 0.0, 1.0, 0.01);
+    EXPECT_THROW(integrator.setInitial({1.0, 1.0}), rndcmp::RK4Integrator<double>::IntegratorException);
+    EXPECT_NO_THROW(integrator.setInitial({1.0, 1.0, 1.0}));
+}
+
+TEST(integrator_test_case, sinks_test) {
+    rndcmp::RK4Integrator<double> integrator(lorenz_system<double>(), 0.0, 1.0, 0.01);
+    integrator.setInitial({1.0, 1.0, 1.0});
+    integrator.solve();
+    auto solution = integrator.getSolution();
+
+    // Every sink sees the same points as the stored solution
+    rndcmp::FlatSink<double> flat;
+    integrator.solve(flat);
+    ASSERT_EQ(flat.rows(), solution.size());
+    EXPECT_EQ(flat.dimension(), 3);
+    EXPECT_EQ(flat.times()[0], 0.0);
+    EXPECT_NEAR(flat.times()[1], 0.01, 1e-15);
+    for (size_t i = 0; i < solution.size(); i++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_EQ(flat(i, j), solution[i][j]);
+        }
+    }
+
+    rndcmp::FlatSink<double> every_ten;
+    rndcmp::DecimatingSink<rndcmp::FlatSink<double>> decimating(every_ten, 10);
+    integrator.solve(decimating);
+    ASSERT_EQ(every_ten.rows(), (solution.size() + 9) / 10);
+    for (size_t i = 0; i < every_ten.rows(); i++) {
+        EXPECT_EQ(every_ten(i, 2), solution[i * 10][2]);
+    }
+
+    rndcmp::StatisticsSink statistics;
+    integrator.solve(statistics);
+    ASSERT_EQ(statistics.count(), solution.size());
+    double mean = 0.0, min = solution[0][0], max = solution[0][0];
+    for (const auto& x : solution) {
+        mean += x[0] / solution.size();
+        min = std::min(min, x[0]);
+        max = std::max(max, x[0]);
+    }
+    double variance = 0.0;
+    for (const auto& x : solution) {
+        variance += (x[0] - mean) * (x[0] - mean) / (solution.size() - 1);
+    }
+    EXPECT_NEAR(statistics.mean()[0], mean, 1e-12);
+    EXPECT_NEAR(statistics.variance()[0], variance, 1e-10);
+    EXPECT_EQ(statistics.min()[0], min);
+    EXPECT_EQ(statistics.max()[0], max);
+
+    std::string path = ::testing::TempDir() + "rndcmp_sink_test.bin";
+    {
+        rndcmp::BinaryFileSink file(path);
+        integrator.solve(file);
+        EXPECT_EQ(file.records(), solution.size());
+    }
+    std::ifstream input(path, std::ios::binary);
+    std::vector<double> record(4);
+    for (size_t i = 0; i < solution.size(); i++) {
+        ASSERT_TRUE(input.read(reinterpret_cast<char*>(record.data()), record.size() * sizeof(double)));
+        EXPECT_EQ(record[0], flat.times()[i]);
+        EXPECT_EQ(std::vector<double>(record.begin() + 1, record.end()), solution[i]);
+    }
+    EXPECT_FALSE(input.read(reinterpret_cast<char*>(record.data()), sizeof(double)));
+    input.close();
+    std::remove(path.c_str());
+}
+
+template<int LAYOUT>
+void check_trajectory(const std::vector<std::vector<double>>& solution, rndcmp::Trajectory<double, LAYOUT>& trajectory) {
+    ASSERT_EQ(trajectory.rows(), solution.size());
+    ASSERT_EQ(trajectory.dimension(), 3);
+    auto view = trajectory.matrix();
+    auto every_seven = trajectory.matrix(7);
+    ASSERT_EQ(every_seven.rows(), (solution.size() + 6) / 7);
+    for (size_t i = 0; i < solution.size(); i++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_EQ(trajectory(i, j), solution[i][j]);
+            EXPECT_EQ(view(i, j), solution[i][j]);
+            if (i % 7 == 0) {
+                EXPECT_EQ(every_seven(i / 7, j), solution[i][j]);
+            }
+        }
+    }
+    // The view points into the trajectory
+    EXPECT_EQ(view.data(), trajectory.data());
+    EXPECT_EQ(trajectory.matrix(0).rows(), solution.size());
+    EXPECT_TRUE(trajectory.matrix(0) == trajectory.matrix(1));
+}
+
+TEST(integrator_test_case, trajectory_test) {
+    rndcmp::RK4Integrator<double> integrator(lorenz_system<double>(), 0.0, 1.0, 0.01);
+    integrator.setInitial({1.0, 1.0, 1.0});
+    integrator.solve();
+    const auto& solution = integrator.getSolution();
+    EXPECT_LE(solution.size(), integrator.expectedPoints());
+
+    rndcmp::Trajectory<double> rows(integrator.expectedPoints(), 3);
+    integrator.solve(rows);
+    check_trajectory(solution, rows);
+
+    // Components stored one after another, the buffer grows from the default size
+    rndcmp::Trajectory<double, Eigen::ColMajor> columns;
+    integrator.solve(columns);
+    check_trajectory(solution, columns);
+    EXPECT_GE(columns.capacity(), solution.size());
+    EXPECT_EQ(columns.data()[columns.capacity()], solution[0][1]);
+
+    columns.clear();
+    EXPECT_EQ(columns.rows(), 0);
+    integrator.solve(columns);
+    check_trajectory(solution, columns);
+}
+
+// The ESN trains on a view of the trajectory as on a copied matrix
+TEST(integrator_test_case, trajectory_esn_test) {
+    rndcmp::RK4Integrator<double> integrator(lorenz_system<double>(), 0.0, 2.0, 0.02);
+    integrator.setInitial({1.0, 1.0, 1.0});
+    rndcmp::Trajectory<double> trajectory;
+    integrator.solve(trajectory);
+
+    size_t n = trajectory.rows() - 1;
+    rndcmp::ESN<double>::ESNMatrix inputs = trajectory.matrix().topRows(n);
+    rndcmp::ESN<double>::ESNMatrix outputs = trajectory.matrix().bottomRows(n);
+
+    rndcmp::ESN<double> copied(3, 20, 3, 0.9, 0.5, 1e-6, 1);
+    rndcmp::ESN<double> viewed(3, 20, 3, 0.9, 0.5, 1e-6, 1);
+    double copied_error = copied.fit(inputs, outputs);
+    double viewed_error = viewed.fit(trajectory.matrix().topRows(n), trajectory.matrix().bottomRows(n));
+    // Only the order of the sums in the products differs between the layouts
+    EXPECT_NEAR(copied_error, viewed_error, 1e-10);
+    EXPECT_TRUE(copied.predict(inputs, 5).isApprox(viewed.predict(trajectory.matrix().topRows(n), 5), 1e-10));
+    EXPECT_NEAR(copied.score(inputs, outputs), viewed.score(trajectory.matrix().topRows(n), trajectory.matrix().bottomRows(n)), 1e-10);
+}
+
+// With deterministic rounding every member follows the single trajectory bit for bit
+template<typename T>
+void check_ensemble_members() {
+    rndcmp::RK4Integrator<T, Lorenz<T>> single(Lorenz<T>(), 0.0, 0.5, 0.01);
+    single.setInitial({T(1.0), T(1.0), T(1.0)});
+    single.solve();
+    const auto& solution = single.getSolution();
+
+    auto ensemble = rndcmp::make_ensemble_integrator<T>(rndcmp::MemberSystem<T, Lorenz<T>>(Lorenz<T>()), 5, 0.0, 0.5, 0.01);
+    ensemble.setInitial({T(1.0), T(1.0), T(1.0)});
+    size_t point = 0;
+    ensemble.solve([&](double, const rndcmp::EnsembleState<T>& x) {
+        for (Eigen::Index m = 0; m < x.rows(); m++) {
+            for (Eigen::Index i = 0; i < x.cols(); i++) {
+                EXPECT_EQ(static_cast<double>(x(m, i)), static_cast<double>(solution[point][i])) << point;
+            }
+        }
+        point++;
+    });
+    EXPECT_EQ(point, solution.size());
+}
+
+TEST(integrator_test_case, ensemble_members_test) {
+    check_ensemble_members<double>();
+    check_ensemble_members<rndcmp::BasicFloatSR<rndcmp::NearestRng>>();
+    check_ensemble_members<rndcmp::basic_bfloat16sr<rndcmp::NearestRng>>();
+}
+
+// The SR types with a word kernel round the stages of member m with the Philox stream (seed, m) in whole passes.
+// The system only copies, so all the roundings are those of the stages: a member does not depend on the size
+// of the ensemble.
+template<typename T>
+void check_ensemble_streams() {
+    static_assert(rndcmp::EnsembleIntegrator<T, void (*)(const rndcmp::EnsembleState<T>&, double, rndcmp::EnsembleState<T>&)>::member_streams,
+                  "the SR type rounds the stages with the vectorized pass");
+    auto swap = [](const rndcmp::EnsembleState<T>& x, double, rndcmp::EnsembleState<T>& dxdt) {
+        dxdt.col(0) = x.col(1);
+        dxdt.col(1) = x.col(0);
+    };
+    std::vector<T> initial = {T(1.0f), T(0.5f)};
+    auto run = [&](size_t members, std::uint64_t seed) {
+        auto ensemble = rndcmp::make_ensemble_integrator<T>(swap, members, 0.0, 0.5, 0.01);
+        ensemble.setInitial(initial);
+        std::vector<rndcmp::EnsembleState<T>> points;
+        rndcmp::RngContext context(seed, 9);
+        ensemble.solve([&](double, const rndcmp::EnsembleState<T>& x) { points.push_back(x); });
+        return points;
+    };
+
+    std::vector<rndcmp::EnsembleState<T>> small = run(3, 17);
+    std::vector<rndcmp::EnsembleState<T>> large = run(7, 17);
+    ASSERT_EQ(small.size(), large.size());
+    for (size_t point = 0; point < small.size(); point++) {
+        for (Eigen::Index m = 0; m < 3; m++) {
+            for (Eigen::Index i = 0; i < 2; i++) {
+                EXPECT_EQ(static_cast<double>(small[point](m, i)), static_cast<double>(large[point](m, i))) << m << " " << point;
+            }
+        }
+    }
+    // The streams are distinct, and the seed selects them
+    std::vector<rndcmp::EnsembleState<T>> other = run(3, 18);
+    bool members_differ = false, seeds_differ = false;
+    for (size_t point = 0; point < small.size(); point++) {
+        members_differ |= static_cast<double>(large[point](0, 0)) != static_cast<double>(large[point](1, 0));
+        seeds_differ |= static_cast<double>(other[point](0, 0)) != static_cast<double>(small[point](0, 0));
+    }
+    EXPECT_TRUE(members_differ);
+    EXPECT_TRUE(seeds_differ);
+
+    // Consecutive runs draw new streams, a run under the same seed replays
+    auto ensemble = rndcmp::make_ensemble_integrator<T>(swap, 3, 0.0, 0.5, 0.01);
+    ensemble.setInitial(initial);
+    std::vector<double> first, second, replayed;
+    auto last = [](std::vector<double>& out) {
+        return [&out](double, const rndcmp::EnsembleState<T>& x) { out.assign({static_cast<double>(x(0, 0)), static_cast<double>(x(1, 0)), static_cast<double>(x(2, 0))}); };
+    };
+    rndcmp::seed(5);
+    ensemble.solve(last(first));
+    ensemble.solve(last(second));
+    rndcmp::seed(5);
+    ensemble.solve(last(replayed));
+    EXPECT_NE(first, second);
+    EXPECT_EQ(first, replayed);
+}
+
+TEST(integrator_test_case, ensemble_streams_test) {
+    check_ensemble_streams<rndcmp::FloatSR>();
+    check_ensemble_streams<rndcmp::bfloat16sr>();
+    check_ensemble_streams<rndcmp::float8_e5m2sr>();
+
+    using System = void (*)(const rndcmp::EnsembleState<double>&, double, rndcmp::EnsembleState<double>&);
+    EXPECT_FALSE((rndcmp::EnsembleIntegrator<double, System>::member_streams));
+    EXPECT_FALSE((rndcmp::EnsembleIntegrator<rndcmp::BasicFloatSR<rndcmp::NearestRng>, System>::member_streams));
+}
+
+TEST(integrator_test_case, ensemble_statistics_test) {
+    using T = rndcmp::FloatSR;
+    // The system is written for the whole ensemble, a column is a component of all the members
+    auto decay = [](const rndcmp::EnsembleState<T>& x, double, rndcmp::EnsembleState<T>& dxdt) {
+        dxdt.col(0) = T(-1.0) * x.col(0);
+        dxdt.col(1) = x.col(0) - x.col(1);
+    };
+    auto reference = rndcmp::make_rk4_integrator<double>([](const std::vector<double>& x, double, std::vector<double>& dxdt) {
+        dxdt[0] = -x[0];
+        dxdt[1] = x[0] - x[1];
+    }, 0.0, 1.0, 0.1);
+    reference.setInitial({1.0, 0.0});
+    reference.solve();
+
+    auto ensemble = rndcmp::make_ensemble_integrator<T>(decay, 300, 0.0, 1.0, 0.1);
+    ensemble.setInitial({T(1.0f), T(0.0f)});
+    rndcmp::seed(21);
+    ensemble.solve();
+    const auto& mean = ensemble.getMean();
+    const auto& variance = ensemble.getVariance();
+    ASSERT_EQ(mean.rows(), reference.getSolution().size());
+    ASSERT_EQ(variance.rows(), mean.rows());
+    EXPECT_EQ(variance(0, 0), 0.0);
+    for (size_t i = 0; i < mean.rows(); i++) {
+        for (size_t j = 0; j < 2; j++) {
+            EXPECT_NEAR(mean(i, j), reference.getSolution()[i][j], 1e-6) << i;
+            EXPECT_GE(variance(i, j), 0.0);
+            EXPECT_LT(variance(i, j), 1e-12);
+        }
+    }
+    EXPECT_GT(variance(mean.rows() - 1, 0), 0.0);
+
+    // The ensemble replays under the same seed
+    std::vector<double> first(mean.data(), mean.data() + mean.rows() * 2);
+    rndcmp::seed(21);
+    ensemble.solve();
+    EXPECT_EQ(std::vector<double>(ensemble.getMean().data(), ensemble.getMean().data() + mean.rows() * 2), first);
+
+    rndcmp::EnsembleState<T> initial(3, 2);
+    EXPECT_THROW(ensemble.setInitialMembers(initial), decltype(ensemble)::IntegratorException);
+}
+
+TEST(integrator_test_case, dormand_prince_test) {
+    // x'' = -x, x(0) = 1: x = cos(t)
+    auto oscillator = [](const std::vector<double>& x, double, std::vector<double>& dxdt) {
+        dxdt[0] = x[1];
+        dxdt[1] = -x[0];
+    };
+    auto integrator = rndcmp::make_dormand_prince_integrator<double>(oscillator, 0.0, 10.0, 0.01);
+    integrator.setTolerance(1e-10, 1e-10);
+    integrator.setInitial({1.0, 0.0});
+    std::vector<double> times;
+    integrator.solve([&](double t, const std::vector<double>& x) {
+        times.push_back(t);
+        EXPECT_NEAR(x[0], std::cos(t), 1e-7) << t;
+    });
+    EXPECT_EQ(times.back(), 10.0);
+    EXPECT_EQ(times.size(), integrator.getAcceptedSteps() + 1);
+    for (size_t i = 1; i < times.size(); i++) {
+        EXPECT_GT(times[i], times[i - 1]);
+    }
+    // RK4 needs a thousand steps of 0.01 for the same accuracy
+    EXPECT_LT(integrator.getAcceptedSteps(), 300);
+
+    // A looser tolerance takes fewer steps
+    integrator.setTolerance(1e-5, 1e-5);
+    integrator.solve();
+    EXPECT_LT(integrator.getAcceptedSteps(), 60);
+    EXPECT_NEAR(integrator.getSolution().back()[0], std::cos(10.0), 1e-3);
+
+    // Lorenz against a fine RK4 run
+    rndcmp::DormandPrinceIntegrator<double> lorenz(lorenz_system<double>(), 0.0, 1.0, 0.01);
+    lorenz.setTolerance(1e-9, 1e-9);
+    lorenz.setInitial({1.0, 1.0, 1.0});
+    lorenz.solve();
+    rndcmp::RK4Integrator<double> reference(lorenz_system<double>(), 0.0, 1.0 - 5e-5, 1e-4);
+    reference.setInitial({1.0, 1.0, 1.0});
+    reference.solve();
+    for (size_t j = 0; j < 3; j++) {
+        EXPECT_NEAR(lorenz.getSolution().back()[j], reference.getSolution().back()[j], 1e-5);
+    }
+    EXPECT_GT(lorenz.getRejectedSteps() + lorenz.getAcceptedSteps(), 0);
+}
+
+// Tolerances below the precision of the type do not stall the controller
+template<typename T>
+void check_low_precision_dormand_prince(double tolerance) {
+    auto decay = [](const std::vector<T>& x, double, std::vector<T>& dxdt) {
+        dxdt[0] = T(-static_cast<double>(x[0]));
+    };
+    auto integrator = rndcmp::make_dormand_prince_integrator<T>(decay, 0.0, 5.0, 0.1);
+    integrator.setTolerance(1e-12, 1e-12);
+    integrator.setInitial({T(1.0)});
+    integrator.solve();
+    EXPECT_LT(integrator.getAcceptedSteps() + integrator.getRejectedSteps(), 2000);
+    EXPECT_NEAR(static_cast<double>(integrator.getSolution().back()[0]), std::exp(-5.0), tolerance);
+}
+
+TEST(integrator_test_case, dormand_prince_low_precision_test) {
+    rndcmp::seed(4);
+    check_low_precision_dormand_prince<float>(1e-6);
+    check_low_precision_dormand_prince<rndcmp::FloatSR>(1e-6);
+    check_low_precision_dormand_prince<rndcmp::bfloat16sr>(2e-3);
+    check_low_precision_dormand_prince<half_float::halfsr>(2e-4);
+    check_low_precision_dormand_prince<rndcmp::FixedSR<std::int32_t, 16>>(1e-3);
+
+    // The error estimate in long double
+    rndcmp::DormandPrinceIntegrator<double, rndcmp::ComponentSystem<double>, long double> wide(
+        rndcmp::system_type<double>{[](const std::vector<double>& x, double) { return -x[0]; }}, 0.0, 5.0, 0.1);
+    wide.setTolerance(1e-10, 1e-10);
+    wide.setInitial({1.0});
+    wide.solve();
+    EXPECT_NEAR(wide.getSolution().back()[0], std::exp(-5.0), 1e-9);
+}
+
+// A right-hand side that breaks down makes the controller give up instead of looping
+TEST(integrator_test_case, dormand_prince_non_finite_test) {
+    auto broken = [](const std::vector<double>& x, double t, std::vector<double>& dxdt) {
+        dxdt[0] = t > 0.5 ? std::nan("") : -x[0];
+    };
+    auto integrator = rndcmp::make_dormand_prince_integrator<double>(broken, 0.0, 1.0, 0.1);
+    integrator.setInitial({1.0});
+    EXPECT_THROW(integrator.solve(), decltype(integrator)::IntegratorException);
+    EXPECT_GT(integrator.getRejectedSteps(), 0);
+
+    auto infinite = [](const std::vector<double>&, double, std::vector<double>& dxdt) {
+        dxdt[0] = std::numeric_limits<double>::infinity();
+    };
+    auto limited = rndcmp::make_dormand_prince_integrator<double>(infinite, 0.0, 1.0, 0.1);
+    limited.setStepLimits(1e-3, 0.1);
+    limited.setInitial({1.0});
+    EXPECT_THROW(limited.solve(), decltype(limited)::IntegratorException);
+}
+
+template<typename T>
+double oscillator_energy(const std::vector<T>& x) {
+    double q = static_cast<double>(x[0]), p = static_cast<double>(x[1]);
+    return 0.5 * (q * q + p * p);
+}
+
+template<typename INTEGRATOR>
+double max_energy_error(INTEGRATOR& integrator) {
+    double error = 0.0;
+    integrator.solve([&error](double, const auto& x) {
+        error = std::max(error, std::abs(oscillator_energy(x) - 0.5));
+    });
+    return error;
+}
+
+TEST(integrator_test_case, symplectic_test) {
+    auto spring = [](const std::vector<double>& q, double, std::vector<double>& dpdt) { dpdt[0] = -q[0]; };
+    auto system = rndcmp::make_separable_system<double>(spring, 1);
+    EXPECT_EQ(system.size(), 2);
+
+    // About 160 periods with a step of 0.1: the energy error does not grow
+    auto verlet = rndcmp::make_verlet_integrator<double>(system, 0.0, 1000.0, 0.1);
+    verlet.setInitial({1.0, 0.0});
+    EXPECT_LT(max_energy_error(verlet), 2e-3);
+    auto yoshida = rndcmp::make_yoshida_integrator<double>(system, 0.0, 1000.0, 0.1);
+    yoshida.setInitial({1.0, 0.0});
+    EXPECT_LT(max_energy_error(yoshida), 1e-5);
+    // Euler on the same system gains energy every step
+    rndcmp::EulerIntegrator<double, decltype(system)> euler(system, 0.0, 1000.0, 0.1);
+    euler.setInitial({1.0, 0.0});
+    EXPECT_GT(max_energy_error(euler), 1.0);
+
+    // Orders of the methods
+    for (double h : {0.1, 0.05}) {
+        auto second = rndcmp::make_verlet_integrator<double>(system, 0.0, 2.0 - h / 2., h);
+        auto fourth = rndcmp::make_yoshida_integrator<double>(system, 0.0, 2.0 - h / 2., h);
+        second.setInitial({1.0, 0.0});
+        fourth.setInitial({1.0, 0.0});
+        second.solve();
+        fourth.solve();
+        EXPECT_NEAR(second.getSolution().back()[0], std::cos(2.0), h * h);
+        EXPECT_NEAR(fourth.getSolution().back()[0], std::cos(2.0), h * h * h * h);
+        EXPECT_NEAR(fourth.getSolution().back()[1], -std::sin(2.0), h * h * h * h);
+    }
+
+    // The separable system also drives the other integrators
+    rndcmp::RK4Integrator<double, decltype(system)> rk4(system, 0.0, 2.0 - 0.005, 0.01);
+    rk4.setInitial({1.0, 0.0});
+    rk4.solve();
+    EXPECT_NEAR(rk4.getSolution().back()[0], std::cos(2.0), 1e-8);
+    EXPECT_THROW(rk4.setInitial({1.0}), decltype(rk4)::IntegratorException);
+}
+
+TEST(integrator_test_case, symplectic_low_precision_test) {
+    using T = rndcmp::bfloat16sr;
+    auto spring = [](const std::vector<T>& q, double, std::vector<T>& dpdt) { dpdt[0] = -q[0]; };
+    auto system = rndcmp::make_separable_system<T>(spring, 1);
+    rndcmp::seed(8);
+    auto verlet = rndcmp::make_verlet_integrator<T>(system, 0.0, 300.0, 0.05);
+    verlet.setInitial({T(1.0f), T(0.0f)});
+    // 6000 steps at 8 bits of mantissa: the energy only random-walks with the rounding errors
+    EXPECT_LT(max_energy_error(verlet), 0.3);
+    rndcmp::EulerIntegrator<T, decltype(system)> euler(system, 0.0, 300.0, 0.05);
+    euler.setInitial({T(1.0f), T(0.0f)});
+    EXPECT_GT(max_energy_error(euler), 10.0);
+}
+
+template<typename T>
+auto static_lorenz() {
+    return [](const auto& x, double, auto& dxdt) {
+        dxdt[0] = T(10.0 * (x[1] - x[0]));
+        dxdt[1] = T(x[0] * (28.0 - x[2]) - x[1]);
+        dxdt[2] = T(x[0] * x[1] - 8.0 / 3.0 * x[2]);
+    };
+}
+
+template<typename STATIC, typename T>
+void expect_same_static_solution(const STATIC& a, const std::vector<std::vector<T>>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b[i].size(); j++) {
+            EXPECT_EQ(static_cast<double>(a[i][j]), static_cast<double>(b[i][j])) << i;
+        }
+    }
+}
+
+// The fixed-dimension integrators round as the std::vector ones
+TEST(integrator_test_case, static_integrator_test) {
+    auto rk4 = rndcmp::make_static_rk4_integrator<double, 3>(static_lorenz<double>(), 0.0, 1.0, 0.01);
+    rndcmp::RK4Integrator<double, Lorenz<double>> reference(Lorenz<double>(), 0.0, 1.0, 0.01);
+    rk4.setInitial({1.0, 1.0, 1.0});
+    reference.setInitial({1.0, 1.0, 1.0});
+    rk4.solve();
+    reference.solve();
+    EXPECT_LE(rk4.getSolution().size(), rk4.expectedPoints());
+    expect_same_static_solution(rk4.getSolution(), reference.getSolution());
+
+    using T = rndcmp::FloatSR;
+    auto rk4_sr = rndcmp::make_static_rk4_integrator<T, 3>(static_lorenz<T>(), 0.0, 1.0, 0.01);
+    rndcmp::RK4Integrator<T, Lorenz<T>> reference_sr(Lorenz<T>(), 0.0, 1.0, 0.01);
+    rk4_sr.setInitial({T(1.0f), T(1.0f), T(1.0f)});
+    reference_sr.setInitial({1.0f, 1.0f, 1.0f});
+    rndcmp::seed(5);
+    rk4_sr.solve();
+    rndcmp::seed(5);
+    reference_sr.solve();
+    expect_same_static_solution(rk4_sr.getSolution(), reference_sr.getSolution());
+
+    auto euler = rndcmp::make_static_euler_integrator<T, 3>(static_lorenz<T>(), 0.0, 1.0, 0.01);
+    rndcmp::EulerIntegrator<T, Lorenz<T>> reference_euler(Lorenz<T>(), 0.0, 1.0, 0.01);
+    euler.setInitial({T(1.0f), T(1.0f), T(1.0f)});
+    reference_euler.setInitial({1.0f, 1.0f, 1.0f});
+    rndcmp::seed(6);
+    euler.solve();
+    rndcmp::seed(6);
+    reference_euler.solve();
+    expect_same_static_solution(euler.getSolution(), reference_euler.getSolution());
+
+    // A fixed-size Eigen vector as the state, the points go to a sink
+    using Vector = Eigen::Matrix<T, 3, 1>;
+    rndcmp::StaticRK4Integrator<T, 3, decltype(static_lorenz<T>()), Vector> eigen(static_lorenz<T>(), 0.0, 1.0, 0.01);
+    eigen.setInitial(Vector::Constant(T(1.0f)));
+    rndcmp::Trajectory<T> trajectory(eigen.expectedPoints(), 3);
+    rndcmp::seed(5);
+    eigen.solve(trajectory);
+    ASSERT_EQ(trajectory.rows(), reference_sr.getSolution().size());
+    for (size_t i = 0; i < trajectory.rows(); i++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_EQ(static_cast<double>(trajectory(i, j)), static_cast<double>(reference_sr.getSolution()[i][j])) << i;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "random.hpp"
+#include "types.hpp"
+#include "montecarlo.hpp"
+
+
+TEST(montecarlo_test_case, statistics_test) {
+    rndcmp::MonteCarloOptions options;
+    options.threads = 4;
+    options.chunk = 7;
+    rndcmp::StatisticsSink result = rndcmp::run_trials<double>(1000, [](size_t trial) { return static_cast<double>(trial); }, options);
+    ASSERT_EQ(result.count(), 1000);
+    EXPECT_NEAR(result.mean()[0], 499.5, 1e-9);
+    EXPECT_NEAR(result.variance()[0], 1000.0 * 1001.0 / 12.0, 1e-6);
+    EXPECT_EQ(result.min()[0], 0.0);
+    EXPECT_EQ(result.max()[0], 999.0);
+
+    EXPECT_EQ(rndcmp::run_trials<double>(0, [](size_t) { return 1.0; }).count(), 0);
+}
+
+TEST(montecarlo_test_case, merge_test) {
+    rndcmp::StatisticsSink all, first, second;
+    for (int i = 0; i < 50; i++) {
+        std::vector<double> x = {std::sin(i), i * 0.5};
+        all(i, x);
+        (i < 20 ? first : second)(i, x);
+    }
+    first.merge(second);
+    ASSERT_EQ(first.count(), all.count());
+    for (size_t j = 0; j < 2; j++) {
+        EXPECT_NEAR(first.mean()[j], all.mean()[j], 1e-12);
+        EXPECT_NEAR(first.variance()[j], all.variance()[j], 1e-12);
+        EXPECT_EQ(first.min()[j], all.min()[j]);
+        EXPECT_EQ(first.max()[j], all.max()[j]);
+    }
+}
+
+// Accumulation with stochastic rounding, the error differs from trial to trial
+std::vector<double> accumulate_trial(size_t trial) {
+    rndcmp::FloatSR sum(100.0f);
+    double exact = 100.0;
+    for (int i = 0; i < 1000; i++) {
+        sum += 1e-4;
+        exact += 1e-4;
+    }
+    return {static_cast<double>(sum) - exact, static_cast<double>(trial % 3)};
+}
+
+TEST(montecarlo_test_case, deterministic_streams_test) {
+    rndcmp::MonteCarloOptions single, many;
+    single.threads = 1;
+    many.threads = 8;
+    many.chunk = 3;
+    single.chunk = 3;
+
+    rndcmp::seed(17);
+    rndcmp::StatisticsSink first = rndcmp::run_trials<rndcmp::FloatSR>(200, accumulate_trial, single);
+    rndcmp::seed(17);
+    rndcmp::StatisticsSink second = rndcmp::run_trials<rndcmp::FloatSR>(200, accumulate_trial, many);
+    // The same seed gives the same result whatever the number of threads
+    EXPECT_EQ(first.mean(), second.mean());
+    EXPECT_EQ(first.variance(), second.variance());
+    EXPECT_EQ(first.min(), second.min());
+    EXPECT_EQ(first.max(), second.max());
+
+    // Trials get independent streams, the errors scatter around zero
+    EXPECT_GT(first.variance()[0], 0.0);
+    EXPECT_LT(first.min()[0], first.max()[0]);
+    EXPECT_NEAR(first.mean()[0], 0.0, 3.0 * std::sqrt(first.variance()[0] / 200) + 1e-9);
+
+    rndcmp::seed(18);
+    EXPECT_NE(rndcmp::run_trials<rndcmp::FloatSR>(200, accumulate_trial, many).mean()[0], first.mean()[0]);
+}
+
+TEST(montecarlo_test_case, seed_policy_test) {
+    auto trial = [](size_t trial) { return static_cast<double>(trial); };
+    rndcmp::seed(23);
+    std::uint32_t expected = rndcmp::DefaultRng::bits<32>();
+
+    // A deterministic type draws no seed, the stream of the caller is left as it was
+    rndcmp::seed(23);
+    rndcmp::run_trials<rndcmp::BasicFloatSR<rndcmp::NearestRng>>(10, trial);
+    EXPECT_EQ(rndcmp::DefaultRng::bits<32>(), expected);
+
+    rndcmp::seed(23);
+    rndcmp::run_trials<rndcmp::FloatSR>(10, trial);
+    EXPECT_NE(rndcmp::DefaultRng::bits<32>(), expected);
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <set>
+
+#include <Eigen/Dense>
+
+#include "gtest/gtest.h"
+#include "floatsr.hpp"
+#include "fixedsr.hpp"
+#include "bfloat16sr.hpp"
+#include "srfloat.hpp"
+#include "fp8.hpp"
+
+
+using NearestFloat = rndcmp::BasicFloatSR<rndcmp::NearestRng>;
+using NearestBfloat = rndcmp::basic_bfloat16sr<rndcmp::NearestRng>;
+using NearestFixed = rndcmp::FixedSR<std::int32_t, 16, 2, rndcmp::NearestRng>;
+using NearestE5M10 = rndcmp::SRFloat<5, 10, rndcmp::NearestRng>;
+
+RNDCMP_EIGEN_PACKET_MATH(NearestFloat)
+RNDCMP_EIGEN_PACKET_MATH(NearestBfloat)
+RNDCMP_EIGEN_PACKET_MATH(NearestFixed)
+RNDCMP_EIGEN_PACKET_MATH(NearestE5M10)
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::float8_e4m3)
+RNDCMP_EIGEN_PACKET_MATH(rndcmp::float8_e5m2)
+
+
+template<typename T>
+using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+template<typename T>
+using RowMatrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+template<typename T>
+Matrix<T> random_matrix(int rows, int cols) {
+    Eigen::MatrixXd values = Eigen::MatrixXd::Random(rows, cols) * 0.5;
+    Matrix<T> result(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            result(i, j) = T(values(i, j));
+        }
+    }
+    return result;
+}
+
+template<typename MATRIX>
+Eigen::MatrixXd to_double(const MATRIX& m) {
+    Eigen::MatrixXd result(m.rows(), m.cols());
+    for (int i = 0; i < m.rows(); i++) {
+        for (int j = 0; j < m.cols(); j++) {
+            result(i, j) = static_cast<double>(m(i, j));
+        }
+    }
+    return result;
+}
+
+// Packets must give the same values as the scalar operators. With NearestRng both are deterministic.
+template<typename T>
+void check_coefficient_wise() {
+    static_assert(Eigen::internal::packet_traits<T>::Vectorizable, "packet math must be enabled");
+    // 37 coefficients: four packets and a scalar tail
+    Matrix<T> a = random_matrix<T>(37, 1), b = random_matrix<T>(37, 1);
+    Matrix<T> sum = a + b, difference = a - b, product = a.cwiseProduct(b), quotient = a.cwiseQuotient(b), negated = -a;
+    for (int i = 0; i < a.rows(); i++) {
+        EXPECT_EQ(static_cast<double>(sum(i)), static_cast<double>(a(i) + b(i))) << i;
+        EXPECT_EQ(static_cast<double>(difference(i)), static_cast<double>(a(i) - b(i))) << i;
+        EXPECT_EQ(static_cast<double>(product(i)), static_cast<double>(a(i) * b(i))) << i;
+        EXPECT_EQ(static_cast<double>(quotient(i)), static_cast<double>(a(i) / b(i))) << i;
+        EXPECT_EQ(static_cast<double>(negated(i)), -static_cast<double>(a(i))) << i;
+    }
+}
+
+// Products of every storage order against the product of the same values in double
+template<typename T>
+void check_products(double tolerance) {
+    int n = 37;
+    Matrix<T> a = random_matrix<T>(n, n), b = random_matrix<T>(n, n), x = random_matrix<T>(n, 1);
+    RowMatrix<T> a_row = a, b_row = b;
+    Eigen::MatrixXd expected = to_double(a) * to_double(b);
+    Eigen::MatrixXd expected_gemv = to_double(a) * to_double(x);
+
+    EXPECT_LT((to_double(Matrix<T>(a * b)) - expected).cwiseAbs().maxCoeff(), tolerance);
+    EXPECT_LT((to_double(Matrix<T>(a_row * b)) - expected).cwiseAbs().maxCoeff(), tolerance);
+    EXPECT_LT((to_double(Matrix<T>(a * b_row)) - expected).cwiseAbs().maxCoeff(), tolerance);
+    EXPECT_LT((to_double(Matrix<T>(a_row * b_row)) - expected).cwiseAbs().maxCoeff(), tolerance);
+    EXPECT_LT((to_double(Matrix<T>(a * x)) - expected_gemv).cwiseAbs().maxCoeff(), tolerance);
+    EXPECT_LT((to_double(Matrix<T>(a_row * x)) - expected_gemv).cwiseAbs().maxCoeff(), tolerance);
+    // The sum of all n * n coefficients grows n times larger than a product coefficient
+    EXPECT_LT(std::abs(static_cast<double>(a.sum()) - to_double(a).sum()), tolerance * n);
+}
+
+TEST(packet_test_case, coefficient_wise_test) {
+    check_coefficient_wise<NearestFloat>();
+    check_coefficient_wise<NearestBfloat>();
+    check_coefficient_wise<NearestFixed>();
+    check_coefficient_wise<NearestE5M10>();
+    check_coefficient_wise<rndcmp::float8_e4m3>();
+    check_coefficient_wise<rndcmp::float8_e5m2>();
+}
+
+TEST(packet_test_case, product_test) {
+    check_products<rndcmp::FloatSR>(1e-5);
+    check_products<rndcmp::bfloat16sr>(0.1);
+    check_products<rndcmp::FixedSR<std::int32_t, 16>>(1e-3);
+    check_products<NearestFloat>(1e-5);
+    check_products<NearestBfloat>(0.1);
+    check_products<NearestFixed>(1e-3);
+    check_products<rndcmp::SRFloat<8, 7>>(0.1);
+    check_products<rndcmp::SRFloat<5, 10>>(0.01);
+    check_products<rndcmp::float8_e4m3sr>(1.0);
+    check_products<rndcmp::float8_e5m2sr>(2.0);
+}
+
+TEST(packet_test_case, stochastic_product_test) {
+    // Every product and partial sum is rounded stochastically, so the mean converges to the exact value
+    Matrix<rndcmp::FloatSR> a = random_matrix<rndcmp::FloatSR>(1, 64), b = random_matrix<rndcmp::FloatSR>(64, 1);
+    double exact = (to_double(a) * to_double(b))(0, 0);
+    std::set<double> seen;
+    double mean = 0.0;
+    int runs = 1000;
+    for (int i = 0; i < runs; i++) {
+        double value = static_cast<double>(Matrix<rndcmp::FloatSR>(a * b)(0, 0));
+        seen.insert(value);
+        mean += value / runs;
+    }
+    EXPECT_GT(seen.size(), 1);
+    EXPECT_NEAR(mean, exact, 3e-7);
+}
@@ -0,0 +1,381 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "random.hpp"
+#include "types.hpp"
+#include "integrator.hpp"
+
+
+/* Philox test cases */
+
+TEST(philox_test_case, known_answer_test) {
+    // Reference vectors from the Random123 distribution (kat_vectors, philox4x32_10)
+    rndcmp::Philox4x32::counter_type zero = rndcmp::Philox4x32::generate({0, 0, 0, 0}, {0, 0});
+    rndcmp::Philox4x32::counter_type zero_expected = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    EXPECT_EQ(zero, zero_expected);
+
+    rndcmp::Philox4x32::counter_type ones = rndcmp::Philox4x32::generate(
+        {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff});
+    rndcmp::Philox4x32::counter_type ones_expected = {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+    EXPECT_EQ(ones, ones_expected);
+
+    rndcmp::Philox4x32::counter_type pi = rndcmp::Philox4x32::generate(
+        {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0});
+    rndcmp::Philox4x32::counter_type pi_expected = {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+    EXPECT_EQ(pi, pi_expected);
+}
+
+TEST(philox_test_case, engine_sequence_test) {
+    rndcmp::Philox4x32 engine(0);
+    rndcmp::Philox4x32::counter_type expected = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(engine(), expected[i]);
+    }
+    // Second call should move on to the next counter value
+    rndcmp::Philox4x32::counter_type next = rndcmp::Philox4x32::generate({1, 0, 0, 0}, {0, 0});
+    EXPECT_EQ(engine(), next[0]);
+}
+
+TEST(philox_test_case, discard_test) {
+    for (unsigned long long skip : {0ull, 1ull, 3ull, 4ull, 5ull, 17ull, 1000ull}) {
+        rndcmp::Philox4x32 reference(42, 7);
+        rndcmp::Philox4x32 skipped(42, 7);
+        reference();
+        skipped();
+        for (unsigned long long i = 0; i < skip; i++) {
+            reference();
+        }
+        skipped.discard(skip);
+        EXPECT_EQ(reference(), skipped()) << "skip: " << skip;
+        EXPECT_EQ(reference, skipped) << "skip: " << skip;
+    }
+}
+
+TEST(philox_test_case, streams_test) {
+    rndcmp::Philox4x32 first(42, 0);
+    rndcmp::Philox4x32 second(42, 1);
+    size_t equal_cnt = 0;
+    for (size_t i = 0; i < 1000; i++) {
+        if (first() == second()) {
+            equal_cnt++;
+        }
+    }
+    EXPECT_LT(equal_cnt, 2) << "different streams are expected to be independent";
+}
+
+TEST(philox_test_case, uniformity_test) {
+    rndcmp::Philox4x32 engine(12345);
+    std::uniform_int_distribution<int64_t> dist(0, 0x1fffffff);
+    size_t N = 1000000;
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(dist(engine)) / 0x1fffffff;
+    }
+    EXPECT_NEAR(mean / N, 0.5, 0.002);
+}
+
+/* Other engines test cases */
+
+TEST(pcg32_test_case, known_answer_test) {
+    // Reference output of pcg32-demo seeded with (42, 54)
+    rndcmp::Pcg32 engine(42, 54);
+    std::vector<uint32_t> expected = {0xa15c02b7, 0x7b47f409, 0xba1d3330, 0x83d2f293, 0xbfa4784b, 0xcbed606e};
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(engine(), expected[i]);
+    }
+}
+
+TEST(xoshiro_test_case, seed_test) {
+    rndcmp::Xoshiro256Plus first(42);
+    rndcmp::Xoshiro256Plus second(42);
+    rndcmp::Xoshiro256Plus other_stream(42, 1);
+    for (size_t i = 0; i < 100; i++) {
+        uint64_t v = first();
+        EXPECT_EQ(v, second());
+        EXPECT_NE(v, other_stream());
+    }
+}
+
+/* RNG policies test cases */
+
+template<typename RNG>
+void check_policy_uniformity() {
+    size_t N = 100000;
+    double mean_bits = 0.0;
+    double mean_uniform = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean_bits += static_cast<double>(RNG::template bits<13>()) / (1 << 13);
+        double u = RNG::uniform();
+        EXPECT_GE(u, 0.0);
+        EXPECT_LT(u, 1.0);
+        mean_uniform += u;
+    }
+    EXPECT_NEAR(mean_bits / N, 0.5, 0.01);
+    EXPECT_NEAR(mean_uniform / N, 0.5, 0.01);
+}
+
+TEST(rng_policy_test_case, uniformity_test) {
+    check_policy_uniformity<rndcmp::Mt19937Rng>();
+    check_policy_uniformity<rndcmp::Xoshiro256PlusRng>();
+    check_policy_uniformity<rndcmp::Pcg32Rng>();
+    check_policy_uniformity<rndcmp::PhiloxRng>();
+}
+
+TEST(rng_policy_test_case, engine_seed_test) {
+    rndcmp::seed(42);
+    std::vector<uint32_t> first;
+    for (size_t i = 0; i < 10; i++) {
+        first.push_back(rndcmp::PhiloxRng::bits<32>());
+    }
+    rndcmp::seed(42);
+    for (size_t i = 0; i < 10; i++) {
+        EXPECT_EQ(first[i], rndcmp::PhiloxRng::bits<32>());
+    }
+}
+
+TEST(philox_test_case, fill_test) {
+    for (size_t offset : {0, 1, 3, 4}) {
+        rndcmp::Philox4x32 reference(42, 3);
+        rndcmp::Philox4x32 filled(42, 3);
+        for (size_t i = 0; i < offset; i++) {
+            reference();
+            filled();
+        }
+        std::vector<uint32_t> words(37);
+        filled.fill(words.data(), words.size());
+        for (size_t i = 0; i < words.size(); i++) {
+            EXPECT_EQ(words[i], reference()) << "offset: " << offset << ", word: " << i;
+        }
+        EXPECT_EQ(reference, filled);
+    }
+}
+
+TEST(rng_policy_test_case, bit_pool_test) {
+    // Draws of different widths are cut from one stream of pool words, low bits first
+    rndcmp::seed(42);
+    rndcmp::set_thread_stream(9);
+    std::vector<uint32_t> words(rndcmp::PhiloxRng::pool_words + 8);
+    rndcmp::PhiloxRng::words(words.data(), words.size());
+
+    rndcmp::set_thread_stream(9);
+    rndcmp::Philox4x32 engine(42, 9);
+    std::vector<uint32_t> expected(words.size());
+    engine.fill(expected.data(), expected.size());
+    EXPECT_EQ(words, expected);
+
+    rndcmp::set_thread_stream(9);
+    uint64_t reservoir = static_cast<uint64_t>(expected[1]) << 32 | expected[0];
+    EXPECT_EQ(rndcmp::PhiloxRng::bits<13>(), reservoir & 0x1fff);
+    EXPECT_EQ(rndcmp::PhiloxRng::bits<29>(), (reservoir >> 13) & 0x1fffffff);
+    EXPECT_EQ(rndcmp::PhiloxRng::bits<16>(), (reservoir >> 42) & 0xffff);
+}
+
+TEST(rng_policy_test_case, nearest_policy_test) {
+    // 1/3 lies closer to its lower float neighbour, 2/3 to the upper one
+    double third = 1.0 / 3.0;
+    float third_nearest = static_cast<float>(third);
+    double two_thirds = 2.0 / 3.0;
+    float two_thirds_nearest = static_cast<float>(two_thirds);
+    for (size_t i = 0; i < 100; i++) {
+        rndcmp::BasicFloatSR<rndcmp::NearestRng> val(third);
+        EXPECT_EQ(static_cast<float>(val), third_nearest);
+        rndcmp::BasicFloatSR<rndcmp::NearestRng> val2(two_thirds);
+        EXPECT_EQ(static_cast<float>(val2), two_thirds_nearest);
+
+        rndcmp::basic_bfloat16sr<rndcmp::NearestRng> bval(static_cast<float>(third));
+        EXPECT_EQ(static_cast<float>(bval), static_cast<float>(rndcmp::bfloat16(static_cast<float>(third))));
+
+        half_float::basic_halfsr<rndcmp::NearestRng> hval(static_cast<float>(third));
+        EXPECT_EQ(static_cast<float>(hval), static_cast<float>(half_float::half(static_cast<float>(third))));
+
+        rndcmp::FixedSR<std::int32_t, 8, 2, rndcmp::NearestRng> fval(0.3);
+        EXPECT_EQ(static_cast<double>(fval), 77.0 / 256.0);
+    }
+}
+
+TEST(rng_policy_test_case, policy_types_test) {
+    rndcmp::BasicFloatSR<rndcmp::Xoshiro256PlusRng> x(1.0);
+    rndcmp::BasicFloatSR<rndcmp::Pcg32Rng> p(1.0);
+    rndcmp::BasicFloatSR<rndcmp::PhiloxRng> c(1.0);
+    EXPECT_EQ(x + 1.0, 2.0);
+    EXPECT_EQ(p * 2.0, 2.0);
+    EXPECT_EQ(c / 2.0, 0.5);
+
+    rndcmp::FixedSR<std::int32_t, 16, 2, rndcmp::PhiloxRng> fx(1.5);
+    EXPECT_EQ(fx + fx, 3.0);
+    EXPECT_EQ(sizeof(rndcmp::BasicFloatSR<rndcmp::PhiloxRng>), 4);
+    EXPECT_EQ(sizeof(rndcmp::basic_bfloat16sr<rndcmp::PhiloxRng>), 2);
+    EXPECT_EQ(sizeof(half_float::basic_halfsr<rndcmp::PhiloxRng>), 2);
+}
+
+/* Thread-local streams test cases */
+
+template<typename RNG>
+std::vector<uint32_t> draw_on_thread(uint64_t stream, size_t count) {
+    std::vector<uint32_t> result;
+    std::thread worker([&]() {
+        rndcmp::set_thread_stream(stream);
+        for (size_t i = 0; i < count; i++) {
+            result.push_back(RNG::template bits<32>());
+        }
+    });
+    worker.join();
+    return result;
+}
+
+TEST(thread_stream_test_case, per_thread_seeding_test) {
+    rndcmp::seed(42);
+    EXPECT_EQ(rndcmp::master_seed(), 42);
+    std::vector<uint32_t> first = draw_on_thread<rndcmp::Mt19937Rng>(3, 100);
+    std::vector<uint32_t> second = draw_on_thread<rndcmp::Mt19937Rng>(3, 100);
+    std::vector<uint32_t> other = draw_on_thread<rndcmp::Mt19937Rng>(4, 100);
+    EXPECT_EQ(first, second);
+    EXPECT_NE(first, other);
+
+    rndcmp::seed(43);
+    std::vector<uint32_t> reseeded = draw_on_thread<rndcmp::Mt19937Rng>(3, 100);
+    EXPECT_NE(first, reseeded);
+}
+
+TEST(thread_stream_test_case, set_thread_stream_test) {
+    rndcmp::seed(42);
+    rndcmp::set_thread_stream(5);
+    EXPECT_EQ(rndcmp::thread_stream(), 5);
+    uint32_t first = rndcmp::PhiloxRng::bits<32>();
+    rndcmp::PhiloxRng::bits<32>();
+    rndcmp::set_thread_stream(5);
+    EXPECT_EQ(first, rndcmp::PhiloxRng::bits<32>());
+}
+
+TEST(thread_stream_test_case, parallel_integrators_test) {
+    using T = rndcmp::FloatSR;
+    rndcmp::system_type<T> system = {
+        [] (const std::vector<T>& x, double) { return T(10.0 * (x[1] - x[0])); },
+        [] (const std::vector<T>& x, double) { return T(x[0] * (28.0 - x[2]) - x[1]); },
+        [] (const std::vector<T>& x, double) { return T(x[0] * x[1] - 8.0 / 3.0 * x[2]); }
+    };
+    auto solve = [&system](uint64_t stream) {
+        rndcmp::set_thread_stream(stream);
+        rndcmp::RK4Integrator<T> integrator(system, 0.0, 1.0, 0.01);
+        integrator.setInitial({T(1.), T(1.), T(1.)});
+        integrator.solve();
+        return integrator.getSolution().back();
+    };
+
+    rndcmp::seed(7);
+    size_t threads_cnt = 4;
+    std::vector<std::vector<T>> parallel(threads_cnt);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads_cnt; i++) {
+        workers.emplace_back([&, i]() { parallel[i] = solve(i); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t i = 0; i < threads_cnt; i++) {
+        std::vector<T> serial;
+        std::thread worker([&]() { serial = solve(i); });
+        worker.join();
+        for (size_t j = 0; j < serial.size(); j++) {
+            EXPECT_EQ(static_cast<float>(serial[j]), static_cast<float>(parallel[i][j]));
+        }
+    }
+}
+
+/* Seeding and replay test cases */
+
+template<typename T>
+std::vector<float> lorenz_run() {
+    rndcmp::system_type<T> system = {
+        [] (const std::vector<T>& x, double) { return T(10.0 * (x[1] - x[0])); },
+        [] (const std::vector<T>& x, double) { return T(x[0] * (28.0 - x[2]) - x[1]); },
+        [] (const std::vector<T>& x, double) { return T(x[0] * x[1] - 8.0 / 3.0 * x[2]); }
+    };
+    rndcmp::RK4Integrator<T> integrator(system, 0.0, 2.0, 0.01);
+    integrator.setInitial({T(1.), T(1.), T(1.)});
+    integrator.solve();
+    auto solution = integrator.getSolution();
+    std::vector<float> result;
+    for (auto& v : solution.back()) {
+        result.push_back(static_cast<float>(v));
+    }
+    return result;
+}
+
+TEST(replay_test_case, seed_replay_test) {
+    rndcmp::seed(2024);
+    std::vector<float> first = lorenz_run<rndcmp::FloatSR>();
+    std::vector<float> first_bf = lorenz_run<rndcmp::bfloat16sr>();
+    rndcmp::seed(2024);
+    EXPECT_EQ(first, lorenz_run<rndcmp::FloatSR>());
+    EXPECT_EQ(first_bf, lorenz_run<rndcmp::bfloat16sr>());
+}
+
+TEST(replay_test_case, context_replay_test) {
+    // A trajectory of a batch can be rerun on its own
+    rndcmp::seed(1);
+    std::vector<std::vector<float>> batch;
+    for (uint64_t i = 0; i < 3; i++) {
+        rndcmp::RngContext context(99, i);
+        batch.push_back(lorenz_run<rndcmp::FloatSR>());
+    }
+    EXPECT_NE(batch[0], batch[1]);
+
+    rndcmp::seed(2);
+    rndcmp::RngContext context(99, 1);
+    EXPECT_EQ(context.seed(), 99);
+    EXPECT_EQ(rndcmp::thread_stream(), 1);
+    EXPECT_EQ(batch[1], lorenz_run<rndcmp::FloatSR>());
+}
+
+TEST(replay_test_case, context_scope_test) {
+    // Draws around a context are the same as if the context was not there
+    rndcmp::seed(5);
+    rndcmp::set_thread_stream(0);
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < 20; i++) {
+        expected.push_back(rndcmp::Pcg32Rng::bits<32>());
+    }
+
+    rndcmp::seed(5);
+    rndcmp::set_thread_stream(0);
+    std::vector<uint32_t> actual;
+    std::vector<uint32_t> inner;
+    for (size_t i = 0; i < 20; i++) {
+        if (i == 10) {
+            rndcmp::RngContext context(5, 3);
+            inner.push_back(rndcmp::Pcg32Rng::bits<32>());
+            {
+                rndcmp::RngContext nested(6, 0);
+                rndcmp::Pcg32Rng::bits<32>();
+            }
+            inner.push_back(rndcmp::Pcg32Rng::bits<32>());
+            // The master seed does not reach into a context
+            rndcmp::seed(5);
+            inner.push_back(rndcmp::Pcg32Rng::bits<32>());
+        }
+        actual.push_back(rndcmp::Pcg32Rng::bits<32>());
+    }
+
+    // seed(5) inside the context restarted the outer sequence
+    std::vector<uint32_t> restarted(expected.begin(), expected.begin() + 10);
+    restarted.insert(restarted.end(), expected.begin(), expected.begin() + 10);
+    EXPECT_EQ(actual, restarted);
+    rndcmp::Pcg32 engine(5, 3);
+    EXPECT_EQ(inner, std::vector<uint32_t>({engine(), engine(), engine()}));
+
+    rndcmp::set_thread_stream(0);
+    actual.clear();
+    for (size_t i = 0; i < 20; i++) {
+        if (i == 10) {
+            rndcmp::RngContext context(5, 3);
+            rndcmp::Pcg32Rng::bits<32>();
+        }
+        actual.push_back(rndcmp::Pcg32Rng::bits<32>());
+    }
+    EXPECT_EQ(actual, expected);
+    EXPECT_EQ(rndcmp::thread_seed(), 5);
+}
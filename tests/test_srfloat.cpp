@@ -0,0 +1,261 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "gtest/gtest.h"
+#include "srfloat.hpp"
+#include "bfloat16sr.hpp"
+#include "halfsr.hpp"
+
+
+template<int EXP_BITS, int MANT_BITS>
+using NearestSR = rndcmp::SRFloat<EXP_BITS, MANT_BITS, rndcmp::NearestRng>;
+
+// Value of a code by the definition of the format
+template<int EXP_BITS, int MANT_BITS>
+double reference_value(std::uint32_t code) {
+    int bias = (1 << (EXP_BITS - 1)) - 1;
+    int exponent = (code >> MANT_BITS) & ((1 << EXP_BITS) - 1);
+    double mantissa = code & ((1u << MANT_BITS) - 1);
+    double sign = (code >> (EXP_BITS + MANT_BITS)) ? -1.0 : 1.0;
+    if (exponent == 0) {
+        return sign * std::ldexp(mantissa, 1 - bias - MANT_BITS);
+    }
+    if (exponent == (1 << EXP_BITS) - 1) {
+        return mantissa == 0 ? sign * std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+    }
+    return sign * std::ldexp(1.0 + std::ldexp(mantissa, -MANT_BITS), exponent - bias);
+}
+
+template<int EXP_BITS, int MANT_BITS>
+void check_codes() {
+    using T = NearestSR<EXP_BITS, MANT_BITS>;
+    for (std::uint32_t code = 0; code < (std::uint32_t(1) << (1 + EXP_BITS + MANT_BITS)); code++) {
+        T value = T::fromRaw(static_cast<typename T::code_t>(code));
+        double expected = reference_value<EXP_BITS, MANT_BITS>(code);
+        if (std::isnan(expected)) {
+            EXPECT_TRUE(std::isnan(static_cast<double>(value))) << code;
+            EXPECT_TRUE(isnan(value)) << code;
+            continue;
+        }
+        EXPECT_EQ(static_cast<double>(value), expected) << code;
+        EXPECT_EQ(isfinite(value), std::isfinite(expected)) << code;
+        // Every finite value and infinity is representable, so rounding it back gives the same code
+        if (expected != 0.0) {
+            EXPECT_EQ(T(expected).raw(), code) << code;
+            EXPECT_EQ(T(static_cast<float>(expected)).raw(), code) << code;
+        }
+    }
+}
+
+TEST(srfloat_test_case, codes_test) {
+    check_codes<4, 3>();
+    check_codes<5, 2>();
+    check_codes<5, 10>();
+    check_codes<8, 7>();
+    check_codes<3, 4>();
+}
+
+TEST(srfloat_test_case, size_test) {
+    EXPECT_EQ(sizeof(rndcmp::SRFloat<4, 3>), 1);
+    EXPECT_EQ(sizeof(rndcmp::SRFloat<5, 10>), 2);
+    EXPECT_EQ(sizeof(rndcmp::SRFloat<8, 7>), 2);
+    EXPECT_EQ(sizeof(rndcmp::SRFloat<8, 15>), 4);
+}
+
+TEST(srfloat_test_case, nearest_test) {
+    // The deterministic policy rounds to nearest, ties towards zero
+    using E4M3 = NearestSR<4, 3>;
+    EXPECT_EQ(static_cast<double>(E4M3(1.0 + 1.0 / 16 + 1e-9)), 1.125);
+    EXPECT_EQ(static_cast<double>(E4M3(1.0 + 1.0 / 16)), 1.0);
+    EXPECT_EQ(static_cast<double>(E4M3(-1.0 - 1.0 / 32)), -1.0);
+    // Subnormals are multiples of 2^-9
+    EXPECT_EQ(static_cast<double>(E4M3(std::ldexp(2.7, -9))), std::ldexp(3.0, -9));
+    EXPECT_EQ(static_cast<double>(E4M3(std::ldexp(0.2, -9))), 0.0);
+    EXPECT_EQ(static_cast<double>(E4M3(std::ldexp(7.6, -9))), std::ldexp(1.0, -6));
+}
+
+TEST(srfloat_test_case, special_values_test) {
+    using E5M2 = rndcmp::SRFloat<5, 2>;
+    EXPECT_EQ(static_cast<double>(E5M2(1e10)), 57344.0);
+    EXPECT_EQ(static_cast<double>(E5M2(-1e10)), -57344.0);
+    EXPECT_EQ(static_cast<double>(E5M2(65000.0)), 57344.0);
+    EXPECT_TRUE(isinf(E5M2(std::numeric_limits<double>::infinity())));
+    EXPECT_TRUE(isnan(E5M2(std::numeric_limits<double>::quiet_NaN())));
+    EXPECT_TRUE(isnan(E5M2(std::numeric_limits<float>::quiet_NaN())));
+    EXPECT_EQ(static_cast<double>(-E5M2(1.5)), -1.5);
+    EXPECT_EQ(static_cast<double>(abs(E5M2(-1.5))), 1.5);
+    EXPECT_EQ(static_cast<double>(Eigen::NumTraits<E5M2>::epsilon()), 0.25);
+    EXPECT_EQ(static_cast<double>(Eigen::NumTraits<E5M2>::highest()), 57344.0);
+}
+
+// The format parameters of bfloat16 and half give the rounding of the hand-written classes
+TEST(srfloat_test_case, known_formats_test) {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> mantissa(1.0f, 2.0f);
+    std::uniform_int_distribution<int> exponent(-14, 15);
+    for (int i = 0; i < 10000; i++) {
+        float x = std::ldexp(mantissa(gen), exponent(gen)) * (i % 2 ? -1.0f : 1.0f);
+        rndcmp::basic_bfloat16sr<rndcmp::NearestRng> bfloat(x);
+        half_float::basic_halfsr<rndcmp::NearestRng> half(x);
+        EXPECT_EQ(static_cast<float>(NearestSR<8, 7>(x)), static_cast<float>(bfloat)) << x;
+        EXPECT_EQ(static_cast<float>(NearestSR<5, 10>(x)), static_cast<float>(half)) << x;
+    }
+}
+
+template<typename T>
+void check_mean(double x, double tolerance) {
+    size_t N = 20000;
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(T(x)) / N;
+    }
+    EXPECT_NEAR(mean, x, tolerance) << x;
+}
+
+TEST(srfloat_test_case, stochastic_rounding_test) {
+    // Normal and subnormal values, from double and from float
+    check_mean<rndcmp::SRFloat<4, 3>>(0.3, 1e-3);
+    check_mean<rndcmp::SRFloat<4, 3>>(-std::ldexp(2.3, -9), 1e-4);
+    check_mean<rndcmp::SRFloat<5, 2>>(1000.0, 5.0);
+    check_mean<rndcmp::SRFloat<5, 10>>(1.0 / 3.0, 1e-5);
+    check_mean<rndcmp::SRFloat<8, 7>>(1.0 / 3.0, 1e-4);
+    size_t N = 20000;
+    double mean = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        mean += static_cast<double>(rndcmp::SRFloat<8, 7>(0.3f)) / N;
+    }
+    EXPECT_NEAR(mean, 0.3f, 1e-4);
+}
+
+TEST(srfloat_test_case, operators_test) {
+    using E5M10 = rndcmp::SRFloat<5, 10>;
+    E5M10 a(1.5), b(0.25);
+    EXPECT_EQ(static_cast<double>(a + b), 1.75);
+    EXPECT_EQ(static_cast<double>(a - b), 1.25);
+    EXPECT_EQ(static_cast<double>(a * b), 0.375);
+    EXPECT_EQ(static_cast<double>(a / b), 6.0);
+    EXPECT_EQ(static_cast<double>(2 * a), 3.0);
+    EXPECT_EQ(static_cast<double>(a + 0.5), 2.0);
+    EXPECT_EQ(static_cast<double>(fma(a, b, a)), 1.875);
+    a += b;
+    EXPECT_EQ(a, 1.75);
+    EXPECT_TRUE(b < a);
+    EXPECT_TRUE(a > 1);
+    EXPECT_EQ(sqrt(E5M10(6.25)), 2.5);
+}
+
+TEST(srfloat_test_case, array_rounding_test) {
+    std::mt19937 gen(9);
+    std::normal_distribution<double> dist(0.0, 100.0);
+    size_t N = 777;
+    std::vector<double> src(N);
+    for (auto& v : src) {
+        v = dist(gen);
+    }
+    src[0] = std::ldexp(3.3, -9);
+    std::vector<float> src_float(src.begin(), src.end());
+
+    std::vector<NearestSR<4, 3>> dst(N);
+    std::vector<NearestSR<8, 7>> dst_prefix(N);
+    std::vector<double> back(N);
+    rndcmp::round_sr(src.data(), dst.data(), N);
+    rndcmp::round_sr(src_float.data(), dst_prefix.data(), N);
+    rndcmp::convert(dst.data(), back.data(), N);
+    for (size_t i = 0; i < N; i++) {
+        EXPECT_EQ(dst[i].raw(), (NearestSR<4, 3>(src[i]).raw())) << src[i];
+        EXPECT_EQ(dst_prefix[i].raw(), (NearestSR<8, 7>(src_float[i]).raw())) << src[i];
+        EXPECT_EQ(back[i], static_cast<double>(dst[i])) << src[i];
+    }
+}
+
+// Normal values of every magnitude, zeros, subnormals and values beyond the range of the format, infinities and NaNs
+std::vector<double> srfloat_test_values(size_t n, std::mt19937& gen) {
+    std::uniform_real_distribution<double> mantissa(1.0, 2.0);
+    std::uniform_int_distribution<int> exponent(-160, 140);
+    std::vector<double> values(n);
+    for (auto& v : values) {
+        v = std::ldexp(mantissa(gen), exponent(gen)) * (gen() % 2 ? -1.0 : 1.0);
+    }
+    double specials[] = {0.0, -0.0, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                         std::numeric_limits<double>::quiet_NaN(), -std::numeric_limits<double>::quiet_NaN(),
+                         std::numeric_limits<double>::max(), std::numeric_limits<double>::denorm_min(),
+                         448.0, 464.0, 57344.0, 65504.0, 65519.0, std::ldexp(1.0, -10), std::ldexp(1.5, -17)};
+    // Every fourth value is special, so that the vector groups see them as well as the tails
+    for (size_t i = 0; i < std::size(specials) && 4 * i < n; i++) {
+        values[4 * i + i % 4] = specials[i];
+    }
+    return values;
+}
+
+template<int EXP_BITS, int MANT_BITS, rndcmp::FloatSpecials SPECIALS = rndcmp::FloatSpecials::Ieee>
+void check_kernels() {
+    using F = rndcmp::detail::SRFormat<EXP_BITS, MANT_BITS, SPECIALS>;
+    using code_t = typename F::code_t;
+    std::mt19937 gen(EXP_BITS * 100 + MANT_BITS);
+    size_t N = 1003;
+    std::vector<double> src = srfloat_test_values(N, gen);
+    std::vector<float> src_float(src.begin(), src.end());
+    std::vector<std::uint32_t> words(N);
+    for (auto& w : words) {
+        w = gen();
+    }
+    words[1] = 0;
+    words[2] = 0xffffffff;
+
+    std::vector<code_t> packed(N), packed_float(N);
+    std::vector<float> unpacked(N);
+    std::vector<double> unpacked_double(N);
+    rndcmp::detail::srfloat_pack<F>(rndcmp::simd::Isa::Scalar, src.data(), words.data(), packed.data(), N);
+    rndcmp::detail::srfloat_pack<F>(rndcmp::simd::Isa::Scalar, src_float.data(), words.data(), packed_float.data(), N);
+    rndcmp::detail::srfloat_unpack<F>(rndcmp::simd::Isa::Scalar, packed.data(), unpacked.data(), N);
+    rndcmp::detail::srfloat_unpack<F>(rndcmp::simd::Isa::Scalar, packed.data(), unpacked_double.data(), N);
+    for (auto isa : {rndcmp::simd::Isa::Avx2, rndcmp::simd::Isa::Avx512}) {
+        if (rndcmp::simd::cpu_isa() < isa) {
+            continue;
+        }
+        std::vector<code_t> actual(N);
+        rndcmp::detail::srfloat_pack<F>(isa, src.data(), words.data(), actual.data(), N);
+        EXPECT_EQ(packed, actual) << "isa: " << static_cast<int>(isa);
+        rndcmp::detail::srfloat_pack<F>(isa, src_float.data(), words.data(), actual.data(), N);
+        EXPECT_EQ(packed_float, actual) << "isa: " << static_cast<int>(isa);
+        std::vector<float> actual_unpacked(N);
+        rndcmp::detail::srfloat_unpack<F>(isa, packed.data(), actual_unpacked.data(), N);
+        EXPECT_EQ(0, std::memcmp(unpacked.data(), actual_unpacked.data(), N * sizeof(float))) << "isa: " << static_cast<int>(isa);
+        std::vector<double> actual_double(N);
+        rndcmp::detail::srfloat_unpack<F>(isa, packed.data(), actual_double.data(), N);
+        EXPECT_EQ(0, std::memcmp(unpacked_double.data(), actual_double.data(), N * sizeof(double))) << "isa: " << static_cast<int>(isa);
+    }
+}
+
+TEST(srfloat_test_case, array_kernels_test) {
+    // Every SIMD kernel the CPU supports must match the scalar one bit for bit
+    check_kernels<4, 3, rndcmp::FloatSpecials::FiniteNan>();
+    check_kernels<5, 2>();
+    check_kernels<5, 10>();
+    check_kernels<8, 7>();
+    check_kernels<8, 10>();
+    check_kernels<8, 23>();
+}
+
+TEST(srfloat_test_case, eigen_test) {
+    using E5M10 = rndcmp::SRFloat<5, 10>;
+    Eigen::Matrix<E5M10, Eigen::Dynamic, Eigen::Dynamic> a(3, 3);
+    Eigen::Matrix<E5M10, Eigen::Dynamic, 1> x(3);
+    for (int i = 0; i < 3; i++) {
+        x(i) = E5M10(i + 1);
+        for (int j = 0; j < 3; j++) {
+            a(i, j) = E5M10(i == j ? 2 : 0);
+        }
+    }
+    Eigen::Matrix<E5M10, Eigen::Dynamic, 1> y = a * x;
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(static_cast<double>(y(i)), 2.0 * (i + 1));
+    }
+}
@@ -0,0 +1,44 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "thread_pool.hpp"
+
+
+TEST(thread_pool_test_case, run_test) {
+    rndcmp::ThreadPool pool(3);
+    EXPECT_EQ(pool.size(), 4);
+    for (size_t tasks : {0, 1, 2, 7, 1000}) {
+        std::vector<std::atomic<int>> calls(tasks);
+        pool.run(tasks, [&](size_t i) { calls[i]++; });
+        for (size_t i = 0; i < tasks; i++) {
+            EXPECT_EQ(calls[i], 1) << tasks << " " << i;
+        }
+    }
+}
+
+TEST(thread_pool_test_case, nested_test) {
+    // Every task starts a job of its own, more jobs than threads
+    rndcmp::ThreadPool pool(2);
+    std::atomic<int> calls{0};
+    pool.run(16, [&](size_t) {
+        pool.run(8, [&](size_t) { calls++; });
+    });
+    EXPECT_EQ(calls, 16 * 8);
+}
+
+TEST(thread_pool_test_case, exception_test) {
+    rndcmp::ThreadPool pool(2);
+    std::atomic<int> calls{0};
+    EXPECT_THROW(pool.run(50, [&](size_t i) {
+        calls++;
+        if (i == 13) {
+            throw std::runtime_error("task failed");
+        }
+    }), std::runtime_error);
+    // The other tasks still ran, and the pool takes new jobs
+    EXPECT_EQ(calls, 50);
+    pool.run(5, [&](size_t) { calls++; });
+    EXPECT_EQ(calls, 55);
+}